@@ -45,7 +45,9 @@ class TimeSeriesDataSetC32;
  * - @b fixedSizePackets: Specify if UDP packets are fixed size or not.
  * - @b sampleSize: Number of bits per sample. (Samples are assumed to be complex pairs of the number of bits specified).
  * - @b packetsPerChunk: Number of UDP packets in each input data chunk.
- * - @b samplesPerTimeBlock: Number of time samples to put in a block.
+ * - @b samplesPerTimeBlock: Number of time samples to put in a block. If the
+ *   chunk is not a whole number of blocks, blocks of one packet are used
+ *   instead and the channeliser carries the remainder between chunks.
  * - @b subbands: Number of sub-bands per packet.
  * - @b polarisations: Number of polarisations per packet.
  */
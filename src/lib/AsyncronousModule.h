@@ -108,8 +108,12 @@ class AsyncronousModule : public AbstractModule
     protected:
         static GPU_Manager* gpuManager();
 
+        /// Returns true if jobs run on NVidia cards rather than the host.
+        static bool nvidiaResources() { return _nvidiaResources; }
+
     private:
         ProcessingChain1<DataBlob*>* _chain;
+        static bool _nvidiaResources;
 
     protected:
         mutable QMutex lockerMutex;
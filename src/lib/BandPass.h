@@ -28,6 +28,10 @@ namespace ampp {
  * @details
  *    Takes a description of the bandpass as a polynomial and allows rescaling etc. The polynomial is always linked to a primary BinMap and all conversions are done relative to this primary map.
  *
+ *    The polynomial is evaluated for each bin mapping once, in Horner form
+ *    over all bins together, and cached. Changing the median offsets all
+ *    cached sets in place rather than rebuilding them.
+ *
  */
 class BinnedData;
 
@@ -43,7 +47,13 @@ class BandPass : public DataBlob
         void setData(const BinMap&,const QVector<float>& params );
         void setRMS(float);
 
-        /// Set a new median and rescale the polynomial appropriately. Does not rebin the hash
+        /// Set the mean for the current bin mapping. Does not rescale the polynomial
+        void setMean(float);
+
+        /// Return the mean for the current bin mapping
+        inline float mean() const { return _mean[_currentMapId]; }
+
+        /// Set a new median and offset the polynomial and cached data sets appropriately
         void setMedian(float);
 
         /// Return the coefficients of the underlying polynomial
@@ -89,6 +99,9 @@ class BandPass : public DataBlob
 	/// Calculate value of parameterised eqn
         float _evaluate(float) const; 
 
+        /// Calculate the parameterised eqn at @p n values of @p x into @p out
+        void _evaluate(const float* x, float* out, unsigned n) const;
+
         void _zeroChannelsMap(const BinMap& map);
 
         /// Build a data map, scaled appropriately
@@ -103,6 +116,7 @@ class BandPass : public DataBlob
         QVector<float> _params;
         float _deltaFreq;
         QHash<int, QVector<float> > _dataSets;
+        QHash<int, BinMap> _maps; // bin mapping of each data set
         QHash<int,float> _rms;
         QHash<int,float> _median;
         QHash<int,float> _mean;
@@ -0,0 +1,65 @@
+#ifndef BANDPASSLOADER_H
+#define BANDPASSLOADER_H
+
+
+#include "pelican/utility/ConfigNode.h"
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+
+/**
+ * @file BandPassLoader.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+class BandPass;
+
+/**
+ * @class BandPassLoader
+ *
+ * @brief
+ *    Watches a bandpass file and loads new versions in the background
+ * @details
+ * The file is polled for changes in its modification time or size every
+ * @p interval milliseconds from a separate thread, and a changed file is
+ * parsed with the BandPassAdapter. The loaded BandPass is held until the
+ * processing thread collects it with take(), which never waits for the
+ * loader. Files that fail to parse are reported and ignored.
+ */
+
+class BandPassLoader : public QThread
+{
+    public:
+        BandPassLoader( const ConfigNode& config, const QString& fileName,
+                        unsigned long interval );
+        ~BandPassLoader();
+
+        /// Return a newly loaded bandpass, or 0 if there is none ready.
+        /// The caller takes ownership.
+        BandPass* take();
+
+    protected:
+        void run();
+
+    private:
+        BandPass* _load();
+
+    private:
+        ConfigNode _config;
+        QString _fileName;
+        unsigned long _interval;
+        QDateTime _lastModified;
+        qint64 _lastSize;
+        QMutex _mutex;
+        QWaitCondition _wake;
+        bool _stop;
+        BandPass* _pending;
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // BANDPASSLOADER_H
@@ -18,11 +18,35 @@ class BinMap;
 
 /**
  * @class BandPassRecorder
- *  
+ *
  * @brief
  *    Measure a suitable BandPass from an incoming data stream
  * @details
- * 
+ * Stokes-I spectra are accumulated into per channel sums and into the
+ * normal equations of a least squares polynomial fit, so each chunk costs
+ * O(channels x coefficients) and fitting only needs a small solve. The
+ * first fit is made after @b requiredSamples spectra and, if refitting,
+ * a new one every @b refit samples spectra. Channels more than 2 sigma
+ * above the fit are removed from the normal equations and the fit is
+ * repeated until no more outliers are found; they stay excluded until the
+ * channel layout changes. After each fit the accumulated sums are scaled by
+ * @b decay (0, the default, restarts the integration; 1 keeps all
+ * history). The BandPass RMS is the mean per channel standard deviation of
+ * the spectra.
+ *
+ * Frequencies are centred and scaled to [-1, 1] for the fit, and the
+ * coefficients converted back to the frequency polynomial BandPass uses.
+ *
+ @verbatim
+ <BandPassRecorder>
+     <Band startFrequency="137.3" endFrequency="131.2" />
+     <requiredSamples value="20000" />
+     <fitParmaters coefficients="3" />
+     <refit samples="20000" decay="0.0" continuous="false" />
+ </BandPassRecorder>
+ @endverbatim
+ * With @b continuous set, pipelines keep running and publish each new
+ * BandPass rather than stopping after the first.
  */
 
 class BandPassRecorder : public AbstractModule
@@ -31,37 +55,50 @@ class BandPassRecorder : public AbstractModule
         BandPassRecorder( const ConfigNode& config );
         ~BandPassRecorder();
         // take it data and process it to fill in the BandPass object
-        // returns false if more data is required, true if complete
+        // returns true if a new fit has been written to bp
         bool run( SpectrumDataSetStokes* stokesI, BandPass* bp );
 
+        /// Returns true if the bandpass should be refitted continuously
+        bool continuous() const { return _continuous; }
+
     protected:
         // resets the working variables
         void _reset(const BinMap&);
-        // generate a trial fitting function on the integrated data
-        void _polyFit(float* x, int nDataPoints );
-        // evaluate the current value for the specified freq
-        float _theFit(float) const;
-
-        int sgels( int n, int m, int nrhs, 
-                   float *A, int lda, float *B, int ldb, 
-                   float *workSpace, int* work );
-
+        // fit the polynomial to the accumulated data and update bp
+        void _fit( const BinMap& map, BandPass* bp );
+        // solve the normal equations for the scaled coefficients
+        void _solve();
+        // evaluate the current scaled fit for bin i
+        double _theFit(unsigned int i) const;
+        // remove bin i from the normal equations
+        void _exclude(unsigned int i);
 
     private:
-        std::vector<float> _sum;
-        unsigned long _totalSamples;
         unsigned long _requiredSamples;
+        unsigned long _refitSamples;
+        double _decay;
+        bool _continuous;
         float _startFrequency;
         float _endFrequency;
-        int _polyDegree;
-        std::vector<float> _fit;
-        std::vector<float> _freq;
-        std::vector<float> _freqMatrix;
-        std::vector<float> _valueMatrix;
+        int _polyDegree; // number of coefficients
+        unsigned int _nBins;
+        unsigned int _nFits;
+        double _totalSamples; // weight of the accumulated sums
+        unsigned long _samplesSinceFit;
+        std::vector<double> _sum; // per channel sums of I and I^2
+        std::vector<double> _sumSquared;
+        std::vector<unsigned char> _excluded; // channels rejected as outliers
+        std::vector<double> _basis; // scaled frequency powers, per power
+        std::vector<double> _ata; // normal equations of included channels
+        std::vector<double> _aty;
+        std::vector<double> _factor; // scratch for the Cholesky factor
+        std::vector<double> _coeffs; // scaled coefficients of the fit
+        std::vector<float> _chunkSum; // scratch
+        double _centre, _halfWidth;
 };
 
 PELICAN_DECLARE_MODULE(BandPassRecorder)
 
 } // namespace ampp
 } // namespace pelican
-#endif // BANDPASSRECORDER_H 
+#endif // BANDPASSRECORDER_H
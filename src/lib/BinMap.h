@@ -12,6 +12,22 @@ namespace pelican {
 
 namespace ampp {
 
+/**
+ * @struct BinMapKey
+ *
+ * @brief
+ *    The parameters identifying a BinMap, used to assign its unique id
+ */
+struct BinMapKey
+{
+    unsigned int nBins;
+    double lower;
+    double width;
+};
+
+bool operator==(const BinMapKey&, const BinMapKey&);
+unsigned int qHash(const BinMapKey& key);
+
 /**
  * @class BinMap
  *
@@ -68,7 +84,7 @@ class BinMap
 
         friend bool operator==(const BinMap&, const BinMap&);
     private:
-        static QMap< unsigned int, QMap< double, QMap<double, unsigned int> > > _unique; // assigns unique id to a BinMap type
+        static QHash< BinMapKey, unsigned int > _unique; // assigns unique id to a BinMap type
         static unsigned int _uniqueCount; // guarantees a unique id
         unsigned int _nBins;
         double _lower;
@@ -36,6 +36,10 @@ class BlobStatistics : public DataBlob
         virtual void serialise(QIODevice& in, QSysInfo::Endian endian);
         virtual void deserialise(QIODevice& in);
 
+    protected:
+        /// Constructor for derived blobs of type @p type.
+        BlobStatistics( const QString& type );
+
     private:
         float _mean, _rms, _median;
 };
@@ -1,6 +1,7 @@
 #ifndef DEDISPERSIONBUFFER_H
 #define DEDISPERSIONBUFFER_H
 #include <vector>
+#include <QList>
 #include "timer.h"
 #include <algorithm>
 
@@ -13,6 +14,7 @@ namespace pelican {
 namespace ampp {
 class WeightedSpectrumDataSet;
 class SpectrumDataSetStokes;
+template<typename T> class SpectrumDataSet;
 
 /**
  * @class DedispersionBuffer
@@ -81,9 +83,25 @@ class DedispersionBuffer
         void dump( const QString& fileName ) const;
         void dumpbin( const QString& fileName ) const;
 
+        /// transpose samples [start, end) of the data set into the channel
+        //  major rows of out, stride floats apart, starting at the given
+        //  column. If weights are given, flagged data are replaced from the
+        //  noise template (rows noiseStride apart, from noiseColumn).
+        //  The copy is made in TILE x TILE blocks.
+        static void transpose( SpectrumDataSetStokes* streamData,
+                               const SpectrumDataSet<float>* weights,
+                               const std::vector<float>& noiseTemplate,
+                               unsigned noiseStride, unsigned noiseColumn,
+                               float* out, unsigned stride, unsigned column,
+                               unsigned start, unsigned end, bool invertChannels );
+
+        /// samples and channels in each block of transpose()
+        static const unsigned TILE = 16;
+
     private:
+        static void _gather( const float* in, float* out, int n, bool reverse );
+        static void _transposeTile( const float* in, float* out );
         unsigned int _addSamples( WeightedSpectrumDataSet* data, std::vector<float>& noiseTemplate, unsigned *sampleOffset, unsigned numSamples /* max number fo samples to insert */ );
-        unsigned int _addSamples( SpectrumDataSetStokes* data, std::vector<float>& noiseTemplate, unsigned *sampleOffset, unsigned numSamples /* max number fo samples to insert */ );
         QList<SpectrumDataSetStokes* > _inputBlobs;
         std::vector<float> _timedata;
         unsigned int _nsamp;
@@ -0,0 +1,78 @@
+#ifndef DEDISPERSIONHOSTKERNEL_H
+#define DEDISPERSIONHOSTKERNEL_H
+
+/**
+ * @file DedispersionHostKernel.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+
+/**
+ * @details
+ * Brute force dedispersion on the host CPU, the counterpart of the
+ * cacheDedisperseLoop CUDA kernel with the same arguments.
+ *
+ * @p buff is channel major with @p numSamples samples per channel and
+ * @p outbuff receives @p tdms rows of (numSamples - maxshift) samples.
+ * @p mstartdm and @p mdmstep are in units of samples, so that the delay of
+ * channel c for trial dm is (int)(dmShift[c] * (mstartdm + dm * mdmstep)).
+ * Each output is summed over the channels in order, as on the GPU, so the
+ * results are bit for bit the same.
+ *
+ * The rows of @p buff are @p rowStride floats apart, or @p numSamples if 0,
+ * so a window of a larger buffer can be dedispersed in place; likewise
+ * for the other algorithms.
+ */
+void hostDedisperseLoop( float* outbuff, const float* buff, float mstartdm,
+                         float mdmstep, unsigned tdms, unsigned numSamples,
+                         const float* dmShift, unsigned maxshift,
+                         unsigned nchans, unsigned nThreads,
+                         unsigned rowStride = 0 );
+
+/**
+ * @details
+ * Two stage subband (piecewise linear) dedispersion on the host CPU, with
+ * the same arguments and output as hostDedisperseLoop.
+ *
+ * The channels are split into @p nSubbands groups. For each block of
+ * neighbouring DM trials the channels of each group are first summed with
+ * their delays relative to the first channel of the group at the central
+ * DM of the block, and each trial is then formed from these partial sums
+ * delayed by the first channel of each group. The blocks are sized so the
+ * relative delays are out by at most a sample, which cuts the cost of
+ * wide DM searches by up to min(block size, channels per group).
+ */
+void hostSubbandDedisperse( float* outbuff, const float* buff, float mstartdm,
+                            float mdmstep, unsigned tdms, unsigned numSamples,
+                            const float* dmShift, unsigned maxshift,
+                            unsigned nchans, unsigned nSubbands,
+                            unsigned nThreads, unsigned rowStride = 0 );
+
+/**
+ * @details
+ * Fast Dispersion Measure Transform (Zackay & Ofek 2017) on the host CPU,
+ * with the same arguments and output as hostDedisperseLoop.
+ *
+ * Starting from single channels, neighbouring groups of channels are
+ * merged pairwise, forming for each merged group the sums along every
+ * integer delay across it from the sums of its halves. After log2(nchans)
+ * merges each DM trial is read from the row of its delay across the band,
+ * (int)((dmShift[nchans-1] - dmShift[0]) * (mstartdm + dm * mdmstep)), so
+ * the cost scales with the largest delay rather than the number of
+ * trials times the number of channels. The rows of each merge are
+ * distributed over the threads with SIMD over time.
+ *
+ * The channel delays must increase with channel number; a QString is
+ * thrown otherwise.
+ */
+void hostFdmtDedisperse( float* outbuff, const float* buff, float mstartdm,
+                         float mdmstep, unsigned tdms, unsigned numSamples,
+                         const float* dmShift, unsigned maxshift,
+                         unsigned nchans, unsigned nThreads,
+                         unsigned rowStride = 0 );
+
+} // namespace ampp
+} // namespace pelican
+#endif // DEDISPERSIONHOSTKERNEL_H
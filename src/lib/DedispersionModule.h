@@ -16,7 +16,6 @@
 #include "SpectrumDataSet.h"
 #include "timer.h"
 
-#ifdef CUDA_FOUND
 /**
  * @file DedispersionModule.h
  */
@@ -30,7 +29,9 @@ class GPU_DataMapping;
 class GPU_Job;
 class GPU_Param;
 class GPU_NVidia;
+class GPU_Host;
 class DedispersionBuffer;
+class DedispersionRingBuffer;
 class LockingBuffer;
 
 /**
@@ -40,12 +41,33 @@ class LockingBuffer;
  *     Run Dedispersion
  * @details
  *     An Asyncronous dedispersion module
+ *
+ *     Jobs run on the NVidia cards found, or on the host CPU if there
+ *     are none (or with <device type="cpu"/>) using a multithreaded
+ *     brute force dedisperser that gives the same DedispersionSpectra.
+ *
+ *     On the host the subband algorithm or the FDMT can be used instead
+ *     of brute force for wide DM searches (see hostSubbandDedisperse()
+ *     and hostFdmtDedisperse()).
+ *
+ *     With <ringBuffer value="true"/> the data are kept in a single
+ *     DedispersionRingBuffer, so consecutive jobs read overlapping
+ *     windows of it rather than each buffer starting with a copy of the
+ *     last maxshift samples of the one before (host CPU only).
+ *
+ *     Configurations the GPU kernel does not support (ring buffer, or an
+ *     algorithm other than bruteForce) are rejected by the constructor when
+ *     NVidia cards are in use.
  */
 
 class DedispersionModule : public AsyncronousModule
 {
+    public:
+        /// the dedispersion algorithms available
+        typedef enum { BruteForce, Subband, FDMT } Algorithm;
+
    private:
-        // the nvidia kernel description
+        // the kernel description, for nvidia cards or the host CPU
         class DedispersionKernel : public GPU_Kernel {
               float _startdm;
               float _dmstep;
@@ -55,6 +77,9 @@ class DedispersionModule : public AsyncronousModule
               unsigned _nChans;
               unsigned _maxshift;
               unsigned _nsamples;
+              unsigned _rowStride; // of the input rows
+              Algorithm _algorithm;
+              unsigned _subbands;
               GPU_MemoryMapOutput _outputBuffer;
               GPU_MemoryMap _inputBuffer;
               GPU_MemoryMapConst _dmShift;
@@ -62,9 +87,14 @@ class DedispersionModule : public AsyncronousModule
            public:
               DedispersionKernel( float, float, float, float, unsigned, unsigned, unsigned );
               void setDMShift( std::vector<float>& );
+              void setAlgorithm( Algorithm, unsigned subbands );
               void setOutputBuffer( std::vector<float>& );
               void setInputBuffer( std::vector<float>&, GPU_MemoryMap::CallBackT );
+              // rows of _nsamples samples, rowStride floats apart (host only)
+              void setInputBuffer( float* data, unsigned long bytes, unsigned rowStride,
+                                   GPU_MemoryMap::CallBackT );
               void run( GPU_NVidia& );
+              void run( GPU_Host& );
               void cleanUp();
         };
 
@@ -88,6 +118,8 @@ class DedispersionModule : public AsyncronousModule
                              DedispersionSpectra* dataOut );
         /// return input buffers for reuse as soon as data uploaded to the GPU
         void gpuDataUploaded( DedispersionBuffer* );
+        /// allow a ring buffer window to be overwritten once dedispersed
+        void ringWindowUsed( unsigned long window );
 
         /// clean up after asyncronous task is finished
         void exportComplete( DataBlob* data );
@@ -105,6 +137,8 @@ class DedispersionModule : public AsyncronousModule
 
      protected:
         void dedisperse( DedispersionBuffer* buffer, DedispersionSpectra* dataOut );
+        void dedisperse( float* data, unsigned long window, DedispersionSpectra* dataOut );
+        void _dedisperseRing( WeightedSpectrumDataSet* weightedData );
         void _cleanBuffers();
 
     private:
@@ -116,6 +150,8 @@ class DedispersionModule : public AsyncronousModule
         unsigned _numSamplesBuffer;
         float _dmStep;
         float _dmLow;
+        Algorithm _algorithm;
+        unsigned _subbands; // channel groups for the subband algorithm
         double _fch1;
         double _foff;
         QList<DedispersionBuffer*> _buffersList;
@@ -127,6 +163,8 @@ class DedispersionModule : public AsyncronousModule
         int _remainingSamples;
         int _nChannels; // number of Channels per sample
         DedispersionBuffer* _currentBuffer;
+        bool _useRing;
+        DedispersionRingBuffer* _ring; // replaces the buffers if _useRing
         std::vector<float> _noiseTemplate;
         std::vector<float> _dmshifts;
 
@@ -149,5 +187,4 @@ class DedispersionModule : public AsyncronousModule
 PELICAN_DECLARE_MODULE(DedispersionModule)
 } // namespace ampp
 } // namespace pelican
-#endif // CUDA_FOUND
 #endif // DEDISPERSIONMODULE_H
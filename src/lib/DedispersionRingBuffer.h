@@ -0,0 +1,117 @@
+#ifndef DEDISPERSIONRINGBUFFER_H
+#define DEDISPERSIONRINGBUFFER_H
+#include <vector>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include "timer.h"
+
+/**
+ * @file DedispersionRingBuffer.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+class WeightedSpectrumDataSet;
+class SpectrumDataSetStokes;
+
+/**
+ * @class DedispersionRingBuffer
+ *  
+ * @brief
+ *     A circular time/frequency store of overlapping dedispersion windows
+ * @details
+ *     Samples are stored channel major, like the DedispersionBuffer, in a
+ *     ring of capacity windowSize + (windows - 1) * advance samples, where
+ *     the advance is the window size less the overlap. Consecutive windows
+ *     overlap in place, so no data has to be copied between them, and up
+ *     to windows - 1 windows can be processed while the next is filled.
+ *     The first windowSize samples of each row are repeated after the end
+ *     of the ring so that every window is contiguous, with rows
+ *     rowStride() floats apart.
+ *
+ *     Once a window is complete it is handed over with advance(), and
+ *     release() must be called when it has been processed; addSamples()
+ *     waits for this before overwriting its samples.
+ */
+
+class DedispersionRingBuffer
+{
+    public:
+        DedispersionRingBuffer( unsigned int windowSize, unsigned int overlap,
+                                unsigned int windows, unsigned int sampleSize,
+                                bool invertChannels = false );
+        ~DedispersionRingBuffer();
+
+        /// return the number of elements in each sample
+        unsigned sampleSize() const { return _sampleSize; }
+
+        /// return the number of samples in each window
+        unsigned windowSize() const { return _windowSize; }
+
+        /// return the distance between rows of a window (in floats)
+        unsigned rowStride() const { return _stride; }
+
+        /// import samples from the data set, starting at sampleNumber, until
+        //  the current window is complete. sampleNumber is updated to the
+        //  next sample to import, and the number of samples still needed
+        //  to complete the window is returned.
+        unsigned int addSamples( WeightedSpectrumDataSet* weightedData,
+                                 std::vector<float>& noiseTemplate,
+                                 unsigned *sampleNumber );
+
+        /// return the index of the current window
+        unsigned long window() const { return _window; }
+
+        /// return the first element of the current window
+        float* windowData();
+
+        /// return the number of bytes from windowData() to the end of
+        //  the last row of the window
+        unsigned long windowBytes() const;
+
+        /// return the data blobs with samples in the current window
+        const QList<SpectrumDataSetStokes*>& windowBlobs() const { return _windowBlobs; }
+
+        /// return the first sample number (in the first datablob) of the window
+        unsigned int windowFirstSample() const { return _windowFirstSample; }
+
+        /// hand over the (complete) current window for processing and start
+        //  on the next. The data blobs that have no samples in any later
+        //  window are returned.
+        QList<SpectrumDataSetStokes*> advance();
+
+        /// mark a window handed over by advance() as processed
+        void release( unsigned long window );
+
+    private:
+        void _updateWindowBlobs();
+
+    private:
+        struct BlobSamples {
+            SpectrumDataSetStokes* blob;
+            unsigned long long first; // sample number in the stream of the blob's first sample
+            unsigned int samples;
+        };
+        unsigned int _windowSize;
+        unsigned int _advance;
+        unsigned int _capacity;
+        unsigned int _stride;
+        unsigned int _sampleSize;
+        bool _invertChannels;
+        std::vector<float> _data;
+        unsigned long long _written; // number of samples in the stream so far
+        unsigned long _window; // index of the window being filled
+        QList<BlobSamples> _blobs;
+        QList<SpectrumDataSetStokes*> _windowBlobs;
+        unsigned int _windowFirstSample;
+        QList<unsigned long> _inUse; // windows handed over but not released
+        QMutex _mutex;
+        QWaitCondition _released;
+        DEFINE_TIMER(_addSampleTimer)
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // DEDISPERSIONRINGBUFFER_H
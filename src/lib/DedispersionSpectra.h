@@ -59,6 +59,8 @@ class DedispersionSpectra : public DataBlob
         }
         void setInputDataBlobs( const QList< SpectrumDataSetStokes* >& );
         void setFirstSample( unsigned int sampleNumber );
+        /// return the sample number (in the first input blob) of time slice 0
+        unsigned int firstSample() const { return _firstSampleNumber; }
 
         /// return the start of the maximum DM that can be represented in the data
         float dmMax() const { return _dmBin.lastBinValue(); }
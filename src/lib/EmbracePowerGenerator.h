@@ -24,8 +24,9 @@ class SpectrumDataSetStokes;
  * @class EmbracePowerGenerator
  *
  * @details Module used for converting a collection of spectra from X,Y polarisations to stokes parameters.
-
  *
+ * The power of each polarisation is formed with the StokesGenerator XX/YY
+ * kernel using @b processingThreads threads (default 4).
  */
 
 class EmbracePowerGenerator : public AbstractModule
@@ -43,8 +44,7 @@ class EmbracePowerGenerator : public AbstractModule
                 SpectrumDataSetStokes* stokes);
 
     private:
-        float _sqr(float x) { return x * x; }
-
+        unsigned _nThreads;
 };
 
 // Declare this class as a pelican module.
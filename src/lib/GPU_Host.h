@@ -0,0 +1,47 @@
+#ifndef GPU_HOST_H
+#define GPU_HOST_H
+
+
+#include "GPU_Resource.h"
+
+/**
+ * @file GPU_Host.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+class GPU_Manager;
+
+/**
+ * @class GPU_Host
+ *  
+ * @brief
+ *     Runs GPU_Jobs on the host CPU via a GPU_Manager
+ * @details
+ *     Kernels are executed through their GPU_Kernel::run(GPU_Host&)
+ *     method, directly on the host memory of their GPU_MemoryMaps. Each
+ *     job may use up to threads() OpenMP threads.
+ */
+
+class GPU_Host : public GPU_Resource
+{
+
+    public:
+        /// @p threads = 0 uses the OpenMP default
+        GPU_Host( unsigned int threads = 0 );
+        ~GPU_Host();
+        virtual void run( GPU_Job* job );
+
+        /// return the number of threads a kernel may use
+        unsigned int threads() const { return _threads; }
+
+        static void initialiseResources( GPU_Manager* manager, unsigned int threads = 0 );
+
+    private:
+        unsigned int _threads;
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // GPU_HOST_H 
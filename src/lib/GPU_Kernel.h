@@ -11,6 +11,7 @@ namespace pelican {
 
 namespace ampp {
 class GPU_NVidia;
+class GPU_Host;
 
 /**
  * @class GPU_Kernel
@@ -29,6 +30,10 @@ class GPU_Kernel
         // implement this method to run the nvidia kernel
         // using GPU_MemoryMap type to transfer data
         virtual void run( GPU_NVidia& ) = 0;
+        // implement this method to run the kernel on the host CPU.
+        // Data is accessed through the GPU_MemoryMap host pointers,
+        // and any callbacks must be run once the data is no longer needed
+        virtual void run( GPU_Host& );
         // this method will be called when something
         // goes wrong and the run is abandoned.
         // call any callbacks for the MemoryMap from here
@@ -7,8 +7,11 @@
 
 #include "pelican/modules/AbstractModule.h"
 #include "PolyphaseCoefficients.h"
+#include "PPFCoefficientStore.h"
+#include "PPFFirKernel.h"
 
 #include <complex>
+#include <map>
 #include <vector>
 
 #include <fftw3.h>
@@ -37,7 +40,9 @@ class SpectrumDataSetC32;
  		<PPFChanneliser name="">
  			<channels number="512"/>
  			<processingThreads number="2"/>
- 			<filter nTaps="8" filterWindow="kaiser"/>
+ 			<filter nTaps="8" filterWindow="kaiser" store="/path/to/coeffs"/>
+ 			<fftw batch="16" planner="measure" wisdom="/path/to/ppf.wisdom"/>
+ 			<oversampling factor="4/3"/>
  		</PPFChanneliser>
  @endverbatim
  *
@@ -48,12 +53,53 @@ class SpectrumDataSetC32;
  * - @b filter: Options for FIR filer coefficients.
  *     - @i nTaps: Number of filter taps in the PPF coefficient data
  *     - @i filterWindow: The filter window type used in generating FIR filter coefficients. Possible options are: "kaiser" (default), "gaussian", "blackman" and "hamming".
+ *     - @i store: Directory of the binary coefficient store (see
+ *       PPFCoefficientStore). Coefficients are mapped from the store when
+ *       present, otherwise generated and saved to it (default none).
  *
+ * - @b fftw: Options for the FFT stage.
+ *     - @i batch: Number of time blocks filtered into a scratch matrix and
+ *       transformed with a single FFTW call (default 16).
+ *     - @i planner: FFTW planner rigour: "estimate", "measure" (default)
+ *       or "patient". With a wisdom file only the first start pays for it.
+ *       Remainder batches (chunks that are not a multiple of the batch)
+ *       are always planned with "estimate".
+ *     - @i wisdom: FFTW wisdom file. Wisdom is imported on construction and
+ *       exported once the full batch plans are created (default none).
+ *
+ * - @b oversampling: Spacing of the output spectra.
+ *     - @i factor: Oversampling factor as an integer or ratio, e.g. "2" or
+ *       "4/3" (default 1, critically sampled).
+ *     - @i hop: Number of samples between spectra; overrides @i factor.
+ *       When oversampling, the hop and the number of channels must be
+ *       multiples of 16 so every filter window starts on an aligned row.
+ *
+ * Each processing thread owns its FFTW plans, created on its own aligned
+ * scratch buffer, so FFTW can use its aligned SIMD codelets and threads
+ * never share plan state.
+ *
+ * The FIR stage keeps the delay line of each sub-band and polarisation in
+ * a split real/imaginary, 64-byte aligned layout (see PPFFirKernel) and uses
+ * the fastest vector kernel supported by the host CPU.
+ *
+ * The time series of each sub-band and polarisation is treated as a
+ * continuous stream: the number of samples in a chunk need not be a multiple
+ * of the number of channels. Samples which do not complete a spectrum are
+ * carried over to the next call along with the delay line, so the number of
+ * spectra produced may vary from call to call. The timestamp of the output
+ * is that of the first sample of the first spectrum.
+ *
+ * When oversampled, the delay line of each sub-band and polarisation is a
+ * linear history of samples instead of a ring of time blocks. Each spectrum
+ * filters the nTaps * nChannels samples starting at the next hop, so every
+ * input sample is buffered once however many spectra it contributes to.
+ * Filtered samples are circularly shifted before the FFT so the spectra are
+ * phase referenced to the stream as for critically sampled output.
  */
 
 class PPFChanneliser : public AbstractModule
 {
-    private:
+    protected:
         friend class PPFChanneliserTest;
         typedef std::complex<float> Complex;
 
@@ -68,7 +114,17 @@ class PPFChanneliser : public AbstractModule
         void run(const TimeSeriesDataSetC32* timeSeries,
                 SpectrumDataSetC32* spectra);
 
-    private:
+        /// Returns the number of samples between output spectra.
+        unsigned hop() const { return _hop; }
+
+    protected:
+        /// Channelise with output spectra every _hop samples.
+        void _runOversampled(const TimeSeriesDataSetC32* timeSeries,
+                SpectrumDataSetC32* spectra);
+
+        /// Parse the oversampling options to set the hop size.
+        void _setHop(const QString& factor, const QString& hop);
+
         /// Generate the FIR coefficients used by the PPF.
         void _generateFIRCoefficients(const QString& window, unsigned nTaps);
 
@@ -77,62 +133,108 @@ class PPFChanneliser : public AbstractModule
 
         /// Update the sample buffer.
         void _updateBuffer(const Complex* samples, unsigned nSamples,
-                unsigned nTaps, Complex* buffer);
+                unsigned nTaps, float* buffer, unsigned& iOldest);
 
         /// Filter the matrix of samples (dimensions nTaps by nChannels)
         /// to create a vector of samples for the FFT.
-        void _filter(const Complex* sampleBuffer, unsigned nTaps,
-                unsigned nChannels, const float* coeffs,
+        void _filter(const float* sampleBuffer, unsigned nTaps,
+                unsigned nChannels, unsigned iOldest, const float* coeffs,
                 Complex* filteredSamples);
 
-        /// FFT filtered samples to form a spectrum.
-        void _fft(const Complex* samples, Complex* spectrum);
+        /// FFT a batch of filtered samples in place to form spectra.
+        void _fft(fftwf_plan plan);
+
+        /// Returns a pointer to the samples of spectrum @p k of a work item.
+        const Complex* _spectrumSamples(const Complex* samples, unsigned item,
+                unsigned k);
 
-        /// Returns the sub-band ID range to be processed.
-        void _assign_threads(unsigned& start, unsigned& end,
-                unsigned nSubbands, unsigned nThreads, unsigned threadId);
+        /// Save the samples of a work item which do not complete a spectrum.
+        void _saveResidual(const Complex* samples, unsigned nSamples,
+                unsigned item, unsigned nSpectra);
 
         /// Set up processing buffers.
         unsigned _setupWorkBuffers(unsigned nSubbands, unsigned nPolariations,
                 unsigned nChannels, unsigned nTaps);
 
+        /// Set up (or grow) the sample histories used when oversampling.
+        void _setupHistory(unsigned nItems, unsigned size);
+
+        /// Free processing buffers.
+        void _freeWorkBuffers();
+
+        /// Returns the (cached) FFTW plan for a batch of spectra in the
+        /// work buffer of the specified thread.
+        fftwf_plan _fftPlan(unsigned batch, unsigned threadId);
+
         /// Create the FFTW plan for use with the channeliser.
-        void _createFFTWPlan(unsigned nChannels, fftwf_plan& plan);
+        void _createFFTWPlan(unsigned nChannels, unsigned batch,
+                Complex* data, fftwf_plan& plan, unsigned flags);
 
         /// Return an error message.
         QString _err(const QString& message);
 
-    private:
+    protected:
         bool _buffersInitialised;
 
         unsigned _nChannels;
         unsigned _nThreads;
+        unsigned _hop;
 
-        PolyphaseCoefficients _ppfCoeffs;
-        vector<float> _coeffs;
-
-        //unsigned _iOldestSamples; // Pointer to the oldest samples.
-        vector<unsigned> _iOldestSamples; // Pointer to the oldest samples.
+        unsigned _nTaps;
 
-        fftwf_plan _fftPlan;
+        // Generated coefficients (empty when mapped from the store).
+        PolyphaseCoefficients _ppfCoeffs;
 
-        // Work Buffers (need to have a buffer per thread).
-        vector<vector<Complex> > _workBuffer;
-        vector<vector<Complex> > _filteredData;
+        // Coefficients used by the FIR kernel, padded and tap-major (see
+        // PPFFirKernel): either _coeffBuffer or mapped from _coeffStore.
+        const float* _coeffs;
+        float* _coeffBuffer;
+        PPFCoefficientStore* _coeffStore;
+        PPFFirKernel::Function _firKernel;
+
+        // Pointer to the oldest samples per sub-band and polarisation.
+        vector<unsigned> _iOldestSamples;
+
+        // FFTW plans per thread keyed on batch size (nChannels is fixed
+        // per module).
+        unsigned _fftBatch;
+        unsigned _fftwFlags;
+        QString _wisdomFile;
+        vector<std::map<unsigned, fftwf_plan> > _fftPlans;
+
+        // Samples left over from the previous call (nChannels per sub-band
+        // and polarisation, of which the first _nResidual are valid).
+        vector<Complex> _residual;
+        unsigned _nResidual;
+
+        // Delay line per sub-band and polarisation: nTaps rows of real
+        // values followed by nTaps rows of imaginary values. When
+        // oversampling, _historySize real values followed by _historySize
+        // imaginary values, of which [_iStart, _iEnd) are still needed.
+        vector<float*> _workBuffer;
+        unsigned _historySize;
+        unsigned _iStart;
+        unsigned _iEnd;
+
+        // Stream position of the next oversampled spectrum modulo nChannels.
+        unsigned _phase;
+
+        // Work Buffers (need to have a buffer per thread), each holding
+        // _fftBatch rows of filtered samples padded to the FIR stride.
+        vector<Complex*> _filteredData;
 };
 
 
 /**
  * @details
- * FFT a vector of nSamples time data samples to produce a spectrum.
+ * FFT a batch of filtered samples in place to produce spectra, using a plan
+ * returned by _fftPlan() for the work buffer of the calling thread.
  *
- * @param samples
- * @param nSamples
- * @param spectrum
+ * @param plan
  */
-inline void PPFChanneliser::_fft(const Complex* samples, Complex* spectrum)
+inline void PPFChanneliser::_fft(fftwf_plan plan)
 {
-    fftwf_execute_dft(_fftPlan, (fftwf_complex*)samples, (fftwf_complex*)spectrum);
+    fftwf_execute(plan);
 }
 
 // Declare this class as a pelican module.
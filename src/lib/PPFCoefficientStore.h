@@ -0,0 +1,71 @@
+#ifndef PPF_COEFFICIENT_STORE_H_
+#define PPF_COEFFICIENT_STORE_H_
+
+/**
+ * @file PPFCoefficientStore.h
+ */
+
+#include "PolyphaseCoefficients.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+namespace pelican {
+namespace ampp {
+
+/**
+ * @class PPFCoefficientStore
+ *
+ * @brief
+ * Binary cache of PPF filter coefficients in the FIR kernel layout.
+ *
+ * @details
+ * Coefficients are stored in a directory with one file per
+ * (nTaps, nChannels, window) key. Each file holds a 64-byte versioned header
+ * followed by the single precision coefficients in the padded, tap-major
+ * layout used by PPFFirKernel, so they can be memory-mapped and used by the
+ * kernel without conversion. Files written with a different version, byte
+ * order or layout are ignored (and overwritten on the next save).
+ */
+
+class PPFCoefficientStore
+{
+    public:
+        /// Constructs a store using the specified directory.
+        PPFCoefficientStore(const QString& directory);
+
+        /// Destroys the store, unmapping any mapped coefficients.
+        ~PPFCoefficientStore();
+
+    public:
+        /// Returns the mapped coefficients for the filter, or 0 if they are
+        /// not in the store.
+        const float* map(unsigned nTaps, unsigned nChannels,
+                PolyphaseCoefficients::FirWindow window);
+
+        /// Writes coefficients in the PPFFirKernel layout to the store.
+        void save(const float* coeffs, unsigned nTaps, unsigned nChannels,
+                PolyphaseCoefficients::FirWindow window);
+
+        /// Returns the name of the file holding the filter coefficients.
+        QString fileName(unsigned nTaps, unsigned nChannels,
+                PolyphaseCoefficients::FirWindow window) const;
+
+    public:
+        /// Version of the file format.
+        static const unsigned version = 1;
+
+    private:
+        /// Releases the mapped file.
+        void _unmap();
+
+    private:
+        QString _directory;
+        QFile _file;
+        uchar* _data;
+};
+
+}// namespace ampp
+}// namespace pelican
+
+#endif // PPF_COEFFICIENT_STORE_H_
@@ -0,0 +1,79 @@
+#ifndef PPF_FIR_KERNEL_H_
+#define PPF_FIR_KERNEL_H_
+
+/**
+ * @file PPFFirKernel.h
+ */
+
+#include <QtCore/QString>
+
+#include <complex>
+#include <cstddef>
+
+namespace pelican {
+namespace ampp {
+
+/**
+ * @class PPFFirKernel
+ *
+ * @brief
+ * Vectorised FIR stage of the polyphase channeliser.
+ *
+ * @details
+ * The delay line of a sub-band is held in split real/imaginary form as two
+ * blocks of nTaps rows, each row holding one time block of samples. Rows are
+ * padded to stride() floats so that every row starts on a 64-byte boundary
+ * and the vector kernels never need a tail loop. Coefficients use the same
+ * padded, tap-major layout.
+ *
+ * The kernel is selected at run time from the instruction sets supported by
+ * the host (AVX-512, AVX2+FMA, SSE) with a scalar fallback for other
+ * architectures.
+ */
+
+class PPFFirKernel
+{
+    public:
+        typedef std::complex<float> Complex;
+        typedef enum { SCALAR, SSE, AVX2, AVX512 } Type;
+
+        /// Signature of the FIR filter kernel functions.
+        typedef void (*Function)(const float* re, const float* im,
+                unsigned nTaps, unsigned iOldest, unsigned stride,
+                const float* coeffs, Complex* filteredSamples);
+
+    public:
+        /// Returns the fastest kernel supported by the host CPU.
+        static Type best();
+
+        /// Returns true if the kernel type is supported by the host CPU.
+        static bool supported(Type type);
+
+        /// Returns the filter function for the kernel type.
+        static Function function(Type type);
+
+        /// Returns the name of the kernel type.
+        static QString name(Type type);
+
+        /// Returns the padded row length (in floats) for nChannels.
+        static unsigned stride(unsigned nChannels)
+        { return (nChannels + _floatsPerLine - 1) & ~(_floatsPerLine - 1); }
+
+        /// Allocates a zeroed, 64-byte aligned buffer of n floats.
+        static float* allocate(size_t n);
+
+        /// Frees a buffer returned by allocate().
+        static void free(float* buffer);
+
+    public:
+        /// Alignment of the delay line and coefficient rows, in bytes.
+        static const unsigned alignment = 64;
+
+    private:
+        static const unsigned _floatsPerLine = alignment / sizeof(float);
+};
+
+}// namespace ampp
+}// namespace pelican
+
+#endif // PPF_FIR_KERNEL_H_
@@ -0,0 +1,108 @@
+#ifndef PPF_STOKES_INTEGRATOR_H_
+#define PPF_STOKES_INTEGRATOR_H_
+
+/**
+ * @file PPFStokesIntegrator.h
+ */
+
+#include "PPFChanneliser.h"
+
+#include <vector>
+
+namespace pelican {
+
+class ConfigNode;
+
+namespace ampp {
+
+class TimeSeriesDataSetC32;
+class SpectrumDataSetStokes;
+
+/**
+ * @class PPFStokesIntegrator
+ *
+ * @brief Module to channelise a time stream data blob directly into
+ * integrated Stokes spectra.
+ *
+ * @details Fuses the PPFChanneliser, StokesGenerator and StokesIntegrator
+ * stages. The complex spectra of a sub-band are produced a batch of blocks
+ * at a time in the per-thread channeliser scratch buffers, converted to
+ * Stokes parameters and accumulated into the output while still in cache,
+ * so the SpectrumDataSetC32 is never written out. Pipelines which need the
+ * complex spectra (e.g. for H5_LofarBFVoltageWriter) should use the
+ * separate modules.
+ *
+ * Example configuration node :
+ *
+ @verbatim
+ 		<PPFStokesIntegrator name="">
+ 			<outputChannelsPerSubband value="16"/>
+ 			<processingThreads value="2"/>
+ 			<filter nTaps="8" filterWindow="kaiser"/>
+ 			<fftw batch="16"/>
+ 			<numberOfStokes value="1"/>
+ 			<integrateTimeBins value="1"/>
+ 			<integrateFrequencyChannels value="1"/>
+ 		</PPFStokesIntegrator>
+ @endverbatim
+ *
+ * - The channeliser options are as for PPFChanneliser, except that the
+ *   output must be critically sampled.
+ *
+ * - @b numberOfStokes: 1 (Stokes-I) or 4 (IQUV).
+ *
+ * - @b integrateTimeBins: Number of spectra summed into each output
+ *   spectrum. As with StokesIntegrator, the partial sum of a window left
+ *   incomplete at the end of a chunk is carried over to the next, so the
+ *   chunk size need not be a multiple of the window.
+ *
+ * - @b integrateFrequencyChannels: Number of adjacent channels summed into
+ *   each output channel. Must divide the number of channels.
+ */
+
+class PPFStokesIntegrator : public PPFChanneliser
+{
+    private:
+        friend class PPFStokesIntegratorTest;
+
+    public:
+        /// Constructs the fused channeliser module.
+        PPFStokesIntegrator(const ConfigNode& config);
+
+        /// Destroys the fused channeliser module.
+        ~PPFStokesIntegrator();
+
+        /// Method converting the time stream to integrated Stokes spectra.
+        void run(const TimeSeriesDataSetC32* timeSeries,
+                SpectrumDataSetStokes* stokes);
+
+    private:
+        /// Accumulate Stokes parameters of a pair of X, Y spectra.
+        void _accumulate(const Complex* X, const Complex* Y, float* I,
+                float* Q, float* U, float* V);
+
+        /// Return an error message.
+        QString _err(const QString& message);
+
+    private:
+        unsigned _numberOfStokes;
+        unsigned _windowSize;
+        unsigned _binChannels;
+
+        // Sums of the incomplete window, per sub-band and Stokes parameter.
+        std::vector<float> _partial;
+        unsigned _nPartial;
+        double _partialTimestamp;
+
+        // Scratch buffers for the Y polarisation (one per thread), laid out
+        // as the channeliser scratch buffers.
+        std::vector<Complex*> _filteredDataY;
+};
+
+// Declare this class as a pelican module.
+PELICAN_DECLARE_MODULE(PPFStokesIntegrator)
+
+}// namespace ampp
+}// namespace pelican
+
+#endif // PPF_STOKES_INTEGRATOR_H_
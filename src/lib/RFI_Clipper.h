@@ -8,7 +8,9 @@
 #include <functional>
 #include <vector>
 #include "BandPass.h"
+#include "RFI_Statistics.h"
 #include <boost/circular_buffer.hpp>
+#include <QtCore/QMutex>
 /**
  * @file RFI_Clipper.h
  */
@@ -18,13 +20,58 @@ namespace pelican {
 namespace ampp {
     class SpectrumDataSetStokes;
     class WeightedSpectrumDataSet;
+    class BandPassLoader;
 /**
  * @class RFI_Clipper
  *  
  * @brief
  *    Remove any Radio Frequency Interference by comparision with a bandpass filter
  * @details
- * 
+ *
+ * A chunk is processed in three passes. The band statistics of each
+ * spectrum used while training the running averages, and the final
+ * flattening and normalisation of each spectrum, only depend on that
+ * spectrum and are computed in parallel over spectra using
+ * @b processingThreads threads (default 1). Channel clipping and the
+ * running average updates depend on the preceding spectra and are done in
+ * order in between. Each spectrum goes through exactly the same arithmetic
+ * as when processed alone, so the output does not depend on the number of
+ * threads.
+ *
+ * To match the data to the bandpass model the spectrum is split into
+ * @b Bands equal bands (default 8), whose minima, means and RMSs are
+ * computed as vectorised reductions over each band's contiguous slices.
+ *
+ * With @b ChannelMask history set to N chunks, channels whose clip rate
+ * over the last N chunks is an outlier (more than @b threshold MADs above
+ * the median rate over channels, default 5, and above @b minFraction,
+ * default 0.5) are masked: they are replaced by the last good spectrum
+ * without being tested, and are tested again once their history expires.
+ *
+ * Channels whose weight was already set to zero by an upstream flagger
+ * (e.g. SpectralKurtosisFlagger) are clipped without being tested.
+ *
+ * The bandpass model can be replaced without restarting: with
+ * @b BandPassData watch set to an interval in milliseconds, the file is
+ * polled from a background thread and a new version is parsed there, and
+ * models from a remote BandPass stream can be passed to updateBandPass().
+ * A new model is swapped in at the start of the next chunk, keeping the
+ * running statistics, so no retraining is needed; bandPassUpdates()
+ * counts the swaps.
+ *
+ * The statistics of each chunk (running mean and RMS, percentages of
+ * clipped spectra and channels, and the clip count of each channel) are
+ * available from stats() after run(), for pipelines to publish with
+ * dataOutput(), e.g. on the "RFI_Statistics" stream.
+ *
+ @verbatim
+ <RFI_Clipper active="true" channelRejectionRMS="10.0" spectrumRejectionRMS="6.0">
+   <BandPassData file="bandpass.bp" watch="1000" />
+   <processingThreads value="4" />
+   <Bands number="8" />
+   <ChannelMask history="16" threshold="5.0" minFraction="0.5" />
+ </RFI_Clipper>
+ @endverbatim
  */
 
 class RFI_Clipper : public AbstractModule
@@ -36,11 +83,45 @@ class RFI_Clipper : public AbstractModule
         void getLOFreqFromRedis();
         void run( WeightedSpectrumDataSet* weightedStokes );
         const BandPass& bandPass() const { return _bandPass; }; // return the BandPass Filter in use
+        /// Use a new bandpass model from the next chunk (thread safe)
+        void updateBandPass( const BandPass& bandPass );
+        /// Statistics of the last chunk processed
+        const RFI_Statistics& stats() const { return _stats; }
+        /// Channels masked for the next chunk (non-zero if masked)
+        const std::vector<unsigned char>& channelMask() const { return _channelMask; }
+        /// Number of times a new bandpass model has been swapped in
+        unsigned bandPassUpdates() const { return _bandPassUpdates; }
+
+    private:
+        /// Swap in a new bandpass model if one is available.
+        bool _swapBandPass();
+
+        /// Compute the band statistics of spectrum @p t used while training.
+        void _bandStatistics( SpectrumDataSetStokes* stokesAll,
+                              const QVector<float>& bandPass, unsigned t,
+                              float* scratch,
+                              float& spectrumRMS, float& dataModel ) const;
+
+        /// Clear the channel mask for spectra of @p nBins channels.
+        void _resetChannelMask( unsigned nBins );
+
+        /// Update the channel mask with the clip counts of the last chunk.
+        void _updateChannelMask( unsigned nSamples );
+
+        /// Flatten and normalise spectrum @p t.
+        void _normalise( SpectrumDataSetStokes* stokesAll,
+                         const QVector<float>& bandPass, unsigned t,
+                         float dataModel, float meanRunAve ) const;
 
     private:
         BinMap  _map;
         //        std::vector<float> _copyI;
         BandPass  _bandPass;
+        BandPassLoader* _loader; // watches the bandpass file, if enabled
+        BandPass _nextBandPass; // staged by updateBandPass()
+        bool _haveNextBandPass;
+        QMutex _nextBandPassMutex; // guards the staged model
+        bool _bandMatching;
         bool _active;
         float _LOFreq;
         float _startFrequency;
@@ -56,7 +137,41 @@ class RFI_Clipper : public AbstractModule
         int _maxHistory; // max size of history buffer
 // flag for removing median from each spectrum, equivalent to the zero-DMing technique
         int _zeroDMing; 
+        int _useMeanOverRMS;
+        float _meanOverRMS;
+        float _lastGoodMean, _lastGoodRMS;
+        unsigned _remainingZeros; // channels of _lastGoodSpectrum not yet set
         std::vector<float> _lastGoodSpectrum;
+        RFI_Statistics _stats;
+        unsigned _nThreads;
+        unsigned _nBands; // bands the spectrum is split into for matching
+
+        // Mask of persistently bad channels, from the clip rates of each
+        // channel over the last _maskHistory chunks (0 disables it).
+        unsigned _maskHistory;
+        float _maskThreshold; // MADs above the median rate to mask
+        float _maskMinFraction; // minimum clip rate to mask
+        std::vector<unsigned char> _channelMask;
+        std::vector<unsigned> _maskedChannels;
+        std::vector<unsigned> _maskClips, _maskTested; // window sums
+        std::vector<unsigned> _maskHistoryClips, _maskHistoryTested; // per chunk
+        std::vector<float> _maskRates; // scratch
+        unsigned _maskChunk; // oldest chunk of the window
+
+        // Per spectrum values of the current chunk: band statistics
+        // (training only) and the model and running mean to normalise with.
+        std::vector<float> _bandRMS, _bandModel;
+        std::vector<float> _dataModel, _meanRunAves;
+
+        // Preallocated scratch: good channel counts per band, and the
+        // band statistics work arrays of each thread.
+        std::vector<unsigned> _bandStart; // first bin of each band, and nBins
+        std::vector<float> _bandModelMin; // bandpass minimum in each band
+        std::vector<float> _goodChannels;
+        std::vector<unsigned> _maskedInBand; // masked channels in each band
+        std::vector<float> _bandScratch;
+        unsigned _bandScratchSize;
+        unsigned _bandPassUpdates;
 };
 
 PELICAN_DECLARE_MODULE(RFI_Clipper)
@@ -0,0 +1,88 @@
+#ifndef RFI_STATISTICS_H
+#define RFI_STATISTICS_H
+
+#include "BlobStatistics.h"
+#include <vector>
+
+/**
+ * @file RFI_Statistics.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+
+/**
+ * @class RFI_Statistics
+ *
+ * @brief
+ *    Per chunk statistics of the RFI_Clipper
+ * @details
+ * Holds the running mean and RMS of the clipper (as BlobStatistics), the
+ * percentage of spectra and channels clipped in the chunk, and the number
+ * of times each channel was clipped by the channel threshold. The blob is
+ * serialised in binary (host byte order) so it can be written out through
+ * a pipeline data output stream, e.g. to a DataBlobFile, and monitored
+ * offline.
+ */
+
+class RFI_Statistics : public BlobStatistics
+{
+    public:
+        RFI_Statistics();
+        ~RFI_Statistics();
+
+        /// Clear the statistics for a chunk of @p nSpectra spectra of
+        /// @p nChannels channels.
+        void reset( unsigned nSpectra, unsigned nChannels );
+
+        /// Timestamp of the first spectrum of the chunk.
+        double timestamp() const { return _timestamp; }
+        void setTimestamp( double timestamp ) { _timestamp = timestamp; }
+
+        /// Number of spectra in the chunk.
+        unsigned nSpectra() const { return _nSpectra; }
+
+        /// Number of spectra clipped in the chunk.
+        unsigned nBadSpectra() const { return _nBadSpectra; }
+        void addBadSpectrum() { ++_nBadSpectra; }
+
+        /// Number of channels clipped in the chunk, over all spectra.
+        unsigned nBadChannels() const { return _nBadChannels; }
+        void addBadChannels( unsigned n ) { _nBadChannels += n; }
+
+        /// Percentage of spectra clipped in the chunk.
+        float percentBadSpectra() const;
+
+        /// Percentage of channels clipped in the chunk.
+        float percentBadChannels() const;
+
+        /// Number of times each channel was clipped in the chunk.
+        const std::vector<unsigned>& clipCounts() const { return _clipCounts; }
+        unsigned* clipCounts() { return &_clipCounts[0]; }
+
+        // keep the BlobStatistics overloads visible
+        using BlobStatistics::serialise;
+        using BlobStatistics::deserialise;
+
+        /// Returns the number of serialised bytes.
+        quint64 serialisedBytes() const;
+
+        /// Serialises the data blob.
+        void serialise(QIODevice&) const;
+
+        /// Deserialises the data blob.
+        void deserialise(QIODevice&, QSysInfo::Endian);
+
+    private:
+        double _timestamp;
+        unsigned _nSpectra;
+        unsigned _nBadSpectra;
+        unsigned _nBadChannels;
+        std::vector<unsigned> _clipCounts;
+};
+PELICAN_DECLARE_DATABLOB(RFI_Statistics)
+
+} // namespace ampp
+} // namespace pelican
+#endif // RFI_STATISTICS_H
@@ -0,0 +1,108 @@
+#ifndef SPECTRAL_KURTOSIS_FLAGGER_H
+#define SPECTRAL_KURTOSIS_FLAGGER_H
+
+/**
+ * @file SpectralKurtosisFlagger.h
+ */
+
+#include "pelican/modules/AbstractModule.h"
+#include "pelican/utility/ConfigNode.h"
+
+#include <vector>
+
+namespace pelican {
+
+class ConfigNode;
+
+namespace ampp {
+
+class SpectrumDataSetC32;
+class WeightedSpectrumDataSet;
+
+/**
+ * @class SpectralKurtosisFlagger
+ *
+ * @brief
+ * Flags RFI in channelised voltages using the spectral kurtosis estimator.
+ *
+ * @details
+ * For each channel the powers P of @b window consecutive spectra
+ * (default 0, the whole chunk) of the PPFChanneliser output are summed to
+ * S1 = sum(P) and S2 = sum(P^2), and the spectral kurtosis
+ *
+ *   SK = (M + 1) / (M - 1) * (M * S2 / S1^2 - 1)
+ *
+ * is formed for each polarisation, M being the number of spectra. For
+ * Gaussian noise SK has mean 1 and variance 4M^2 / ((M-1)(M+2)(M+3));
+ * a channel whose SK is more than @b threshold standard deviations
+ * (default 3) from 1 in any polarisation has its Stokes data and weights
+ * set to zero for all spectra and Stokes parameters of the window, which is
+ * what DedispersionBuffer expects of samples it replaces with noise.
+ * RFI_Clipper replaces zero weight channels by its last good spectrum, as
+ * it does for the channels it clips. Windows of fewer than two spectra at
+ * the end of a chunk are not flagged.
+ *
+ * The weights must already be sized for the Stokes data generated from the
+ * spectra, so run() is called after WeightedSpectrumDataSet::reset() (and
+ * so after StokesGenerator) and before RFI_Clipper.
+ * Sub-bands are distributed over @b processingThreads threads (default 4)
+ * and the power sums are vectorised over blocks of channels, accumulated
+ * over the window in registers.
+ *
+ @verbatim
+ <SpectralKurtosisFlagger>
+     <window value="256"/>
+     <threshold sigma="3.0"/>
+     <processingThreads value="4"/>
+ </SpectralKurtosisFlagger>
+ @endverbatim
+ */
+
+class SpectralKurtosisFlagger : public AbstractModule
+{
+    public:
+        /// Constructor.
+        SpectralKurtosisFlagger(const ConfigNode& config);
+
+        /// Destructor.
+        ~SpectralKurtosisFlagger();
+
+        /// Flag the spectra, zeroing the data and weights of flagged channels.
+        void run(const SpectrumDataSetC32* spectra,
+                WeightedSpectrumDataSet* weightedStokes);
+
+        /// Returns the fraction of channels and windows flagged by the last
+        /// call to run().
+        float flaggedFraction() const { return _flaggedFraction; }
+
+    private:
+        /// Flag the channels of sub-band @p s in spectra [t0, t0 + m).
+        unsigned _flagWindow(const SpectrumDataSetC32* spectra,
+                WeightedSpectrumDataSet* weightedStokes, unsigned s,
+                unsigned t0, unsigned m, float* scratch) const;
+
+        /// Sum powers of @p n channels from @p c0 over spectra [t0, t0 + m).
+        static void _sumPowers(const SpectrumDataSetC32* spectra, unsigned s,
+                unsigned p, unsigned t0, unsigned m, unsigned c0, unsigned n,
+                float* s1, float* s2);
+
+    private:
+        // Channels whose power sums are accumulated together.
+        static const unsigned BLOCK = 16;
+
+        unsigned _window;
+        float _threshold;
+        unsigned _nThreads;
+        float _flaggedFraction;
+
+        // Per thread sums of powers, squared powers and flags of a sub-band.
+        std::vector<float> _scratch;
+};
+
+
+// Declare this class as a pelican module.
+PELICAN_DECLARE_MODULE(SpectralKurtosisFlagger)
+
+}// namespace ampp
+}// namespace pelican
+#endif // SPECTRAL_KURTOSIS_FLAGGER_H
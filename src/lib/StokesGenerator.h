@@ -24,12 +24,35 @@ class SpectrumDataSetStokes;
  * @class StokesGenerator
  *
  * @details Module used for converting a collection of spectra from X,Y polarisations to stokes parameters.
-
  *
+ * Example configuration node :
+ *
+ @verbatim
+ 		<StokesGenerator name="">
+ 			<stokes value="IQUV"/>
+ 			<processingThreads value="4"/>
+ 		</StokesGenerator>
+ @endverbatim
+ *
+ * - @b stokes: The parameters generated: "I", "IQUV" or "XXYY" (the power
+ *   of each polarisation, as used for the two EMBRACE pointings). If not
+ *   given, @b numberOfStokes (1 or 4, default 4) selects "I" or "IQUV".
+ *
+ * - @b processingThreads: The number of threads to parallelise over
+ *   (default 4).
+ *
+ * The selected parameters are formed by a kernel specialised at compile
+ * time for each mode, so the channel loop has no branches and vectorises.
+ * All spectra are processed in a single parallel region over
+ * (time block, sub-band) tiles.
  */
 
 class StokesGenerator : public AbstractModule
 {
+    public:
+        typedef std::complex<float> Complex;
+        typedef enum { STOKES_I, STOKES_IQUV, STOKES_XXYY } Mode;
+
     public:
         /// Constructor.
         StokesGenerator(const ConfigNode& config);
@@ -46,9 +69,31 @@ class StokesGenerator : public AbstractModule
         void run(const TimeSeriesDataSetC32* streamData,
                 SpectrumDataSetStokes* stokes);
 
+    public:
+        /// Returns the number of parameters generated in the mode.
+        static unsigned nStokes(Mode mode)
+        { return mode == STOKES_I ? 1 : (mode == STOKES_IQUV ? 4 : 2); }
+
+        /// Generates the Stokes parameters of all spectra using the
+        /// specified number of threads.
+        template <Mode mode>
+        static void generate(const SpectrumDataSetC32* spectra,
+                SpectrumDataSetStokes* stokes, unsigned nThreads);
+
+    private:
+        /// Forms the parameters of @p n channels of the X and Y spectra.
+        template <Mode mode>
+        static void _formStokes(const Complex* X, const Complex* Y, unsigned n,
+                float* const out[4]);
+
+        /// Generates the parameters of each sample of a time series.
+        template <Mode mode>
+        static void _generate(const TimeSeriesDataSetC32* streamData,
+                SpectrumDataSetStokes* stokes, unsigned nThreads);
+
     private:
-        float _sqr(float x) { return x * x; }
-        unsigned _numberOfStokes;
+        Mode _mode;
+        unsigned _nThreads;
 };
 
 // Declare this class as a pelican module.
@@ -28,9 +28,22 @@ class SpectrumDataSetStokes;
  * 
  * Relevant config option from xml file 
  @verbatim
- code
+ 		<StokesIntegrator name="">
+ 			<integrateTimeBins value="16"/>
+ 			<integrateFrequencyChannels value="1"/>
+ 			<processingThreads value="4"/>
+ 		</StokesIntegrator>
  @endverbatim
  *
+ * Spectra are integrated as a stream: a window which is not completed by
+ * the end of a chunk is kept as a partial sum and completed by the next
+ * call, so chunks need not be a multiple of integrateTimeBins long. Each
+ * call outputs one spectrum per window completed in it (possibly none),
+ * timestamped with the first spectrum of the first completed window.
+ *
+ * Time and frequency binning are done in a single pass, with (sub-band,
+ * polarisation) items distributed over @b processingThreads threads
+ * (default 4).
  */
 
 class StokesIntegrator : public AbstractModule
@@ -47,10 +60,27 @@ class StokesIntegrator : public AbstractModule
         //	void run(const SubbandTimeSeriesC32* streamData,
         //      	SubbandSpectraStokes* stokes);
 
+    private:
+        /// Add a spectrum to an output spectrum, binning channels.
+        void _accumulate(const float* in, float* out, unsigned nOutChannels);
+
+        /// Reset the partial window for data of the specified dimensions.
+        void _resetPartial(unsigned nSubbands, unsigned nPols,
+                unsigned nOutChannels);
+
     private:
         unsigned _windowSize;
 	unsigned _binChannels;
-	//	unsigned timeStart;
+        unsigned _nThreads;
+
+        // Sum of the spectra of the incomplete window (sub-band, pol and
+        // channel ordered), the number of spectra in it and the timestamp
+        // of its first spectrum.
+        std::vector<float> _partial;
+        unsigned _nPartial;
+        double _partialTimestamp;
+        unsigned _nSubbands;
+        unsigned _nPols;
 };
 
 
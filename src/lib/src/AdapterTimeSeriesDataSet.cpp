@@ -60,6 +60,14 @@ AdapterTimeSeriesDataSet::AdapterTimeSeriesDataSet(const ConfigNode& config)
     _dataTemp.resize(_dataSize);
     _paddingTemp.resize(_paddingSize + 1);
 
+    // A chunk which is not a whole number of output blocks is adapted into
+    // blocks of one packet each (see _checkData()).
+    unsigned nTimesTotal = _nSamplesPerPacket * _nUDPPacketsPerChunk;
+    if (_nSamplesPerTimeBlock != 0 && nTimesTotal % _nSamplesPerTimeBlock != 0)
+        cerr << "WARNING: " << _err("%1 samples per chunk is not a multiple of "
+                "%2 output channels; using blocks of %3 samples.")
+                .arg(nTimesTotal).arg(_nSamplesPerTimeBlock)
+                .arg(_nSamplesPerPacket).toStdString() << endl;
 }
 
 
@@ -179,15 +187,16 @@ void AdapterTimeSeriesDataSet::_checkData()
         throw _err("Dimensions decribe more data than fits into a UDP packet! "
                 " (%1 > %2").arg(usefulBits).arg(udpDataBits);
 
+    // If the chunk is not a whole number of blocks use one block per packet;
+    // the channeliser carries the incomplete spectrum over to the next chunk.
     unsigned nTimesTotal = _nSamplesPerPacket * _nUDPPacketsPerChunk;
-    if (nTimesTotal % _nSamplesPerTimeBlock != 0)
-        throw _err("Number of time samples must be evenly divisible by the "
-                "number of samples in a block.");
+    unsigned nTimesPerBlock = (nTimesTotal % _nSamplesPerTimeBlock == 0) ?
+            _nSamplesPerTimeBlock : _nSamplesPerPacket;
 
     // Resize the time stream data blob to match the adapter dimensions.
-    unsigned nBlocks = nTimesTotal / _nSamplesPerTimeBlock;
+    unsigned nBlocks = nTimesTotal / nTimesPerBlock;
     _timeData = (TimeSeriesDataSetC32*)_data;
-    _timeData->resize(nBlocks, _nSubbands, _nPolarisations, _nSamplesPerTimeBlock);
+    _timeData->resize(nBlocks, _nSubbands, _nPolarisations, nTimesPerBlock);
 }
 
 
@@ -218,6 +227,7 @@ void AdapterTimeSeriesDataSet::_readData(unsigned packet, char* buffer,
         TimeSeriesDataSetC32* data)
 {
     unsigned time0 = packet * _nSamplesPerPacket;
+    unsigned nTimesPerBlock = data->nTimesPerBlock();
 
     // Loop over dimensions in the packet and write into the data blob.
     unsigned iTimeBlock, index;
@@ -231,10 +241,10 @@ void AdapterTimeSeriesDataSet::_readData(unsigned packet, char* buffer,
             TYPES::i8complex i8c;
             for (unsigned s = 0; s < _nSubbands; ++s) {
                 for (unsigned t = 0; t < _nSamplesPerPacket; ++t) {
-                    iTimeBlock = (time0 + t) / _nSamplesPerTimeBlock;
+                    iTimeBlock = (time0 + t) / nTimesPerBlock;
                     for (unsigned p = 0; p < _nPolarisations; ++p) {
                         times = data->timeSeriesData(iTimeBlock, s, p);
-                        index = time0 - (iTimeBlock * _nSamplesPerTimeBlock) + t;
+                        index = time0 - (iTimeBlock * nTimesPerBlock) + t;
                         i8c = *reinterpret_cast<TYPES::i8complex*>(&buffer[iPtr]);
                         times[index] = _makeComplex(i8c);
                         iPtr += sizeof(TYPES::i8complex);
@@ -256,14 +266,14 @@ void AdapterTimeSeriesDataSet::_readData(unsigned packet, char* buffer,
             for (unsigned s = 0; s < _nSubbands; ++s) {
                 for (unsigned t = 0; t < _nSamplesPerPacket; ++t) {
 
-                    iTimeBlock = (time0 + t) / _nSamplesPerTimeBlock;
+                    iTimeBlock = (time0 + t) / nTimesPerBlock;
 
-                    index = time0 - (iTimeBlock * _nSamplesPerTimeBlock) + t;
+                    index = time0 - (iTimeBlock * nTimesPerBlock) + t;
 
                     //                    times0 = data->timeSeriesData(iTimeBlock, s, 0);
                     //                    times1 = data->timeSeriesData(iTimeBlock, s, 1);
-                    times0 = &times0start[_nSamplesPerTimeBlock*(nTimeBlocks*(s*nPols+0)+iTimeBlock)];
-                    times1 = &times0start[_nSamplesPerTimeBlock*(nTimeBlocks*(s*nPols+1)+iTimeBlock)];
+                    times0 = &times0start[nTimesPerBlock*(nTimeBlocks*(s*nPols+0)+iTimeBlock)];
+                    times1 = &times0start[nTimesPerBlock*(nTimeBlocks*(s*nPols+1)+iTimeBlock)];
 
 
                     //printf("Times0 pointer: %p \n", times0);
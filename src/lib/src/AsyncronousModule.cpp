@@ -2,6 +2,7 @@
 #include <QtConcurrentRun>
 #include "GPU_Manager.h"
 #include "GPU_NVidia.h"
+#include "GPU_Host.h"
 #include <boost/bind.hpp>
 #include <iostream>
 
@@ -10,6 +11,7 @@ namespace pelican {
 
 namespace ampp {
 
+bool AsyncronousModule::_nvidiaResources = false;
 
 /**
  *@details AsyncronousModule 
@@ -25,7 +27,16 @@ AsyncronousModule::AsyncronousModule( const ConfigNode& config )
    // down an appropriately configured gpuManager in the 
    // constructor.
    if( gpuManager()->resources() == 0 ) {
-       GPU_NVidia::initialiseResources( gpuManager() );
+#ifdef CUDA_FOUND
+       if( config.getOption("device", "type", "gpu") != "cpu" ) {
+           GPU_NVidia::initialiseResources( gpuManager() );
+           _nvidiaResources = gpuManager()->resources() > 0;
+       }
+#endif
+       // run on the host if there are no cards to use
+       if( gpuManager()->resources() == 0 )
+           GPU_Host::initialiseResources( gpuManager(),
+                   config.getOption("device", "threads", "0").toUInt() );
    }
 }
 
@@ -27,6 +27,14 @@ void BandPass::setData(const BinMap& map,const QVector<float>& params ) {
     _primaryMap = map;
     _primaryMapId = map.hash();
     _params = params;
+    // data sets for any previous parameters are no longer valid
+    float rms = _rms.value(_primaryMapId, 0.0f);
+    _dataSets.clear();
+    _maps.clear();
+    _rms.clear();
+    _median.clear();
+    _mean.clear();
+    _rms[_primaryMapId] = rms;
     reBin( map );
 
     // calculate the median & mean for the primary map
@@ -45,18 +53,36 @@ void BandPass::setRMS(float rms) {
     _rms[_currentMapId] = rms;
 }
 
+void BandPass::setMean(float mean) {
+    _mean[_currentMapId] = mean;
+}
+
 void BandPass::setMedian(float median) {
     float delta = median - _median[_currentMapId];
     if( std::fabs(delta) > 0.0f ) {
-        // set the new median and rescale the polynomial
+        // set the new median and offset the polynomial
         float scale = _currentMap.width()/_primaryMap.width();
-        _median[_currentMapId] = median;
-        _median[_primaryMapId] = median / scale;
         _params[0] += delta/scale;
-        _mean[_currentMapId] += delta;
+        _median[_primaryMapId] += delta / scale;
         _mean[_primaryMapId] += delta / scale;
-        _dataSets.clear();
-        _buildData(_currentMap, scale, delta);
+        // offset every cached data set by the change in its scaled
+        // constant term, keeping the killed channels at zero
+        QHash<int, QVector<float> >::iterator it;
+        for( it = _dataSets.begin(); it != _dataSets.end(); ++it ) {
+            const BinMap& map = _maps[it.key()];
+            float offset = delta * (map.width()/_currentMap.width());
+            float* data = it.value().data();
+            int n = it.value().size();
+            for( int i = 0; i < n; ++i ) {
+                data[i] += offset;
+            }
+            _zeroChannelsMap(map);
+            if( it.key() != _primaryMapId ) {
+                _median[it.key()] += offset;
+                _mean[it.key()] += offset;
+            }
+        }
+        _median[_currentMapId] = median;
     }
 }
 
@@ -87,9 +113,19 @@ void BandPass::reBin(const BinMap& map)
 
 void BandPass::_buildData(const BinMap& map, float scale, float /*offset*/) {
     int mapId = map.hash();
-    _dataSets.insert(mapId, QVector<float>(map.numberBins()) );
-    for( unsigned int i=0; i < map.numberBins(); ++i ) {
-        _dataSets[mapId][i] = scale * _evaluate(map.binAssignmentNumber(i));
+    unsigned int nBins = map.numberBins();
+    QVector<float>& data = _dataSets[mapId];
+    data.resize(nBins);
+    _maps.insert(mapId, map);
+
+    QVector<float> frequency(nBins);
+    for( unsigned int i=0; i < nBins; ++i ) {
+        frequency[i] = map.binAssignmentNumber(i);
+    }
+    float* out = data.data();
+    _evaluate(frequency.constData(), out, nBins);
+    for( unsigned int i=0; i < nBins; ++i ) {
+        out[i] *= scale;
     }
     _zeroChannelsMap(map);
 }
@@ -138,19 +174,42 @@ bool BandPass::filterBin( unsigned int index ) const
 void BandPass::killBand( float start, float end)
 {
     _killed = _killed + Range<float>(start,end);
-    foreach( const BinMap& map, _dataSets.keys() ) {
+    foreach( const BinMap& map, _maps ) {
         _zeroChannelsMap(map);
     }
 }
 
 float BandPass::_evaluate(float v) const
 {
-   float tot = 0.0;
-   for(int i=0; i< _params.size(); ++i ) {
-        tot += _params[i]*std::pow(v,i);
+   // Horner's scheme
+   int i = _params.size() - 1;
+   float tot = _params[i];
+   while( --i >= 0 ) {
+        tot = tot * v + _params[i];
    }
    return tot;
 }
 
+/**
+ * @details
+ * Evaluates the polynomial at @p n values by Horner's scheme, with the
+ * loop over values innermost so that it vectorises.
+ */
+void BandPass::_evaluate(const float* x, float* out, unsigned n) const
+{
+   int i = _params.size() - 1;
+   float top = _params[i];
+   for( unsigned j = 0; j < n; ++j ) {
+        out[j] = top;
+   }
+   while( --i >= 0 ) {
+        float p = _params[i];
+        #pragma omp simd
+        for( unsigned j = 0; j < n; ++j ) {
+            out[j] = out[j] * x[j] + p;
+        }
+   }
+}
+
 } // namespace ampp
 } // namespace pelican
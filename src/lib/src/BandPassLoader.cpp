@@ -0,0 +1,101 @@
+#include "BandPassLoader.h"
+#include "BandPassAdapter.h"
+#include "BandPass.h"
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+#include <iostream>
+
+namespace pelican {
+
+namespace ampp {
+
+
+/**
+ *@details BandPassLoader
+ * The current version of the file is taken as already loaded.
+ */
+BandPassLoader::BandPassLoader( const ConfigNode& config,
+                                const QString& fileName,
+                                unsigned long interval )
+    : QThread(), _config(config), _fileName(fileName), _interval(interval),
+      _stop(false), _pending(0)
+{
+    QFileInfo info(_fileName);
+    _lastModified = info.lastModified();
+    _lastSize = info.size();
+    start();
+}
+
+/**
+ *@details
+ */
+BandPassLoader::~BandPassLoader()
+{
+    {
+        QMutexLocker lock(&_mutex);
+        _stop = true;
+        _wake.wakeAll();
+    }
+    wait();
+    delete _pending;
+}
+
+BandPass* BandPassLoader::take()
+{
+    if( ! _mutex.tryLock() ) return 0;
+    BandPass* bp = _pending;
+    _pending = 0;
+    _mutex.unlock();
+    return bp;
+}
+
+void BandPassLoader::run()
+{
+    QMutexLocker lock(&_mutex);
+    while( ! _stop ) {
+        _wake.wait(&_mutex, _interval);
+        if( _stop ) break;
+
+        QFileInfo info(_fileName);
+        if( ! info.exists() ) continue;
+        if( info.lastModified() == _lastModified && info.size() == _lastSize )
+            continue;
+        _lastModified = info.lastModified();
+        _lastSize = info.size();
+
+        // parse without holding the lock, so take() is never held up
+        lock.unlock();
+        BandPass* bp = _load();
+        lock.relock();
+        if( bp ) {
+            delete _pending;
+            _pending = bp;
+        }
+    }
+}
+
+BandPass* BandPassLoader::_load()
+{
+    QFile dataFile(_fileName);
+    if( ! dataFile.open(QIODevice::ReadOnly | QIODevice::Text) ) {
+        std::cerr << "BandPassLoader: Cannot open File \""
+                  << _fileName.toStdString() << "\"" << std::endl;
+        return 0;
+    }
+    BandPass* bp = new BandPass;
+    try {
+        BandPassAdapter adapter(_config);
+        adapter.config(bp, dataFile.size());
+        adapter.deserialise(&dataFile);
+    }
+    catch( QString e ) {
+        std::cerr << "BandPassLoader: " << e.toStdString() << std::endl;
+        delete bp;
+        return 0;
+    }
+    return bp;
+}
+
+} // namespace ampp
+} // namespace pelican
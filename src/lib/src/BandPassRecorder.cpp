@@ -1,34 +1,35 @@
 #include "BandPassRecorder.h"
 #include <QtCore/QVector>
-#include <stdlib.h>
-//#include <clapack.h>
+#include <QtCore/QString>
 #include "BandPass.h"
+#include "BinMap.h"
 #include "SpectrumDataSet.h"
-
-extern "C" void sgels_(const char*, const int*, const int*,const int*, float*,const int*, float*, int*, float*, int*, int*);
+#include <algorithm>
+#include <cmath>
 
 namespace pelican {
 namespace ampp {
 
-int BandPassRecorder::sgels(int n, int m, int nrhs,
-                        float *A, int lda, float *B, int ldb,
-                        float *workSpace, int* work )
-{
-    int info;
-    sgels_((const char*)'N', &n, &m, &nrhs, A, &lda, B, &ldb, workSpace, work,
-            &info);
-    return info;
-}
-
 /**
  *@details BandPassRecorder
  */
 BandPassRecorder::BandPassRecorder( const ConfigNode& config )
-    : AbstractModule( config )
+    : AbstractModule( config ), _nBins(0), _nFits(0), _totalSamples(0.0),
+      _samplesSinceFit(0), _centre(0.0), _halfWidth(1.0)
 {
     _requiredSamples = config.getOption("requiredSamples", "value", "20000").toULong();
     _polyDegree = config.getOption("fitParmaters", "coefficients", "3" ).toUInt();
-    _totalSamples = 0;
+    _refitSamples = config.getOption("refit", "samples",
+                    QString::number(_requiredSamples)).toULong();
+    _decay = config.getOption("refit", "decay", "0.0").toDouble();
+    _continuous = config.getOption("refit", "continuous", "false") == "true";
+
+    if( _polyDegree < 1 )
+        throw(QString("BandPassRecorder: <fitParmaters coefficients=?> must be at least 1"));
+    if( _requiredSamples == 0 || _refitSamples == 0 )
+        throw(QString("BandPassRecorder: <requiredSamples> and <refit samples> must be at least 1"));
+    if( _decay < 0.0 || _decay > 1.0 )
+        throw(QString("BandPassRecorder: <refit decay=?> must be between 0 and 1"));
 
     if( config.getOption("Band", "startFrequency" ) == "" ) {
         throw(QString("BandPassRecorder: <Band startFrequency=?> not defined"));
@@ -46,22 +47,40 @@ BandPassRecorder::~BandPassRecorder() {
 
 void BandPassRecorder::_reset(const BinMap& map) {
 
-    unsigned int size = map.numberBins();
-    _sum.resize(size);
-    _freq.resize(size);
-    _freqMatrix.resize(size * _polyDegree);
-    _valueMatrix.resize( _polyDegree );
+    _nBins = map.numberBins();
+    _sum.assign(_nBins, 0.0);
+    _sumSquared.assign(_nBins, 0.0);
+    _excluded.assign(_nBins, 0);
+    _chunkSum.resize(2 * _nBins);
+    _basis.resize(_nBins * _polyDegree);
+    _ata.assign(_polyDegree * _polyDegree, 0.0);
+    _aty.assign(_polyDegree, 0.0);
+    _factor.resize(_polyDegree * _polyDegree);
+    _coeffs.assign(_polyDegree, 0.0);
 
-    for(unsigned int i=0; i < size; ++i ) {
-        int index=i*_polyDegree;
-        _sum[i] = 0.0f;
-        _freq[i] = map.binAssignmentNumber(i);
+    // scale the frequencies to [-1,1] to keep the normal equations
+    // well conditioned
+    _centre = 0.5 * (map.binAssignmentNumber(0) + map.lastBinValue());
+    _halfWidth = 0.5 * std::fabs(map.lastBinValue() - map.binAssignmentNumber(0));
+    if( _halfWidth == 0.0 ) _halfWidth = 1.0;
+    for(unsigned int i=0; i < _nBins; ++i ) {
+        double x = (map.binAssignmentNumber(i) - _centre) / _halfWidth;
+        double xp = 1.0;
         for( int p=0; p < _polyDegree; ++p ) {
-             _freqMatrix[index + p] = std::pow(_freq[i], p);
+             _basis[p * _nBins + i] = xp;
+             xp *= x;
         }
     }
-    _totalSamples = 0;
-    _fit.resize(_polyDegree);
+    for(unsigned int i=0; i < _nBins; ++i ) {
+        for( int p=0; p < _polyDegree; ++p ) {
+            for( int q=0; q < _polyDegree; ++q ) {
+                _ata[p * _polyDegree + q] += _basis[p * _nBins + i] * _basis[q * _nBins + i];
+            }
+        }
+    }
+    _totalSamples = 0.0;
+    _samplesSinceFit = 0;
+    _nFits = 0;
 }
 
 bool BandPassRecorder::run( SpectrumDataSetStokes* stokesI, BandPass* bp ) {
@@ -71,7 +90,7 @@ bool BandPassRecorder::run( SpectrumDataSetStokes* stokesI, BandPass* bp ) {
         unsigned nPolarisations = stokesI->nPolarisations();
         unsigned nBins = nChannels * nSubbands;
 
-        float* I = stokesI->data();
+        const float* I = stokesI->data();
 
         BinMap map(nBins);
         map.setStart(_startFrequency);
@@ -79,111 +98,182 @@ bool BandPassRecorder::run( SpectrumDataSetStokes* stokesI, BandPass* bp ) {
 
         // if data type changes between calls then reset
         // all accumulative variables.
-        if( _sum.size() != nBins || _totalSamples == 0 ) _reset(map);
+        if( _nBins != nBins ) _reset(map);
 
-        // calculate the integrated spectrum
+        // integrate the chunk
+        float* chunkSum = &_chunkSum[0];
+        float* chunkSumSquared = chunkSum + nBins;
+        std::fill(chunkSum, chunkSum + 2 * nBins, 0.0f);
         for (unsigned t = 0; t < nSamples; ++t) {
             for (unsigned s = 0; s < nSubbands; ++s) {
-                int bin = (s * nChannels) - 1;
-                long index = stokesI->index(s, nSubbands,
-                        0, nPolarisations,
-                        t, nChannels );
+                const float* in = I + stokesI->index(s, nSubbands,
+                        0, nPolarisations, t, nChannels );
+                float* sum = chunkSum + s * nChannels;
+                float* sumSquared = chunkSumSquared + s * nChannels;
+                #pragma omp simd
                 for (unsigned c = 0; c < nChannels; ++c) {
-                    ++bin;
-                    _sum[bin+c] += I[index + c];
+                    sum[c] += in[c];
+                    sumSquared[c] += in[c] * in[c];
                 }
             }
         }
+
+        // and add it to the channel sums and normal equations
+        for (unsigned i = 0; i < nBins; ++i) {
+            _sum[i] += chunkSum[i];
+            _sumSquared[i] += chunkSumSquared[i];
+        }
+        for (int p = 0; p < _polyDegree; ++p) {
+            const double* basis = &_basis[p * nBins];
+            double aty = 0.0;
+            for (unsigned i = 0; i < nBins; ++i) {
+                if( ! _excluded[i] ) aty += basis[i] * chunkSum[i];
+            }
+            _aty[p] += aty;
+        }
         _totalSamples += nSamples;
-        if( _totalSamples < _requiredSamples ) return false; // collect more data
+        _samplesSinceFit += nSamples;
+
+        unsigned long due = _nFits == 0 ? _requiredSamples : _refitSamples;
+        if( _samplesSinceFit < due ) return false; // collect more data
 
-        // get averaged values
-        for (unsigned t = 0; t < nBins; ++t) {
-            _sum[t] /= _totalSamples;
+        _fit(map, bp);
+        ++_nFits;
+        _samplesSinceFit = 0;
+
+        // age the accumulated data
+        for (unsigned i = 0; i < nBins; ++i) {
+            _sum[i] *= _decay;
+            _sumSquared[i] *= _decay;
+        }
+        for (int p = 0; p < _polyDegree; ++p) {
+            _aty[p] *= _decay;
         }
+        _totalSamples *= _decay;
+        return true;
+}
 
-        // start fitting to integrated spectrum
-        int trimmed = 0;
-        std::vector<float> residual(nBins);
-        do {
-            _polyFit(  &_sum[0], nBins );
-            // trim away outliers and refit
-            // points > 2sigma
-            float rsum = 0.0f;
-            float rsumSquared = 0.0f;
-            for (unsigned s = 0; s < nBins; ++s) {
-                residual[s] = _sum[s] - _theFit(_freq[s]);
-                rsum += residual[s];
-                rsumSquared += std::pow(residual[s],2);
-            }
-            float residualRms = std::sqrt(rsumSquared/nBins - std::pow((rsum/nBins),2));
-            float margin = 2.0f * residualRms;
-            for (unsigned s = 0; s < nBins; ++s) {
-                if( residual[s] > margin ) {
-                    // chop this value out, setting it to the value of
-                    // the fit function
-                    ++trimmed;
-                    _sum[s] = _theFit(_freq[s]) * _totalSamples;
-                }
+/**
+ * @details
+ * Fits the polynomial to the mean spectrum, rejecting outlying channels,
+ * and sets @p bp to the fit with the RMS of the data.
+ */
+void BandPassRecorder::_fit( const BinMap& map, BandPass* bp )
+{
+    // start fitting to integrated spectrum
+    unsigned trimmed;
+    do {
+        _solve();
+        // trim away outliers and refit
+        // points > 2sigma
+        double rsum = 0.0, rsumSquared = 0.0;
+        unsigned n = 0;
+        for (unsigned s = 0; s < _nBins; ++s) {
+            if( _excluded[s] ) continue;
+            double residual = _sum[s] / _totalSamples - _theFit(s);
+            rsum += residual;
+            rsumSquared += residual * residual;
+            ++n;
+        }
+        double residualRms = std::sqrt(rsumSquared/n - std::pow((rsum/n),2));
+        double margin = 2.0 * residualRms;
+        trimmed = 0;
+        for (unsigned s = 0; s < _nBins; ++s) {
+            if( ! _excluded[s] && _sum[s] / _totalSamples - _theFit(s) > margin ) {
+                _exclude(s);
+                ++trimmed;
             }
-        } while( trimmed ); // iterate until no outliers left
+        }
+    } while( trimmed ); // iterate until no outliers left
 
-        // calculate the rms of the cleaned data
-        float sumInt = 0.0f, sumSquared=0.0f;
-        for (unsigned s = 0; s < nBins; ++s) {
-            sumInt += _sum[s]; sumSquared += std::pow(_sum[s],2);
+    // convert the coefficients of the scaled frequency,
+    // x = (f - centre) / halfWidth, to those of the frequency
+    QVector<float> params(_polyDegree, 0.0f);
+    std::vector<double> power(_polyDegree, 0.0);
+    power[0] = 1.0; // coefficients of ((f - centre) / halfWidth)^k
+    for (int k = 0; k < _polyDegree; ++k) {
+        for (int j = 0; j <= k; ++j) {
+            params[j] += _coeffs[k] * power[j];
         }
-        bp->setData(map, QVector<float>::fromStdVector(_fit ));
-        bp->setRMS( std::sqrt(sumSquared/nBins - std::pow((sumInt/nBins),2) ) );
-        return true;
+        // multiply the power by (f - centre) / halfWidth
+        for (int j = k + 1; j > 0; --j) {
+            if( j < _polyDegree )
+                power[j] = (power[j-1] - _centre * power[j]) / _halfWidth;
+        }
+        power[0] = -_centre * power[0] / _halfWidth;
+    }
+
+    // calculate the rms of the cleaned data
+    double variance = 0.0;
+    unsigned n = 0;
+    for (unsigned s = 0; s < _nBins; ++s) {
+        if( _excluded[s] ) continue;
+        double mean = _sum[s] / _totalSamples;
+        variance += _sumSquared[s] / _totalSamples - mean * mean;
+        ++n;
+    }
+    bp->setData(map, params);
+    bp->setRMS( std::sqrt(std::max(variance / n, 0.0)) );
+}
+
+/**
+ * @details
+ * Solves the normal equations by Cholesky decomposition. A pivot that is
+ * not positive relative to its diagonal element means the included
+ * channels cannot determine all the coefficients; with exactly dependent
+ * equations rounding leaves it near zero with either sign.
+ */
+void BandPassRecorder::_solve()
+{
+    int n = _polyDegree;
+    double* L = &_factor[0];
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double sum = _ata[i * n + j];
+            for (int k = 0; k < j; ++k) sum -= L[i * n + k] * L[j * n + k];
+            if( i == j ) {
+                if( sum <= 1e-10 * _ata[i * n + i] )
+                    throw(QString("BandPassRecorder: the fit does not have full "
+                                  "rank; too few usable channels for %1 coefficients")
+                          .arg(_polyDegree));
+                L[i * n + i] = std::sqrt(sum);
+            }
+            else {
+                L[i * n + j] = sum / L[j * n + j];
+            }
+        }
+    }
+    // forward and back substitution, with the mean spectrum on the right
+    for (int i = 0; i < n; ++i) {
+        double sum = _aty[i] / _totalSamples;
+        for (int k = 0; k < i; ++k) sum -= L[i * n + k] * _coeffs[k];
+        _coeffs[i] = sum / L[i * n + i];
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        double sum = _coeffs[i];
+        for (int k = i + 1; k < n; ++k) sum -= L[k * n + i] * _coeffs[k];
+        _coeffs[i] = sum / L[i * n + i];
+    }
 }
 
-float BandPassRecorder::_theFit(float v) const
+double BandPassRecorder::_theFit(unsigned int i) const
 {
-   float tot = 0.0;
-   for(unsigned int i=0; i< _fit.size(); ++i ) {
-       tot += _fit[i]*std::pow(v,i);
+   double tot = 0.0;
+   for(int p = 0; p < _polyDegree; ++p ) {
+       tot += _coeffs[p] * _basis[p * _nBins + i];
    }
    return tot;
 }
 
-void BandPassRecorder::_polyFit( float* y, int nDataPoints )
+void BandPassRecorder::_exclude(unsigned int i)
 {
-
-    // make a copy of the input data
-    for( int t=0; t < nDataPoints; ++t ) {
-        _valueMatrix[t] = y[t];
-    }
-    int nrhs = 1, lda = nDataPoints, ldb = nDataPoints;
-
-    // Workspace and status variables:
-    float wkopt;
-    float *work; //= workSize;
-    int lwork = -1;
-    int info;
-    info = sgels( nDataPoints, _polyDegree, nrhs,
-            &_freqMatrix[0], lda, &_valueMatrix[0], ldb,
-            &wkopt, &lwork );
-    lwork = (int)wkopt;
-    work = (float*)malloc( lwork*sizeof(float) );
-
-    /* Solve the equations A*X = B */
-    info = sgels( nDataPoints, _polyDegree, nrhs,
-            &_freqMatrix[0], lda, &_valueMatrix[0], ldb,
-            work, &lwork );
-    free(work);
-
-    /* Check for the full rank */
-    if( info > 0 ) {
-            std::cerr << "The diagonal element %i of the triangular factor "
-                      << info;
-            std::cerr << "of A is zero, so that A does not have full rank;\n"
-                      << "the least squares solution could not be computed.\n";
-            exit( 1 );
+    _excluded[i] = 1;
+    for( int p=0; p < _polyDegree; ++p ) {
+        _aty[p] -= _basis[p * _nBins + i] * _sum[i];
+        for( int q=0; q < _polyDegree; ++q ) {
+            _ata[p * _polyDegree + q] -= _basis[p * _nBins + i] * _basis[q * _nBins + i];
+        }
     }
-    // answer has overwritten _valueMatrix
-    //std::vector<float>(_polyDegree) w; w.assign(_valueMatrix,_valueMatrix+_polyDegree);
-    _fit.assign(&_valueMatrix[0],&_valueMatrix[0]+_polyDegree);
 }
 
 } // namespace ampp
@@ -1,12 +1,13 @@
 #include "BinMap.h"
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 
 
 namespace pelican {
 namespace ampp {
 
-QMap< unsigned int, QMap< double, QMap<double, unsigned int> > > BinMap::_unique;
+QHash< BinMapKey, unsigned int > BinMap::_unique;
 unsigned int BinMap::_uniqueCount = 0;
 
 /**
@@ -37,10 +38,12 @@ void BinMap::reset(unsigned int numberOfBins)
 unsigned int BinMap::hash() const
 {
     if (_hash == 0) {
-        if( ! _unique[_nBins][_lower].contains(_width) ) {
-            _unique[_nBins][_lower][_width] = ++_uniqueCount;
+        BinMapKey key = { _nBins, _lower, _width };
+        QHash< BinMapKey, unsigned int >::const_iterator it = _unique.constFind(key);
+        if( it == _unique.constEnd() ) {
+            it = _unique.insert(key, ++_uniqueCount);
         }
-        _hash = _unique[_nBins][_lower][_width];
+        _hash = it.value();
     }
     return _hash;
 }
@@ -100,6 +103,29 @@ bool BinMap::operator<(const BinMap& map) const
      return _lower < map._lower || _nBins < map._nBins || _width < map._width;
 }
 
+bool operator==(const BinMapKey& k1, const BinMapKey& k2)
+{
+    return k1.nBins == k2.nBins && k1.lower == k2.lower && k1.width == k2.width;
+}
+
+/**
+ * @details
+ * Provides a hash value for the BinMap parameters for use with QHash,
+ * from the bit patterns of the values (with -0.0 hashed as 0.0 as they
+ * compare equal).
+ */
+unsigned int qHash(const BinMapKey& key)
+{
+    double values[2] = { key.lower == 0.0 ? 0.0 : key.lower,
+                         key.width == 0.0 ? 0.0 : key.width };
+    quint64 bits[2];
+    memcpy(bits, values, sizeof(bits));
+    quint64 h = key.nBins;
+    h = h * 1000003ULL ^ bits[0];
+    h = h * 1000003ULL ^ bits[1];
+    return (unsigned int)(h ^ (h >> 32));
+}
+
 /**
  * @details
  * Provides a hash value for the BinMap object for use with QHash.
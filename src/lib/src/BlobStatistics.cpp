@@ -14,6 +14,14 @@ BlobStatistics::BlobStatistics(float mean, float rms, float median )
    : DataBlob("BlobStatistics"), _mean(mean), _rms(rms), _median(median)
 {
 }
+/**
+ *@details
+ */
+BlobStatistics::BlobStatistics( const QString& type )
+   : DataBlob(type), _mean(0.0f), _rms(0.0f), _median(0.0f)
+{
+}
+
 /**
  *@details
  */
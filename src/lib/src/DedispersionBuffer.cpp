@@ -8,6 +8,11 @@
 #include "WeightedSpectrumDataSet.h"
 #include <omp.h>
 
+#ifdef __SSE__
+#define DEDISPERSION_BUFFER_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace pelican {
 
 namespace ampp {
@@ -62,33 +67,32 @@ void DedispersionBuffer::dumpbin( const QString& fileName ) const {
     file.close();
 }
 
-  const QList<SpectrumDataSetStokes*>& DedispersionBuffer::copy( DedispersionBuffer* buf, std::vector<float>& noiseTemplate, unsigned int samples, unsigned int lastSample )
+/**
+ * @details
+ * The last samples of this buffer (already transposed, and with the noise
+ * substituted) are copied into the start of buf, which is then given the
+ * blobs they came from. lastSample is the end of the samples taken from
+ * the last blob (0 for the whole blob), so the window may end part way
+ * through it.
+ */
+  const QList<SpectrumDataSetStokes*>& DedispersionBuffer::copy( DedispersionBuffer* buf, std::vector<float>& /*noiseTemplate*/, unsigned int samples, unsigned int lastSample )
 {
+    Q_ASSERT( samples <= _sampleCount && samples <= buf->_nsamp );
+    unsigned int offset = _sampleCount - samples;
+    for( unsigned int row = 0; row < _sampleSize; ++row ) {
+        std::copy( &_timedata[(size_t)row * _nsamp + offset],
+                   &_timedata[(size_t)row * _nsamp + offset] + samples,
+                   &buf->_timedata[(size_t)row * buf->_nsamp] );
+    }
     unsigned int count = 0;
-    unsigned int blobIndex = _inputBlobs.size();
-    unsigned int sampleNum;
-    unsigned int blobSample;
-    // copy the memory
+    int blobIndex = _inputBlobs.size();
     while( count < samples ) {
         Q_ASSERT( blobIndex > 0 );
-        SpectrumDataSetStokes* blob = _inputBlobs[--blobIndex]; // start copying data from the last blob in the previous buffer
-        //        WeightedSpectrumDataSet* wblob;
-        //        wblob->reset(blob);
-        unsigned s = blob->nTimeBlocks();
-        sampleNum = samples - count; // remaining samples
-        if( sampleNum <= s ) {
-            // We have all the samples we need in the current blob
-            buf->_sampleCount = 0; // offset position to write to
-            blobSample = s - sampleNum; // time samples not copied from this blob
-        } else {
-            // Take all the samples from this blob, we will need more
-            buf->_sampleCount = sampleNum - s + (s - lastSample);// offset position to write to
-            blobSample = 0;
-        }
-        // lastSample - blobSample is lastSample for the first iteration, then s - blobSample for all other iterations
-        count += (lastSample - blobSample); // count only the number of samples copied
-        buf->_addSamples( blob, noiseTemplate, &blobSample, lastSample - blobSample );
-        lastSample = s;
+        SpectrumDataSetStokes* blob = _inputBlobs[--blobIndex]; // start from the last blob in this buffer
+        unsigned int end = ( count == 0 && lastSample ) ? lastSample : blob->nTimeBlocks();
+        unsigned int n = std::min( samples - count, end );
+        buf->_firstSample = end - n;
+        count += n;
         buf->_inputBlobs.push_front( blob );
     }
     buf->_sampleCount = samples;
@@ -128,50 +132,8 @@ void DedispersionBuffer::dumpbin( const QString& fileName ) const {
     timerStart(&_addSampleTimer);
     int start = *sampleNumber;
     Q_ASSERT(maxSamples > start);
-    if( _invertChannels ) {
-        int nChannelsMinusOne = nChannels - 1;
-        int nSubbandsMinusOne= nSubbands - 1;
-        // Try varying x, from 6 down.  Also try it with this commented out.
-        //        omp_set_num_threads(6);
-        int s, c;
-        int localSampleCount = _sampleCount - start;    // create a copy for omp to lock
-#pragma omp parallel for private(s,c) schedule(dynamic)
-        for(int t = start; t < (int)maxSamples; ++t ) {
-            for (s = 0; s < (int)nSubbands; ++s ) {
-                int bsize = s*nChannels*_nsamp + localSampleCount + t;
-                float* data = streamData->spectrumData(t, nSubbandsMinusOne - s, 0);
-                const float* weightData = weights->spectrumData(t, nSubbandsMinusOne - s, 0);
-                for (c = 0; c < (int)nChannels; ++c ) {
-                  //                    _timedata[(bsize + (c * _nsamp))] = data[nChannelsMinusOne - c];
-
-                  // The following equation is used to replace data
-                  // samples that have been set to zero by the RFI
-                  // clipper to values from a template noise buffer
-                  // that obbey the distribution that the RFI clipper
-                  // forces
-                  data[nChannelsMinusOne - c]  = data[nChannelsMinusOne - c] - (weightData[nChannelsMinusOne - c] - 1) * noiseTemplate[(bsize + (c * _nsamp))]; // change the data
-                  _timedata[(bsize + (c * _nsamp))] = data[nChannelsMinusOne - c];
-                }
-            }
-        }
-    } else {
-        int s, c;
-        int localSampleCount = _sampleCount - start;    // create a copy for omp to lock
-#pragma omp parallel for private(s,c) schedule(dynamic)
-        for(int t = start; t < (int)maxSamples; ++t) {
-            int sampleOffset = localSampleCount + t;
-            for ( s = 0; s < (int)nSubbands; ++s) {
-                float* data = streamData->spectrumData(t, s, 0);
-                const float* weightData = weights->spectrumData(t, s, 0);
-                int bsize = s*nChannels * _nsamp + sampleOffset;
-                for ( c = 0; c < (int)nChannels; ++c) {
-                  //                    _timedata[ bsize + ( c * _nsamp ) ] = data[c];
-                  data[c] = data[c] - (weightData[c] - 1) * noiseTemplate[bsize + (c * _nsamp)];
-                  _timedata[ bsize + (c * _nsamp)] = data[c];
-                    }
-            }
-        }
-    }
+    transpose( streamData, weights, noiseTemplate, _nsamp, _sampleCount,
+               &_timedata[0], _nsamp, _sampleCount, start, maxSamples, _invertChannels );
     _sampleCount += (maxSamples - start);
     *sampleNumber = maxSamples;
     timerUpdate(&_addSampleTimer);
@@ -179,69 +141,127 @@ void DedispersionBuffer::dumpbin( const QString& fileName ) const {
     return spaceRemaining();
 }
 
-  unsigned DedispersionBuffer::_addSamples( SpectrumDataSetStokes* streamData, std::vector<float>& noiseTemplate, unsigned *sampleNumber, unsigned numSamples ) {
-    Q_ASSERT( streamData != 0 );
-    unsigned int nChannels = streamData->nChannels();
-    unsigned int nSubbands = streamData->nSubbands();
-    unsigned int nPolarisations = streamData->nPolarisations();
-    nPolarisations = 1; // dedispersion on total power only
-    if( nSubbands * nChannels * nPolarisations != _sampleSize ) {
-        std::cerr  << "DedispersionBuffer: input data sample size(" <<  nSubbands * nChannels * nPolarisations
-                   << ") does not match buffer sample size (" << _sampleSize << ")" << std::endl;
-        return spaceRemaining();
+/**
+ * @details
+ * The data are moved in tiles of TILE samples by TILE channels, so each
+ * row of out (and of the noise template) is read or written a cache line
+ * at a time rather than one float per sample. A tile is gathered from
+ * the time major input (reversing the channels if required), the noise
+ * substitution made in time major order and written back to the data
+ * set, and the tile transposed into out.
+ */
+void DedispersionBuffer::transpose( SpectrumDataSetStokes* streamData,
+                                    const SpectrumDataSet<float>* weights,
+                                    const std::vector<float>& noiseTemplate,
+                                    unsigned noiseStride, unsigned noiseColumn,
+                                    float* out, unsigned stride, unsigned column,
+                                    unsigned start, unsigned end, bool invertChannels )
+{
+    if( end <= start ) return;
+    int nChannels = streamData->nChannels();
+    int nSubbands = streamData->nSubbands();
+    int nChannelBlocks = ( nChannels + TILE - 1 ) / TILE;
+    int nTimeBlocks = ( end - start + TILE - 1 ) / TILE;
+    int nTiles = nSubbands * nChannelBlocks * nTimeBlocks;
+    // consecutive tiles share output rows, so keep them on the same thread
+#pragma omp parallel for schedule(static)
+    for( int tile = 0; tile < nTiles; ++tile ) {
+        float data[TILE * TILE]; // time major
+        float timedata[TILE * TILE]; // channel major
+        int rowBlock = tile / nTimeBlocks;
+        int s = rowBlock / nChannelBlocks;
+        int c0 = ( rowBlock % nChannelBlocks ) * TILE;
+        int t0 = start + ( tile % nTimeBlocks ) * TILE;
+        int nc = std::min( (int)TILE, nChannels - c0 );
+        int nt = std::min( (int)TILE, (int)end - t0 );
+        int subband = invertChannels ? nSubbands - 1 - s : s;
+        // with inverted channels, channel c0 + j of the tile is element
+        // last - j of the input spectrum
+        int first = invertChannels ? nChannels - c0 - nc : c0;
+        for( int i = 0; i < nt; ++i ) {
+            const float* in = streamData->spectrumData(t0 + i, subband, 0) + first;
+            _gather( in, data + i * TILE, nc, invertChannels );
+        }
+        if( weights ) {
+            // The following equation is used to replace data
+            // samples that have been set to zero by the RFI
+            // clipper to values from a template noise buffer
+            // that obbey the distribution that the RFI clipper
+            // forces
+            float noise[TILE * TILE]; // channel major, as the template
+            float noiseT[TILE * TILE];
+            const float* noiseRow = &noiseTemplate[( (size_t)s * nChannels + c0 ) * noiseStride
+                                                   + noiseColumn + t0 - start];
+            for( int j = 0; j < nc; ++j ) {
+                std::copy( noiseRow + (size_t)j * noiseStride,
+                           noiseRow + (size_t)j * noiseStride + nt, noise + j * TILE );
+            }
+            _transposeTile( noise, noiseT );
+            for( int i = 0; i < nt; ++i ) {
+                const float* w = weights->spectrumData(t0 + i, subband, 0) + first;
+                float weight[TILE];
+                _gather( w, weight, nc, invertChannels );
+                float* d = data + i * TILE;
+                const float* n = noiseT + i * TILE;
+                for( int j = 0; j < nc; ++j ) {
+                    d[j] = d[j] - (weight[j] - 1) * n[j]; // change the data
+                }
+                float* in = streamData->spectrumData(t0 + i, subband, 0) + first;
+                _gather( d, in, nc, invertChannels );
+            }
+        }
+        _transposeTile( data, timedata );
+        float* row = out + ( (size_t)s * nChannels + c0 ) * stride + column + t0 - start;
+        for( int j = 0; j < nc; ++j ) {
+            std::copy( timedata + j * TILE, timedata + j * TILE + nt, row + (size_t)j * stride );
+        }
     }
+}
 
-    if( _sampleCount == 0 ) {
-        // record first sample number
-        _firstSample = *sampleNumber;
+/**
+ * @details
+ * Copies n floats, reversing their order if @p reverse is set.
+ */
+void DedispersionBuffer::_gather( const float* in, float* out, int n, bool reverse )
+{
+    if( reverse ) {
+        for( int j = 0; j < n; ++j ) out[j] = in[n - 1 - j];
     }
-    unsigned maxSamples = std::min( numSamples, spaceRemaining() + *sampleNumber );
-    timerStart(&_addSampleTimer);
-    int start = *sampleNumber;
-    if( _invertChannels ) {
-        int nChannelsMinusOne = nChannels - 1;
-        int nSubbandsMinusOne= nSubbands - 1;
-        // Try varying x, from 6 down.  Also try it with this commented out.
-        //        omp_set_num_threads(6);
-        int s, c;
-        int localSampleCount = _sampleCount - start;    // create a copy for omp to lock
-#pragma omp parallel for private(s,c) schedule(dynamic)
-        for(int t = start; t < (int)(start + maxSamples); ++t ) {
-            for (s = 0; s < (int)nSubbands; ++s ) {
-                int bsize = s*nChannels*_nsamp + localSampleCount + t;
-                float* data = streamData->spectrumData(t, nSubbandsMinusOne - s, 0);
-                for (c = 0; c < (int)nChannels; ++c ) {
-                  //                    _timedata[(bsize + (c * _nsamp))] = data[nChannelsMinusOne - c];
-
-                  // The following equation is used to replace data
-                  // samples that have been set to zero by the RFI
-                  // clipper to values from a template noise buffer
-                  // that obbey the distribution that the RFI clipper
-                  // forces
-                  _timedata[(bsize + (c * _nsamp))] = data[nChannelsMinusOne - c];
-                }
-            }
+    else {
+        std::copy( in, in + n, out );
+    }
+}
+
+/**
+ * @details
+ * out[j * TILE + i] = in[i * TILE + j], in 4x4 blocks of SSE shuffles
+ * where available.
+ */
+void DedispersionBuffer::_transposeTile( const float* in, float* out )
+{
+#ifdef DEDISPERSION_BUFFER_SSE
+    for( unsigned i = 0; i < TILE; i += 4 ) {
+        for( unsigned j = 0; j < TILE; j += 4 ) {
+            const float* a = in + i * TILE + j;
+            __m128 r0 = _mm_loadu_ps( a );
+            __m128 r1 = _mm_loadu_ps( a + TILE );
+            __m128 r2 = _mm_loadu_ps( a + 2 * TILE );
+            __m128 r3 = _mm_loadu_ps( a + 3 * TILE );
+            _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+            float* b = out + j * TILE + i;
+            _mm_storeu_ps( b, r0 );
+            _mm_storeu_ps( b + TILE, r1 );
+            _mm_storeu_ps( b + 2 * TILE, r2 );
+            _mm_storeu_ps( b + 3 * TILE, r3 );
         }
-    } else {
-        int s, c;
-        int localSampleCount = _sampleCount - start;    // create a copy for omp to lock
-#pragma omp parallel for private(s,c) schedule(dynamic)
-        for(int t = start; t < (int)(start + maxSamples); ++t) {
-            int sampleOffset = localSampleCount + t;
-            for ( s = 0; s < (int)nSubbands; ++s) {
-                float* data = streamData->spectrumData(t, s, 0);
-                int bsize = s*nChannels * _nsamp + sampleOffset;
-                for ( c = 0; c < (int)nChannels; ++c) {
-                  _timedata[ bsize + (c * _nsamp)] = data[c];
-                    }
-            }
+    }
+#else
+    for( unsigned i = 0; i < TILE; ++i ) {
+        for( unsigned j = 0; j < TILE; ++j ) {
+            out[j * TILE + i] = in[i * TILE + j];
         }
     }
-    _sampleCount += (maxSamples - start);
-    *sampleNumber = maxSamples;
-    timerUpdate(&_addSampleTimer);
-    //timerReport(&_addSampleTimer, "DedispersionBuffer::addSamples");
-    return spaceRemaining();
+#endif
 }
 
 void DedispersionBuffer::clear() {
@@ -0,0 +1,266 @@
+#include "DedispersionHostKernel.h"
+#include <QString>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <omp.h>
+
+namespace pelican {
+
+namespace ampp {
+
+// number of DM trials that share each input tile
+static const unsigned DM_BLOCK = 8;
+// number of samples per tile; the accumulators of a block of DM trials
+// (DM_BLOCK x T_BLOCK floats) are kept within the L1 cache
+static const unsigned T_BLOCK = 512;
+
+void hostDedisperseLoop( float* outbuff, const float* buff, float mstartdm,
+                         float mdmstep, unsigned tdms, unsigned numSamples,
+                         const float* dmShift, unsigned maxshift,
+                         unsigned nchans, unsigned nThreads,
+                         unsigned rowStride )
+{
+    size_t stride = rowStride ? rowStride : numSamples;
+    unsigned nOut = numSamples - maxshift;
+    unsigned nDmBlocks = ( tdms + DM_BLOCK - 1 ) / DM_BLOCK;
+    unsigned nTBlocks = ( nOut + T_BLOCK - 1 ) / T_BLOCK;
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        std::vector<int> shifts( DM_BLOCK * nchans );
+        unsigned currentDmBlock = nDmBlocks;
+
+        // tiles are ordered by DM block, so each thread only recalculates
+        // the channel delays when it moves on to a new block
+        #pragma omp for schedule(dynamic)
+        for( int tile = 0; tile < (int)(nDmBlocks * nTBlocks); ++tile ) {
+            unsigned dmBlock = tile / nTBlocks;
+            unsigned dm0 = dmBlock * DM_BLOCK;
+            unsigned nDm = std::min( DM_BLOCK, tdms - dm0 );
+            unsigned t0 = ( tile % nTBlocks ) * T_BLOCK;
+            unsigned nt = std::min( T_BLOCK, nOut - t0 );
+
+            if( dmBlock != currentDmBlock ) {
+                for( unsigned d = 0; d < nDm; ++d ) {
+                    // the GPU contracts this to a fused multiply-add
+                    float shiftTemp = fmaf( (float)(dm0 + d), mdmstep, mstartdm );
+                    for( unsigned c = 0; c < nchans; ++c ) {
+                        shifts[d * nchans + c] = (int)( dmShift[c] * shiftTemp );
+                    }
+                }
+                currentDmBlock = dmBlock;
+            }
+
+            for( unsigned d = 0; d < nDm; ++d ) {
+                std::fill( outbuff + (size_t)(dm0 + d) * nOut + t0,
+                           outbuff + (size_t)(dm0 + d) * nOut + t0 + nt, 0.0f );
+            }
+            for( unsigned c = 0; c < nchans; ++c ) {
+                const float* in = buff + c * stride + t0;
+                for( unsigned d = 0; d < nDm; ++d ) {
+                    const float* x = in + shifts[d * nchans + c];
+                    float* out = outbuff + (size_t)(dm0 + d) * nOut + t0;
+                    #pragma omp simd
+                    for( unsigned t = 0; t < nt; ++t ) {
+                        out[t] += x[t];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void hostSubbandDedisperse( float* outbuff, const float* buff, float mstartdm,
+                            float mdmstep, unsigned tdms, unsigned numSamples,
+                            const float* dmShift, unsigned maxshift,
+                            unsigned nchans, unsigned nSubbands,
+                            unsigned nThreads, unsigned rowStride )
+{
+    size_t stride = rowStride ? rowStride : numSamples;
+    unsigned nOut = numSamples - maxshift;
+    nSubbands = std::max( 1u, std::min( nSubbands, nchans ) );
+    std::vector<unsigned> first( nSubbands + 1 );
+    float span = 0.0f; // largest delay across a group, per unit DM
+    for( unsigned s = 0; s <= nSubbands; ++s ) {
+        first[s] = s * nchans / nSubbands;
+        if( s > 0 ) {
+            span = std::max( span, std::fabs( dmShift[first[s] - 1]
+                                            - dmShift[first[s - 1]] ) );
+        }
+    }
+    // trials within half a block of the centre are out by at most a sample
+    unsigned block = tdms;
+    if( span * mdmstep > 0.0f ) {
+        block = std::max( 1u, std::min( tdms, (unsigned)( 2.0f / ( span * mdmstep ) ) ) );
+    }
+    unsigned nBlocks = ( tdms + block - 1 ) / block;
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        std::vector<float> partial;
+        std::vector<int> intra( nchans );
+
+        #pragma omp for schedule(dynamic)
+        for( int b = 0; b < (int)nBlocks; ++b ) {
+            unsigned dm0 = b * block;
+            unsigned nDm = std::min( block, tdms - dm0 );
+
+            // delays relative to the first channel of each group
+            float centre = fmaf( dm0 + 0.5f * ( nDm - 1 ), mdmstep, mstartdm );
+            int maxIntra = 0;
+            for( unsigned s = 0; s < nSubbands; ++s ) {
+                int ref = (int)( dmShift[first[s]] * centre );
+                for( unsigned c = first[s]; c < first[s + 1]; ++c ) {
+                    intra[c] = (int)( dmShift[c] * centre ) - ref;
+                    maxIntra = std::max( maxIntra, intra[c] );
+                }
+            }
+            unsigned length = numSamples - maxIntra;
+            partial.resize( (size_t)nSubbands * length );
+
+            // stage 1: partial sums over the channels of each group
+            for( unsigned s = 0; s < nSubbands; ++s ) {
+                float* p = &partial[(size_t)s * length];
+                const float* x = buff + first[s] * stride + intra[first[s]];
+                std::copy( x, x + length, p );
+                for( unsigned c = first[s] + 1; c < first[s + 1]; ++c ) {
+                    x = buff + c * stride + intra[c];
+                    #pragma omp simd
+                    for( unsigned t = 0; t < length; ++t ) {
+                        p[t] += x[t];
+                    }
+                }
+            }
+
+            // stage 2: each trial from the delayed partial sums
+            for( unsigned d = dm0; d < dm0 + nDm; ++d ) {
+                float shiftTemp = fmaf( (float)d, mdmstep, mstartdm );
+                float* out = outbuff + (size_t)d * nOut;
+                std::fill( out, out + nOut, 0.0f );
+                for( unsigned s = 0; s < nSubbands; ++s ) {
+                    int shift = std::min( (int)( dmShift[first[s]] * shiftTemp ),
+                                          (int)( length - nOut ) );
+                    const float* x = &partial[(size_t)s * length + shift];
+                    #pragma omp simd
+                    for( unsigned t = 0; t < nOut; ++t ) {
+                        out[t] += x[t];
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace {
+    // a group of channels [first, last] and its delays in the FDMT
+    struct FdmtGroup {
+        unsigned first;
+        unsigned last;
+        int maxDelay; // rows 0 to maxDelay are stored
+        size_t row; // first row in the store
+        int left, right; // groups merged from, right < 0 if carried over
+    };
+}
+
+void hostFdmtDedisperse( float* outbuff, const float* buff, float mstartdm,
+                         float mdmstep, unsigned tdms, unsigned numSamples,
+                         const float* dmShift, unsigned maxshift,
+                         unsigned nchans, unsigned nThreads,
+                         unsigned rowStride )
+{
+    for( unsigned c = 1; c < nchans; ++c ) {
+        if( dmShift[c] < dmShift[c - 1] )
+            throw QString("DedispersionModule: the FDMT requires channel delays "
+                          "that increase with channel number");
+    }
+    unsigned nOut = numSamples - maxshift;
+    float xmax = std::max( mstartdm, fmaf( (float)( tdms - 1 ), mdmstep, mstartdm ) );
+
+    // the input rows are the single channel groups
+    std::vector<FdmtGroup> groups( nchans );
+    for( unsigned c = 0; c < nchans; ++c ) {
+        FdmtGroup g = { c, c, 0, c, -1, -1 };
+        groups[c] = g;
+    }
+    const float* src = buff;
+    size_t stride = rowStride ? rowStride : numSamples; // of the rows in src
+    std::vector<float> current, next;
+    std::vector<unsigned> rowGroup;
+
+    while( groups.size() > 1 ) {
+        std::vector<FdmtGroup> merged;
+        size_t rows = 0;
+        for( unsigned i = 0; i < groups.size(); i += 2 ) {
+            FdmtGroup g = groups[i];
+            g.left = i;
+            g.right = -1;
+            if( i + 1 < groups.size() ) {
+                g.last = groups[i + 1].last;
+                g.maxDelay = (int)std::ceil( ( dmShift[g.last] - dmShift[g.first] ) * xmax );
+                g.right = i + 1;
+            }
+            g.row = rows;
+            rows += g.maxDelay + 1;
+            merged.push_back( g );
+        }
+        rowGroup.resize( rows );
+        for( unsigned i = 0; i < merged.size(); ++i ) {
+            std::fill( rowGroup.begin() + merged[i].row,
+                       rowGroup.begin() + merged[i].row + merged[i].maxDelay + 1, i );
+        }
+        next.resize( rows * numSamples );
+
+        #pragma omp parallel for num_threads(nThreads) schedule(dynamic, 4)
+        for( int row = 0; row < (int)rows; ++row ) {
+            const FdmtGroup& g = merged[rowGroup[row]];
+            const FdmtGroup& l = groups[g.left];
+            int delay = row - g.row;
+            float* out = &next[(size_t)row * numSamples];
+            if( g.right < 0 ) {
+                const float* x = src + ( l.row + delay ) * stride;
+                std::copy( x, x + numSamples, out );
+                continue;
+            }
+            const FdmtGroup& r = groups[g.right];
+            // split the delay across the group at the channels either
+            // side of the join
+            float span = dmShift[g.last] - dmShift[g.first];
+            int leftDelay = 0, offset = 0;
+            if( span > 0.0f ) {
+                leftDelay = (int)( delay * ( dmShift[l.last] - dmShift[g.first] ) / span + 0.5f );
+                offset = (int)( delay * ( dmShift[r.first] - dmShift[g.first] ) / span + 0.5f );
+            }
+            leftDelay = std::min( leftDelay, l.maxDelay );
+            offset = std::min( offset, delay );
+            int rightDelay = std::min( delay - offset, r.maxDelay );
+            const float* x = src + ( l.row + leftDelay ) * stride;
+            const float* y = src + ( r.row + rightDelay ) * stride + offset;
+            unsigned n = numSamples - offset;
+            #pragma omp simd
+            for( unsigned t = 0; t < n; ++t ) {
+                out[t] = x[t] + y[t];
+            }
+            // beyond the end of the right half; never used for the output
+            std::copy( x + n, x + numSamples, out + n );
+        }
+        current.swap( next );
+        src = &current[0];
+        stride = numSamples;
+        groups.swap( merged );
+    }
+
+    // read each trial from the row of its delay across the band
+    const FdmtGroup& band = groups[0];
+    float span = dmShift[band.last] - dmShift[band.first];
+    #pragma omp parallel for num_threads(nThreads)
+    for( int d = 0; d < (int)tdms; ++d ) {
+        float shiftTemp = fmaf( (float)d, mdmstep, mstartdm );
+        int delay = std::max( 0, std::min( (int)( span * shiftTemp ), band.maxDelay ) );
+        const float* x = src + ( band.row + delay ) * stride;
+        std::copy( x, x + nOut, outbuff + (size_t)d * nOut );
+    }
+}
+
+} // namespace ampp
+} // namespace pelican
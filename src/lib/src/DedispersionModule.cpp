@@ -6,22 +6,27 @@
 #include <boost/bind.hpp>
 #include "GPU_MemoryMap.h"
 #include "DedispersionBuffer.h"
+#include "DedispersionRingBuffer.h"
 #include "WeightedSpectrumDataSet.h"
 #include "GPU_Job.h"
 #include "GPU_Kernel.h"
 #include "GPU_Param.h"
 #include "GPU_NVidia.h"
+#include "GPU_Host.h"
 #include "GPU_Manager.h"
+#include "DedispersionHostKernel.h"
 #include <fstream>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/normal_distribution.hpp>
 #include <boost/math/distributions/chi_squared.hpp>
 #include <boost/random/variate_generator.hpp>
 
+#ifdef CUDA_FOUND
 extern "C" void cacheDedisperseLoop( float *outbuff, long outbufSize, float *buff, float mstartdm,
                                      float mdmstep, int tdms, const int numSamples,
                                      const float* dmShift, const int i_maxshift,
                                      const int i_nchans );
+#endif
 
 
 namespace pelican {
@@ -42,19 +47,65 @@ namespace ampp {
  *    <channelBandwidth MHz="-0.03">
  *       The width of each frequency channel.
  *    </channelBandwidth>
+ *    <dedispersionAlgorithm value="bruteForce" subbands="16">
+ *       "bruteForce", "subband" to dedisperse in two stages with
+ *       the channels split into the given number of groups, or "fdmt"
+ *       for the Fast Dispersion Measure Transform (host CPU only)
+ *    </dedispersionAlgorithm>
+ *    <ringBuffer value="false" samples="0">
+ *       Keep the data in a single ring of overlapping windows instead of
+ *       copying the overlap (maxshift) into each new buffer. Windows
+ *       are the given number of samples (0 = 2^timeBinsPerBufferPow2)
+ *       and numberOfBuffers of them fit in the ring (host CPU only)
+ *    </ringBuffer>
+ *    <device type="gpu" threads="0">
+ *       Run on the GPUs ("gpu"), falling back on the host CPU if
+ *       none are found, or always on the host CPU ("cpu") with the
+ *       given number of threads (0 = the OpenMP default)
+ *    </device>
  * </DedispersionModule>
  */
 DedispersionModule::DedispersionModule( const ConfigNode& config )
-    : AsyncronousModule(config)
+    : AsyncronousModule(config), _ring(0)
 {
     // Get configuration options
     //unsigned int nChannels = config.getOption("outputChannelsPerSubband", "value", "512").toUInt();
     float timeSamplesPow2 = config.getOption("timeBinsPerBufferPow2", "value", "15").toFloat();
     _numSamplesBuffer = (int)pow(2.0,timeSamplesPow2);
+    _useRing = config.getOption("ringBuffer", "value", "false") == "true";
+    if( _useRing ) {
+        // overlapping windows are free, so need not be a power of 2
+        unsigned samples = config.getOption("ringBuffer", "samples", "0").toUInt();
+        if( samples > 0 ) _numSamplesBuffer = samples;
+    }
     _tdms = config.getOption("dedispersionSamples", "value", "1984").toUInt();
     _dmStep = config.getOption("dedispersionStepSize", "value", "0.0").toFloat();
     _dmLow = config.getOption("dedispersionMinimum", "value", "0.0").toFloat();
     if( _dmLow < 0.0 ) { _dmLow = 0.0; }
+    QString algorithm = config.getOption("dedispersionAlgorithm", "value", "bruteForce");
+    if( algorithm == "bruteForce" ) {
+        _algorithm = BruteForce;
+    }
+    else if( algorithm == "subband" ) {
+        _algorithm = Subband;
+    }
+    else if( algorithm == "fdmt" ) {
+        _algorithm = FDMT;
+    }
+    else {
+        throw QString("DedispersionModule: unknown dedispersionAlgorithm \"%1\"").arg(algorithm);
+    }
+    // the GPU kernel only dedisperses contiguous buffers by brute force
+    if( nvidiaResources() ) {
+        if( _algorithm != BruteForce )
+            throw QString("DedispersionModule: dedispersionAlgorithm \"%1\" is not "
+                          "available on the GPU; use <device type=\"cpu\"/>").arg(algorithm);
+        if( _useRing )
+            throw QString("DedispersionModule: the ring buffer is not available "
+                          "on the GPU; use <device type=\"cpu\"/>");
+    }
+    _subbands = config.getOption("dedispersionAlgorithm", "subbands", "16").toUInt();
+    if( _subbands < 1 ) throw(QString("DedispersionModule: Must have at least one subband"));
     _fch1 = config.getOption("frequencyChannel1", "MHz", "0.0").toDouble();
     _foff = config.getOption("channelBandwidth", "MHz", "1.0").toDouble();
     _invert = ( _foff >= 0 )?1:0;
@@ -104,6 +155,8 @@ void DedispersionModule::_cleanBuffers() {
         delete b;
     }
     _buffersList.clear();
+    delete _ring;
+    _ring = 0;
 }
 
 void DedispersionModule::resize( const SpectrumDataSet<float>* streamData ) {
@@ -115,12 +168,13 @@ void DedispersionModule::resize( const SpectrumDataSet<float>* streamData ) {
     unsigned sampleSize = nSubbands * nChannels;
     if( sampleSize != _currentBuffer->sampleSize() ) {
         unsigned maxBuffers = _buffersList.size();
-        unsigned maxSamples = _currentBuffer->maxSamples();
+        unsigned maxSamples = _numSamplesBuffer;
         waitForJobCompletion();
         _cleanBuffers();
-        // set up the time/freq buffers
+        // set up the time/freq buffers; with a ring buffer these only
+        // record the sample size
         for( unsigned int i=0; i < maxBuffers; ++i ) {
-            _buffersList.append( new DedispersionBuffer(maxSamples, sampleSize, _invert) );
+            _buffersList.append( new DedispersionBuffer(_useRing ? 0 : maxSamples, sampleSize, _invert) );
         }
         _buffers.reset( &_buffersList );
         _currentBuffer = _buffers.next();
@@ -176,6 +230,10 @@ void DedispersionModule::resize( const SpectrumDataSet<float>* streamData ) {
             throw QString("DedispersionModule: maxshift requirements (%1) are bigger"
                           " than the number of samples (%2)").arg(_maxshift).arg(maxSamples);
         }
+        if( _useRing ) {
+            _ring = new DedispersionRingBuffer( maxSamples, _maxshift + _remainingSamples,
+                                                maxBuffers, sampleSize, _invert );
+        }
         // reset kernels
         for( unsigned int i=0; i < maxBuffers; ++i ) {
             DedispersionKernel* kernel = new DedispersionKernel( _dmLow, _dmStep,
@@ -184,6 +242,7 @@ void DedispersionModule::resize( const SpectrumDataSet<float>* streamData ) {
                                 _nChannels, _maxshift + _remainingSamples, _numSamplesBuffer );
             _kernelList.append( kernel ); 
             kernel->setDMShift( _dmshifts );
+            kernel->setAlgorithm( _algorithm, _subbands );
         }
         _kernels.reset( &_kernelList );
     }
@@ -212,8 +271,12 @@ void DedispersionModule::dedisperse( WeightedSpectrumDataSet* weightedData )
   SpectrumDataSetStokes* streamData = 
     static_cast<SpectrumDataSetStokes*>(weightedData->dataSet());
   
-  _blobs.push_back( streamData ); // keep a list of blobs to lock
   resize( streamData ); // ensure we have buffers scaled appropriately
+  if( _ring ) {
+      _dedisperseRing( weightedData );
+      return;
+  }
+  _blobs.push_back( streamData ); // keep a list of blobs to lock
   
   unsigned int sampleNumber = 0; // marker to indicate the number of samples succesfully 
   // transferred to the buffer from the Datablob
@@ -260,6 +323,58 @@ void DedispersionModule::dedisperse( WeightedSpectrumDataSet* weightedData )
     while( sampleNumber != maxSamples );
 }
 
+void DedispersionModule::_dedisperseRing( WeightedSpectrumDataSet* weightedData )
+{
+    SpectrumDataSetStokes* streamData =
+      static_cast<SpectrumDataSetStokes*>(weightedData->dataSet());
+    {
+        // hold the blob until no later window has samples from it
+        QMutexLocker l( &lockerMutex );
+        lockUnprotected( streamData );
+    }
+    unsigned int sampleNumber = 0;
+    unsigned int maxSamples = streamData->nTimeBlocks();
+    do {
+        if( 0 == _ring->addSamples( weightedData, _noiseTemplate, &sampleNumber ) ) {
+            timerStart(&_launchTimer);
+            DedispersionSpectra* dataOut = _dedispersionDataBuffer.next();
+            dataOut->setInputDataBlobs( _ring->windowBlobs() );
+            dataOut->setFirstSample( _ring->windowFirstSample() );
+            float* data = _ring->windowData();
+            unsigned long window = _ring->window();
+            {   // lock mutex scope
+                QMutexLocker l( &lockerMutex );
+                lockAllUnprotected( _ring->windowBlobs() );
+                foreach( SpectrumDataSetStokes* d, _ring->advance() ) {
+                    unlock( d );
+                }
+            }
+            dedisperse( data, window, dataOut );
+            timerUpdate(&_launchTimer);
+        }
+    }
+    while( sampleNumber != maxSamples );
+}
+
+void DedispersionModule::dedisperse( float* data, unsigned long window,
+                                     DedispersionSpectra* dataOut )
+{
+    unsigned int nsamp = _ring->windowSize() - _maxshift - _remainingSamples;
+    dataOut->resize( nsamp, _tdms, _dmLow, _dmStep );
+    GPU_Job* job = _jobBuffer.next();
+    DedispersionKernel* kernelPtr = _kernels.next();
+    kernelPtr->setOutputBuffer( dataOut->data() );
+    kernelPtr->setInputBuffer( data, _ring->windowBytes(), _ring->rowStride(),
+                   boost::bind( &DedispersionModule::ringWindowUsed, this, window ) );
+    job->addKernel( kernelPtr );
+    job->addCallBack( boost::bind( &DedispersionModule::gpuJobFinished, this, job, kernelPtr, dataOut ) );
+    submit( job );
+}
+
+void DedispersionModule::ringWindowUsed( unsigned long window ) {
+    _ring->release( window );
+}
+
 void DedispersionModule::dedisperse( DedispersionBuffer* buffer, DedispersionSpectra* dataOut )
 {
     // prepare the output data datablob
@@ -326,10 +441,16 @@ void DedispersionModule::exportComplete( DataBlob* datablob ) {
 
 DedispersionModule::DedispersionKernel::DedispersionKernel( float start, float step, float tsamp, float tdms , unsigned nChans, unsigned maxshift, unsigned nsamples )
    : _startdm( start ), _dmstep( step ), _tsamp(tsamp), _tdms(tdms), _nChans(nChans),
-     _maxshift(maxshift), _nsamples(nsamples)
+     _maxshift(maxshift), _nsamples(nsamples), _rowStride(nsamples),
+     _algorithm(BruteForce), _subbands(1)
 {
 }
 
+void DedispersionModule::DedispersionKernel::setAlgorithm( Algorithm algorithm, unsigned subbands ) {
+    _algorithm = algorithm;
+    _subbands = subbands;
+}
+
 void DedispersionModule::DedispersionKernel::setDMShift( std::vector<float>& buffer ) {
     _dmShift = GPU_MemoryMap(buffer);
 }
@@ -348,9 +469,22 @@ void DedispersionModule::DedispersionKernel::setOutputBuffer( std::vector<float>
 void DedispersionModule::DedispersionKernel::setInputBuffer( std::vector<float>& buffer, GPU_MemoryMap::CallBackT callback ) {
     _inputBuffer = GPU_MemoryMap(buffer);
     _inputBuffer.addCallBack( callback );
+    _rowStride = _nsamples;
+}
+
+void DedispersionModule::DedispersionKernel::setInputBuffer( float* data, unsigned long bytes,
+                                    unsigned rowStride, GPU_MemoryMap::CallBackT callback ) {
+    _inputBuffer = GPU_MemoryMap(data, bytes);
+    _inputBuffer.addCallBack( callback );
+    _rowStride = rowStride;
 }
 
+#ifdef CUDA_FOUND
 void DedispersionModule::DedispersionKernel::run( GPU_NVidia& gpu ) {
+     if( _algorithm != BruteForce )
+         throw QString("DedispersionModule: only the bruteForce algorithm is available on the GPU");
+     if( _rowStride != _nsamples )
+         throw QString("DedispersionModule: the ring buffer is not available on the GPU");
      //cache_dedisperse_loop( float *outbuff, float *buff, float mstartdm, float mdmstep )
 //std::cout << " maxShift =" << _maxshift << std::endl;
 //std::cout << " nchans =" << _nChans << std::endl;
@@ -367,6 +501,42 @@ void DedispersionModule::DedispersionKernel::run( GPU_NVidia& gpu ) {
                           _nChans
                         );
 }
+#else
+void DedispersionModule::DedispersionKernel::run( GPU_NVidia& ) {
+     throw QString("DedispersionModule: built without CUDA support");
+}
+#endif
+
+void DedispersionModule::DedispersionKernel::run( GPU_Host& host ) {
+     switch( _algorithm ) {
+         case Subband:
+             hostSubbandDedisperse( (float*)_outputBuffer.hostPtr(),
+                                    (const float*)_inputBuffer.hostPtr(), (_startdm/_tsamp),
+                                    (_dmstep/_tsamp), _tdms, _nsamples,
+                                    (const float*)_dmShift.hostPtr(),
+                                    _maxshift, _nChans, _subbands, host.threads(),
+                                    _rowStride
+                                  );
+             break;
+         case FDMT:
+             hostFdmtDedisperse( (float*)_outputBuffer.hostPtr(),
+                                 (const float*)_inputBuffer.hostPtr(), (_startdm/_tsamp),
+                                 (_dmstep/_tsamp), _tdms, _nsamples,
+                                 (const float*)_dmShift.hostPtr(),
+                                 _maxshift, _nChans, host.threads(), _rowStride
+                               );
+             break;
+         default:
+             hostDedisperseLoop( (float*)_outputBuffer.hostPtr(),
+                                 (const float*)_inputBuffer.hostPtr(), (_startdm/_tsamp),
+                                 (_dmstep/_tsamp), _tdms, _nsamples,
+                                 (const float*)_dmShift.hostPtr(),
+                                 _maxshift, _nChans, host.threads(), _rowStride
+                               );
+     }
+     // the input buffer can now be reused
+     _inputBuffer.runCallBacks();
+}
 
 } // namespace ampp
 } // namespace pelican
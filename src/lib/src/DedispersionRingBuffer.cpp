@@ -0,0 +1,145 @@
+#include "DedispersionRingBuffer.h"
+#include "DedispersionBuffer.h"
+#include "SpectrumDataSet.h"
+#include "WeightedSpectrumDataSet.h"
+#include <QMutexLocker>
+#include <QString>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace pelican {
+
+namespace ampp {
+
+
+/**
+ *@details DedispersionRingBuffer 
+ */
+DedispersionRingBuffer::DedispersionRingBuffer( unsigned int windowSize,
+                                                unsigned int overlap,
+                                                unsigned int windows,
+                                                unsigned int sampleSize,
+                                                bool invertChannels )
+   : _windowSize(windowSize), _sampleSize(sampleSize),
+     _invertChannels(invertChannels), _written(0), _window(0),
+     _windowFirstSample(0)
+{
+    if( overlap >= windowSize )
+        throw QString("DedispersionRingBuffer: the overlap (%1) must be smaller"
+                      " than the window (%2)").arg(overlap).arg(windowSize);
+    _advance = windowSize - overlap;
+    _capacity = windowSize + ( std::max( windows, 1u ) - 1 ) * _advance;
+    _stride = _capacity + windowSize;
+    _data.resize( (size_t)_stride * _sampleSize );
+}
+
+/**
+ *@details
+ */
+DedispersionRingBuffer::~DedispersionRingBuffer()
+{
+}
+
+unsigned DedispersionRingBuffer::addSamples( WeightedSpectrumDataSet* weightedData,
+                                             std::vector<float>& noiseTemplate,
+                                             unsigned *sampleNumber )
+{
+    SpectrumDataSetStokes* streamData =
+      static_cast<SpectrumDataSetStokes*>(weightedData->dataSet());
+    Q_ASSERT( streamData != 0 );
+    unsigned long long end = (unsigned long long)_window * _advance + _windowSize;
+    if( streamData->nSubbands() * streamData->nChannels() != _sampleSize ) {
+        std::cerr  << "DedispersionRingBuffer: input data sample size("
+                   << streamData->nSubbands() * streamData->nChannels()
+                   << ") does not match buffer sample size (" << _sampleSize << ")" << std::endl;
+        return end - _written;
+    }
+    unsigned int numSamples = streamData->nTimeBlocks();
+    if( _blobs.isEmpty() || _blobs.last().blob != streamData ) {
+        BlobSamples b = { streamData, _written - *sampleNumber, numSamples };
+        _blobs.append( b );
+    }
+
+    timerStart(&_addSampleTimer);
+    unsigned count = std::min( (unsigned long long)( numSamples - *sampleNumber ),
+                               end - _written );
+    while( count > 0 ) {
+        // write up to the end of the ring, or of the noise template
+        unsigned pos = _written % _capacity;
+        unsigned length = std::min( count, _capacity - pos );
+        length = std::min( length, _windowSize - pos % _windowSize );
+        {
+            // wait until no window being processed has samples here
+            QMutexLocker lock( &_mutex );
+            while( ! _inUse.isEmpty() &&
+                   _written + length > (unsigned long long)
+                   *std::min_element( _inUse.begin(), _inUse.end() ) * _advance + _capacity ) {
+                _released.wait( &_mutex );
+            }
+        }
+        DedispersionBuffer::transpose( streamData, weightedData->weights(),
+                                       noiseTemplate, _windowSize, pos % _windowSize,
+                                       &_data[0], _stride, pos,
+                                       *sampleNumber, *sampleNumber + length,
+                                       _invertChannels );
+        // repeat the start of the ring after its end
+        if( pos < _windowSize ) {
+            unsigned n = std::min( length, _windowSize - pos );
+            for( unsigned i = 0; i < _sampleSize; ++i ) {
+                float* row = &_data[(size_t)i * _stride];
+                std::memcpy( row + _capacity + pos, row + pos, n * sizeof(float) );
+            }
+        }
+        _written += length;
+        *sampleNumber += length;
+        count -= length;
+    }
+    timerUpdate(&_addSampleTimer);
+    if( _written == end ) _updateWindowBlobs();
+    return end - _written;
+}
+
+float* DedispersionRingBuffer::windowData()
+{
+    return &_data[( (unsigned long long)_window * _advance ) % _capacity];
+}
+
+unsigned long DedispersionRingBuffer::windowBytes() const
+{
+    return ( (unsigned long)( _sampleSize - 1 ) * _stride + _windowSize ) * sizeof(float);
+}
+
+void DedispersionRingBuffer::_updateWindowBlobs()
+{
+    unsigned long long start = (unsigned long long)_window * _advance;
+    _windowBlobs.clear();
+    foreach( const BlobSamples& b, _blobs ) {
+        if( b.first + b.samples <= start ) continue;
+        if( _windowBlobs.isEmpty() ) _windowFirstSample = start - b.first;
+        _windowBlobs.append( b.blob );
+    }
+}
+
+QList<SpectrumDataSetStokes*> DedispersionRingBuffer::advance()
+{
+    QMutexLocker lock( &_mutex );
+    _inUse.append( _window );
+    ++_window;
+    unsigned long long start = (unsigned long long)_window * _advance;
+    QList<SpectrumDataSetStokes*> finished;
+    while( ! _blobs.isEmpty() && _blobs.first().first + _blobs.first().samples <= start ) {
+        finished.append( _blobs.takeFirst().blob );
+    }
+    return finished;
+}
+
+void DedispersionRingBuffer::release( unsigned long window )
+{
+    QMutexLocker lock( &_mutex );
+    _inUse.removeOne( window );
+    _released.wakeAll();
+}
+
+} // namespace ampp
+} // namespace pelican
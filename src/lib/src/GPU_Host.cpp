@@ -0,0 +1,45 @@
+#include "GPU_Host.h"
+#include "GPU_Manager.h"
+#include "GPU_Kernel.h"
+#include "GPU_Job.h"
+#include <omp.h>
+
+namespace pelican {
+
+namespace ampp {
+
+/**
+ *@details GPU_Host 
+ */
+GPU_Host::GPU_Host( unsigned int threads )
+     :  _threads(threads)
+{
+    if( _threads == 0 ) _threads = omp_get_max_threads();
+}
+
+/**
+ *@details
+ */
+GPU_Host::~GPU_Host()
+{
+}
+
+void GPU_Host::run( GPU_Job* job )
+{
+    foreach( GPU_Kernel* kernel, job->kernels() ) {
+        try {
+            kernel->run( *this );
+        }
+        catch( ... ) {
+            kernel->cleanUp();
+            throw;
+        }
+    }
+}
+
+void GPU_Host::initialiseResources( GPU_Manager* manager, unsigned int threads ) {
+     manager->addResource( new GPU_Host( threads ) );
+}
+
+} // namespace ampp
+} // namespace pelican
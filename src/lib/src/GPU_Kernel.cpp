@@ -1,4 +1,5 @@
 #include "GPU_Kernel.h"
+#include <QString>
 
 
 namespace pelican {
@@ -20,5 +21,10 @@ GPU_Kernel::~GPU_Kernel()
 {
 }
 
+void GPU_Kernel::run( GPU_Host& )
+{
+    throw QString("GPU_Kernel: kernel has no host implementation");
+}
+
 } // namespace ampp
 } // namespace pelican
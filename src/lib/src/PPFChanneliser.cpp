@@ -8,9 +8,11 @@
 #include <QtCore/QString>
 #include <QtCore/QTime>
 #include <QtCore/QFile>
+#include <QtCore/QStringList>
 
 #include <omp.h>
 
+#include <algorithm>
 #include <cfloat>
 #include <cstring>
 #include <iostream>
@@ -27,32 +29,66 @@ namespace ampp {
  * @param[in] config XML configuration node.
  */
 PPFChanneliser::PPFChanneliser(const ConfigNode& config)
-: AbstractModule(config), _buffersInitialised(false)
+: AbstractModule(config), _buffersInitialised(false), _nTaps(0),
+  _coeffs(0), _coeffBuffer(0), _coeffStore(0), _nResidual(0),
+  _historySize(0), _iStart(0), _iEnd(0), _phase(0)
 {
     // Get options from the XML configuration node.
     _nChannels = config.getOption("outputChannelsPerSubband", "value", "512").toUInt();
     _nThreads  = config.getOption("processingThreads", "value", "2").toUInt();
     unsigned nTaps = config.getOption("filter", "nTaps", "8").toUInt();
     QString window = config.getOption("filter", "filterWindow", "kaiser").toLower();
+    QString coeffStore = config.getOption("filter", "store", "");
+    _fftBatch = config.getOption("fftw", "batch", "16").toUInt();
+    QString planner = config.getOption("fftw", "planner", "measure").toLower();
+    _wisdomFile = config.getOption("fftw", "wisdom", "");
+    QString oversampling = config.getOption("oversampling", "factor", "1");
+    QString hop = config.getOption("oversampling", "hop", "");
 
     // Set the number of processing threads.
     omp_set_num_threads(_nThreads);
-    _iOldestSamples.resize(_nThreads, 0);
 
     // Enforce even number of channels.
     if (_nChannels != 1 && _nChannels%2 == 1)
        throw _err("Number of channels needs to be even.");
 
-    // Generate the FIR coefficients;
+    if (_fftBatch == 0)
+       throw _err("FFT batch size must be at least 1.");
+
+    _setHop(oversampling, hop);
+
+    if (planner == "estimate")
+        _fftwFlags = FFTW_ESTIMATE;
+    else if (planner == "measure")
+        _fftwFlags = FFTW_MEASURE;
+    else if (planner == "patient")
+        _fftwFlags = FFTW_PATIENT;
+    else
+        throw _err("Unknown FFTW planner option '%1'.").arg(planner);
+
+    // Select the FIR kernel for the host CPU.
+    _firKernel = PPFFirKernel::function(PPFFirKernel::best());
+
+    // Generate (or map) the FIR coefficients;
+    if (!coeffStore.isEmpty())
+        _coeffStore = new PPFCoefficientStore(coeffStore);
     _generateFIRCoefficients(window, nTaps);
 
     // Allocate buffers used for holding the output of the FIR stage.
+    unsigned stride = PPFFirKernel::stride(_nChannels);
     _filteredData.resize(_nThreads);
     for (unsigned i = 0; i < _nThreads; ++i)
-        _filteredData[i].resize(_nChannels);
+        _filteredData[i] = (Complex*) PPFFirKernel::allocate(2 * stride * _fftBatch);
 
-    // Create the FFTW plan.
-    _createFFTWPlan(_nChannels, _fftPlan);
+    // Load any saved FFTW wisdom and create the plans for a full batch.
+    // Only the first plan is measured, the others reuse its wisdom.
+    if (!_wisdomFile.isEmpty() && QFile::exists(_wisdomFile))
+        fftwf_import_wisdom_from_filename(_wisdomFile.toLatin1().data());
+    _fftPlans.resize(_nThreads);
+    for (unsigned i = 0; i < _nThreads; ++i)
+        _fftPlan(_fftBatch, i);
+    if (!_wisdomFile.isEmpty())
+        fftwf_export_wisdom_to_filename(_wisdomFile.toLatin1().data());
 }
 
 /**
@@ -61,7 +97,17 @@ PPFChanneliser::PPFChanneliser(const ConfigNode& config)
 */
 PPFChanneliser::~PPFChanneliser()
 {
-    fftwf_destroy_plan(_fftPlan);
+    for (unsigned i = 0; i < _fftPlans.size(); ++i)
+    {
+        std::map<unsigned, fftwf_plan>::iterator it = _fftPlans[i].begin();
+        for (; it != _fftPlans[i].end(); ++it)
+            fftwf_destroy_plan(it->second);
+    }
+    _freeWorkBuffers();
+    for (unsigned i = 0; i < _filteredData.size(); ++i)
+        PPFFirKernel::free((float*)_filteredData[i]);
+    PPFFirKernel::free(_coeffBuffer);
+    delete _coeffStore;
 }
 
 
@@ -72,8 +118,18 @@ PPFChanneliser::~PPFChanneliser()
 * The channeliser performs channelisation of a number of sub-bands containing
 * a complex time series.
 *
-* Parallelisation, by means of openMP threads, is carried out by splitting
-* the sub-bands as evenly as possible between threads.
+* Parallelisation, by means of openMP threads, is carried out by scheduling
+* (sub-band, polarisation) work items dynamically over the threads. The
+* delay line and its cursor belong to the work item, so any thread can
+* process any item and the thread count need not divide the sub-band count.
+*
+* Time blocks are filtered in batches of up to _fftBatch into a per-thread
+* scratch matrix which is then transformed with a single FFTW call.
+*
+* The samples of each sub-band and polarisation are consumed as a stream,
+* independent of the block size of the time series: samples left over from
+* the previous call are prepended and any which do not complete a spectrum
+* are kept for the next call.
 *
 * @param[in]  timeSeries 	Buffer of time samples to be channelised.
 * @param[out] spectrum	 	Set of spectra produced.
@@ -84,23 +140,41 @@ void PPFChanneliser::run(const TimeSeriesDataSetC32* timeSeries,
     // Perform a number of sanity checks on the input data.
     _checkData(timeSeries);
 
+    if (_hop != _nChannels) {
+        _runOversampled(timeSeries, spectra);
+        return;
+    }
+
     // Make local copies of the data dimensions.
     unsigned nSubbands      = timeSeries->nSubbands();
     unsigned nPolarisations = timeSeries->nPolarisations();
     unsigned nTimeBlocks    = timeSeries->nTimeBlocks();
     unsigned nTimesPerBlock = timeSeries->nTimesPerBlock();
 
+    // Set up work buffers (if required).
+    unsigned nFilterTaps = _nTaps;
+    if (_nChannels != 1 && (!_buffersInitialised ||
+            _workBuffer.size() != nSubbands * nPolarisations))
+        _setupWorkBuffers(nSubbands, nPolarisations, _nChannels, nFilterTaps);
+
+    // Number of complete spectra including the samples left over from the
+    // previous call.
+    unsigned nSamples = nTimeBlocks * nTimesPerBlock;
+    unsigned nSpectra = (_nResidual + nSamples) / _nChannels;
+
     // Resize the output spectra blob (if required).
-    spectra->resize(nTimeBlocks, nSubbands, nPolarisations, _nChannels);
+    spectra->resize(nSpectra, nSubbands, nPolarisations, _nChannels);
 
-    // Set the timing parameters - Only need the timestamp of the first packet
-    // for this version of the Channeliser.
-    spectra->setLofarTimestamp(timeSeries->getLofarTimestamp());
+    // Set the timing parameters - the first spectrum starts with the oldest
+    // left over sample.
+    spectra->setLofarTimestamp(timeSeries->getLofarTimestamp()
+            - _nResidual * timeSeries->getBlockRate());
     spectra->setBlockRate(timeSeries->getBlockRate() * _nChannels);
 
-    const float* coeffs = &_coeffs[0];
-    unsigned threadId = 0, nThreads = 0, start = 0, end = 0;
-    Complex *workBuffer = 0, *filteredSamples = 0;
+    const float* coeffs = _coeffs;
+    unsigned threadId = 0;
+    float* workBuffer = 0;
+    Complex* filteredSamples = 0;
     Complex const * timeData = 0;
     const Complex* timeStart = timeSeries->constData();
     Complex* spectraStart = spectra->data();
@@ -130,70 +204,269 @@ void PPFChanneliser::run(const TimeSeriesDataSetC32* timeSeries,
          }
 
     } else {
-        // Set up work buffers (if required).
-        unsigned nFilterTaps = _ppfCoeffs.nTaps();
-        if (!_buffersInitialised)
-            _setupWorkBuffers(nSubbands, nPolarisations, _nChannels, nFilterTaps);
+        // Get the FFT plans for full and remainder batches (plan creation
+        // is not thread safe so must be done outside the parallel region).
+        unsigned batch = std::min(_fftBatch, nSpectra);
+        vector<fftwf_plan> batchPlans(_nThreads), lastPlans(_nThreads);
+        for (unsigned i = 0; i < _nThreads && nSpectra > 0; ++i)
+        {
+            batchPlans[i] = _fftPlan(batch, i);
+            lastPlans[i] = (nSpectra % batch) ?
+                    _fftPlan(nSpectra % batch, i) : batchPlans[i];
+        }
+        unsigned stride = PPFFirKernel::stride(_nChannels);
+        size_t spectrumBytes = _nChannels * sizeof(Complex);
+
+        int nItems = nSubbands * nPolarisations;
 
         // Channeliser processing.
-        #pragma omp parallel \
+        #pragma omp parallel num_threads(_nThreads) \
             shared(nTimeBlocks, nPolarisations, nSubbands, nFilterTaps, coeffs,\
-                    timeStart, spectraStart) \
-            private(threadId, nThreads, start, end, workBuffer, filteredSamples, \
-                    timeData)
+                    timeStart, spectraStart, batch, batchPlans, lastPlans, nItems,\
+                    nSamples, nSpectra) \
+            private(threadId, workBuffer, filteredSamples, timeData)
         {
             threadId = omp_get_thread_num();
-            nThreads = omp_get_num_threads();
-
-            // Assign processing threads in a round robin fashion to subbands.
-            _assign_threads(start, end, nSubbands, nThreads, threadId);
 
             // Pointer to work buffer for the thread.
-            filteredSamples = &_filteredData[threadId][0];
+            filteredSamples = _filteredData[threadId];
 
-            // Loop over data to be channelised.
-            for (unsigned subband = start; subband < end; ++subband)
+            // Loop over (sub-band, polarisation) items to be channelised.
+            #pragma omp for schedule(dynamic)
+            for (int item = 0; item < nItems; ++item)
             {
-                for (unsigned pol = 0; pol < nPolarisations; ++pol)
-                {
-                    for (unsigned block = 0; block < nTimeBlocks; ++block)
-                    {
-                        // Get pointer to time series array.
-                        unsigned index = timeSeries->index(subband, nTimesPerBlock,
-                                     pol, nPolarisations, block, nTimeBlocks);
-                        timeData = &timeStart[index];
+                unsigned subband = item / nPolarisations;
+                unsigned pol = item % nPolarisations;
+
+                // Get a pointer to the work buffer and its cursor.
+                workBuffer = _workBuffer[item];
+                unsigned& iOldest = _iOldestSamples[item];
 
-                        // Get a pointer to the work buffer.
-                        workBuffer = &(_workBuffer[subband * nPolarisations + pol])[0];
+                // Get pointer to the time series (contiguous over blocks).
+                unsigned index = timeSeries->index(subband, nTimesPerBlock,
+                             pol, nPolarisations, 0, nTimeBlocks);
+                timeData = &timeStart[index];
+
+                for (unsigned block = 0; block < nSpectra; block += batch)
+                {
+                    unsigned nBlocks = std::min(batch, nSpectra - block);
 
+                    for (unsigned b = 0; b < nBlocks; ++b)
+                    {
                         // Update buffered (lagged) data for the sub-band.
-                        _updateBuffer(timeData, _nChannels, nFilterTaps, workBuffer);
+                        _updateBuffer(_spectrumSamples(timeData, item, block + b),
+                                _nChannels, nFilterTaps, workBuffer, iOldest);
 
                         // Apply the PPF.
-                        _filter(workBuffer, nFilterTaps, _nChannels, coeffs, filteredSamples);
+                        _filter(workBuffer, nFilterTaps, _nChannels, iOldest,
+                                coeffs, &filteredSamples[b * stride]);
+                    }
 
-                        // FFT the filtered sub-band data to form a new spectrum.
+                    // FFT the filtered sub-band data to form new spectra.
+                    _fft(nBlocks == batch ? batchPlans[threadId] : lastPlans[threadId]);
+
+                    for (unsigned b = 0; b < nBlocks; ++b)
+                    {
                         unsigned indexSpectra = spectra->index(subband, nSubbands,
-                                pol, nPolarisations, block, _nChannels);
-                        _fft(filteredSamples, &spectraStart[indexSpectra]);
+                                pol, nPolarisations, block + b, _nChannels);
+                        memcpy(&spectraStart[indexSpectra],
+                                &filteredSamples[b * stride], spectrumBytes);
                     }
                 }
+
+                // Keep samples of the incomplete spectrum for the next call.
+                _saveResidual(timeData, nSamples, item, nSpectra);
             }
 
         } // end of parallel region.
 
+        _nResidual = (_nResidual + nSamples) % _nChannels;
+    }
+
+}
+
+
+/**
+* @details
+* Channelises the time series producing a spectrum every _hop samples.
+*
+* The new samples of each (sub-band, polarisation) item are appended once to
+* its history, then each spectrum is filtered from the window of
+* nTaps * nChannels samples starting _hop samples after that of the previous
+* spectrum. As the hop and channel count are multiples of the kernel row
+* alignment the window can be passed to the FIR kernel as nTaps contiguous
+* rows, without copying.
+*
+* The filtered samples of a spectrum starting at stream position p are
+* rotated by p modulo nChannels before the FFT, which removes the phase
+* ramp otherwise introduced by the hop and makes every other spectrum of a
+* 2x oversampled channeliser equal to the critically sampled one.
+*
+* @param[in]  timeSeries 	Buffer of time samples to be channelised.
+* @param[out] spectrum	 	Set of spectra produced.
+*/
+void PPFChanneliser::_runOversampled(const TimeSeriesDataSetC32* timeSeries,
+        SpectrumDataSetC32* spectra)
+{
+    unsigned nSubbands      = timeSeries->nSubbands();
+    unsigned nPolarisations = timeSeries->nPolarisations();
+    unsigned nTimeBlocks    = timeSeries->nTimeBlocks();
+    unsigned nTimesPerBlock = timeSeries->nTimesPerBlock();
+    unsigned nFilterTaps    = _nTaps;
+    unsigned nSamples = nTimeBlocks * nTimesPerBlock;
+    unsigned window = nFilterTaps * _nChannels;
+    int nItems = nSubbands * nPolarisations;
+
+    // Make sure the history can hold the samples still needed and the new
+    // ones, moving the needed samples to the front if they do not fit after
+    // them.
+    if (!_buffersInitialised || _workBuffer.size() != unsigned(nItems))
+        _setupHistory(nItems, window + 2 * nSamples);
+    else if (_iEnd - _iStart + nSamples > _historySize)
+        _setupHistory(nItems, _iEnd - _iStart + 2 * nSamples);
+    unsigned shift = (_iEnd + nSamples > _historySize) ? _iStart : 0;
+    unsigned iStart = _iStart - shift;
+    unsigned iEnd = _iEnd - shift;
+    unsigned nKeep = _iEnd - _iStart;
+
+    // Number of complete filter windows.
+    unsigned nAvailable = iEnd + nSamples - iStart;
+    unsigned nSpectra = (nAvailable < window) ? 0 :
+            (nAvailable - window) / _hop + 1;
+
+    spectra->resize(nSpectra, nSubbands, nPolarisations, _nChannels);
+
+    // The first spectrum starts with the newest row of its filter window.
+    int offset = int(iStart + window - _nChannels) - int(iEnd);
+    spectra->setLofarTimestamp(timeSeries->getLofarTimestamp()
+            + offset * timeSeries->getBlockRate());
+    spectra->setBlockRate(timeSeries->getBlockRate() * _hop);
+
+    // Get the FFT plans outside the parallel region.
+    unsigned batch = std::min(_fftBatch, nSpectra);
+    vector<fftwf_plan> batchPlans(_nThreads), lastPlans(_nThreads);
+    for (unsigned i = 0; i < _nThreads && nSpectra > 0; ++i)
+    {
+        batchPlans[i] = _fftPlan(batch, i);
+        lastPlans[i] = (nSpectra % batch) ?
+                _fftPlan(nSpectra % batch, i) : batchPlans[i];
+    }
+
+    unsigned stride = PPFFirKernel::stride(_nChannels);
+    size_t spectrumBytes = _nChannels * sizeof(Complex);
+    const float* coeffs = _coeffs;
+    const Complex* timeStart = timeSeries->constData();
+    Complex* spectraStart = spectra->data();
+    unsigned historySize = _historySize;
+    unsigned phase = _phase;
+
+    #pragma omp parallel num_threads(_nThreads)
+    {
+        unsigned threadId = omp_get_thread_num();
+        Complex* filteredSamples = _filteredData[threadId];
+
+        #pragma omp for schedule(dynamic)
+        for (int item = 0; item < nItems; ++item)
+        {
+            unsigned subband = item / nPolarisations;
+            unsigned pol = item % nPolarisations;
+            float* re = _workBuffer[item];
+            float* im = re + historySize;
+
+            if (shift)
+            {
+                memmove(re, re + shift, nKeep * sizeof(float));
+                memmove(im, im + shift, nKeep * sizeof(float));
+            }
+
+            // Append the new samples to the history.
+            const Complex* timeData = &timeStart[timeSeries->index(subband,
+                    nTimesPerBlock, pol, nPolarisations, 0, nTimeBlocks)];
+            for (unsigned i = 0; i < nSamples; ++i)
+            {
+                re[iEnd + i] = timeData[i].real();
+                im[iEnd + i] = timeData[i].imag();
+            }
+
+            for (unsigned block = 0; block < nSpectra; block += batch)
+            {
+                unsigned nBlocks = std::min(batch, nSpectra - block);
+
+                for (unsigned b = 0; b < nBlocks; ++b)
+                {
+                    unsigned k = block + b;
+                    unsigned start = iStart + k * _hop;
+                    Complex* filtered = &filteredSamples[b * stride];
+                    _firKernel(&re[start], &im[start], nFilterTaps, 0, stride,
+                            coeffs, filtered);
+
+                    unsigned s = (phase + k * _hop) % _nChannels;
+                    if (s)
+                        std::rotate(filtered, filtered + _nChannels - s,
+                                filtered + _nChannels);
+                }
+
+                _fft(nBlocks == batch ? batchPlans[threadId] : lastPlans[threadId]);
+
+                for (unsigned b = 0; b < nBlocks; ++b)
+                {
+                    unsigned indexSpectra = spectra->index(subband, nSubbands,
+                            pol, nPolarisations, block + b, _nChannels);
+                    memcpy(&spectraStart[indexSpectra],
+                            &filteredSamples[b * stride], spectrumBytes);
+                }
+            }
+        }
+    } // end of parallel region.
+
+    _iStart = iStart + nSpectra * _hop;
+    _iEnd = iEnd + nSamples;
+    _phase = (_phase + nSpectra * _hop) % _nChannels;
+}
+
+
+/**
+* @details
+* Sets the hop between output spectra from the oversampling factor (an
+* integer or a ratio "p/q") or, if given, the hop size.
+*/
+void PPFChanneliser::_setHop(const QString& factor, const QString& hop)
+{
+    if (!hop.isEmpty())
+        _hop = hop.toUInt();
+    else
+    {
+        QStringList ratio = factor.split("/");
+        unsigned p = ratio[0].toUInt();
+        unsigned q = (ratio.size() > 1) ? ratio[1].toUInt() : 1;
+        if (p == 0 || q == 0 || ratio.size() > 2 || (_nChannels * q) % p != 0)
+            throw _err("Oversampling factor '%1' does not give a whole "
+                    "number of samples between spectra.").arg(factor);
+        _hop = _nChannels * q / p;
     }
 
+    if (_hop == 0 || _hop > _nChannels)
+        throw _err("Hop size %1 must be between 1 and the number of "
+                "channels %2.").arg(_hop).arg(_nChannels);
+
+    if (_hop != _nChannels && (PPFFirKernel::stride(_nChannels) != _nChannels
+            || PPFFirKernel::stride(_hop) != _hop))
+        throw _err("Oversampling requires the number of channels (%1) and "
+                "hop size (%2) to be multiples of %3.").arg(_nChannels)
+                .arg(_hop).arg(PPFFirKernel::stride(1));
 }
 
 
 /**
  * @details
  * Generate FIR coefficients for the specified window.
+ *
+ * If a coefficient store is configured the coefficients are mapped from it
+ * in the FIR kernel layout, and generated and saved only if missing.
  */
 void PPFChanneliser::_generateFIRCoefficients(const QString& window, unsigned nTaps)
 {
-    _ppfCoeffs.resize(nTaps, _nChannels);
+    _nTaps = nTaps;
 
     PolyphaseCoefficients::FirWindow windowType;
     if (window == "kaiser")
@@ -207,13 +480,28 @@ void PPFChanneliser::_generateFIRCoefficients(const QString& window, unsigned nT
     else
         throw _err("Unknown coefficient window type '%1'.").arg(window);
 
+    PPFFirKernel::free(_coeffBuffer);
+    _coeffBuffer = 0;
+    _ppfCoeffs.clear();
+
+    if (_coeffStore && (_coeffs = _coeffStore->map(nTaps, _nChannels, windowType)))
+        return;
+
+    _ppfCoeffs.resize(nTaps, _nChannels);
     _ppfCoeffs.genereateFilter(nTaps, _nChannels, windowType);
 
-    // Convert Coefficients to single precision.
-    _coeffs.resize(_ppfCoeffs.size());
+    // Convert Coefficients to single precision, padding each tap to the
+    // row stride used by the FIR kernel.
+    unsigned stride = PPFFirKernel::stride(_nChannels);
+    _coeffBuffer = PPFFirKernel::allocate(nTaps * stride);
     double const* coeffs = _ppfCoeffs.ptr();
-    for (unsigned i = 0u; i < _ppfCoeffs.size(); ++i)
-        _coeffs[i] = (float)coeffs[i];
+    for (unsigned t = 0; t < nTaps; ++t)
+        for (unsigned c = 0; c < _nChannels; ++c)
+            _coeffBuffer[t * stride + c] = (float)coeffs[t * _nChannels + c];
+    _coeffs = _coeffBuffer;
+
+    if (_coeffStore)
+        _coeffStore->save(_coeffBuffer, nTaps, _nChannels, windowType);
 }
 
 
@@ -229,10 +517,7 @@ void PPFChanneliser::_checkData(const TimeSeriesDataSetC32* timeData)
     if (!timeData->nPolarisations()) throw _err("Empty time data blob");
     if (!timeData->nTimeBlocks()) throw _err("Empty time data blob");
 
-    if (_ppfCoeffs.nChannels() != _nChannels)
-        throw _err("Dimension mismatch: Number of FIR coefficient channels %1 "
-                "!= number of output channels %2.")
-                .arg(_ppfCoeffs.nChannels()).arg(_nChannels);
+    if (!_coeffs) throw _err("FIR coefficients missing.");
 }
 
 
@@ -241,16 +526,24 @@ void PPFChanneliser::_checkData(const TimeSeriesDataSetC32* timeData)
 * Prepend nSamples complex data into the start of the buffer moving along
 * other data.
 *
+* The samples are split into the real and imaginary rows of the delay line
+* and the buffer cursor @p iOldest is advanced.
+*
 * @param samples
 * @param nSamples
 */
 void PPFChanneliser::_updateBuffer(const Complex* samples, unsigned nSamples,
-        unsigned nTaps, Complex* buffer)
+        unsigned nTaps, float* buffer, unsigned& iOldest)
 {
-    unsigned tId = omp_get_thread_num();
-    size_t blockSize = nSamples * sizeof(Complex);
-    memcpy(&buffer[_iOldestSamples[tId] * nSamples], samples, blockSize);
-    _iOldestSamples[tId] = (_iOldestSamples[tId] + 1) % nTaps;
+    unsigned stride = PPFFirKernel::stride(nSamples);
+    float* re = &buffer[iOldest * stride];
+    float* im = re + nTaps * stride;
+    for (unsigned i = 0; i < nSamples; ++i)
+    {
+        re[i] = samples[i].real();
+        im[i] = samples[i].imag();
+    }
+    iOldest = (iOldest + 1) % nTaps;
 }
 
 
@@ -258,99 +551,178 @@ void PPFChanneliser::_updateBuffer(const Complex* samples, unsigned nSamples,
  * @details
  * Filter a buffer of time samples.
  *
+ * The filtered samples buffer must hold PPFFirKernel::stride(nChannels)
+ * values; channels beyond nChannels are padding.
+ *
  * @param samples
  * @param nTaps
  * @param nChannels
+ * @param iOldest Row of the oldest samples in the delay line.
  * @param filteredSamples
  */
-void PPFChanneliser::_filter(const Complex* sampleBuffer, unsigned nTaps,
-        unsigned nChannels, const float* coeffs, Complex* filteredSamples)
+void PPFChanneliser::_filter(const float* sampleBuffer, unsigned nTaps,
+        unsigned nChannels, unsigned iOldest, const float* coeffs,
+        Complex* filteredSamples)
 {
-    for (unsigned i = 0; i < nChannels; ++i)
-        filteredSamples[i] = Complex(0.0, 0.0);
-
-    unsigned iBuffer = 0, idx = 0;
-    float re, im, coeff;
-    unsigned tId = omp_get_thread_num();
-
-    for (unsigned i = 0, t = 0; t < nTaps; ++t)
-    {
-        iBuffer = ((_iOldestSamples[tId] + t) % nTaps) * nChannels;
-        for (unsigned c = 0; c < nChannels; ++c)
-        {
-            idx = iBuffer + c;
-            coeff = coeffs[i];
-            re = sampleBuffer[idx].real() * coeff;
-            im = sampleBuffer[idx].imag() * coeff;
-            filteredSamples[c].real() += re;
-            filteredSamples[c].imag() += im;
-            i++;
-        }
-    }
+    unsigned stride = PPFFirKernel::stride(nChannels);
+    _firKernel(sampleBuffer, &sampleBuffer[nTaps * stride], nTaps,
+            iOldest, stride, coeffs, filteredSamples);
 }
 
 
 /**
- * @details
- * Calculates start and end indices for a given thread for splitting nValues
- * of a processing dimension between nThreads.
- */
-void PPFChanneliser::_assign_threads(unsigned& start,
-        unsigned& end, unsigned nValues, unsigned nThreads,
-        unsigned threadId)
+* @details
+* Returns a pointer to the nChannels samples forming spectrum @p k of the
+* work item @p item, where @p samples is the time series of the item for
+* this call. The first spectrum is completed in the residual buffer of the
+* item if samples were left over from the previous call.
+*/
+const PPFChanneliser::Complex* PPFChanneliser::_spectrumSamples(
+        const Complex* samples, unsigned item, unsigned k)
 {
-    if (threadId >= nThreads)
-        throw _err("threadProcessingIndices(): threadId '%1' out of range for"
-                " nThreads = %2.").arg(threadId).arg(nThreads);
+    if (k > 0 || _nResidual == 0)
+        return &samples[k * _nChannels - _nResidual];
 
-    if (threadId >= nValues)
-    {
-        start = end = 0;
-        return;
-    }
+    Complex* residual = &_residual[item * _nChannels];
+    std::copy(samples, samples + _nChannels - _nResidual, residual + _nResidual);
+    return residual;
+}
 
-    unsigned number = nValues / nThreads;
-    unsigned remainder = nValues % nThreads;
-    if (threadId < remainder) number++;
 
-    start = threadId * number;
-    if (threadId >= remainder) start += remainder;
-    end = start + number;
+/**
+* @details
+* Copies the samples of work item @p item which do not complete a spectrum
+* to the residual buffer of the item, for use in the next call.
+*/
+void PPFChanneliser::_saveResidual(const Complex* samples, unsigned nSamples,
+        unsigned item, unsigned nSpectra)
+{
+    Complex* residual = &_residual[item * _nChannels];
+    if (nSpectra == 0)
+        std::copy(samples, samples + nSamples, residual + _nResidual);
+    else
+        std::copy(samples + nSpectra * _nChannels - _nResidual,
+                samples + nSamples, residual);
 }
 
 
 /**
 * @details
 * Set up buffers used to store the last nTaps * nChannels time series values
-* for each sub-band and polarisation.
+* for each sub-band and polarisation, the buffer cursors and the samples
+* left over between calls.
 */
 unsigned PPFChanneliser::_setupWorkBuffers(unsigned nSubbands,
         unsigned nPolarisations, unsigned nChannels, unsigned nTaps)
 {
-    unsigned bufferSize = nChannels * nTaps;
+    _freeWorkBuffers();
+    unsigned bufferSize = 2 * PPFFirKernel::stride(nChannels) * nTaps;
     _workBuffer.resize(nSubbands * nPolarisations);
-    for (unsigned i = 0, s = 0; s < nSubbands; ++s)
+    for (unsigned i = 0; i < _workBuffer.size(); ++i)
+        _workBuffer[i] = PPFFirKernel::allocate(bufferSize);
+    _iOldestSamples.assign(nSubbands * nPolarisations, 0);
+    _residual.assign(nSubbands * nPolarisations * nChannels, Complex(0.0, 0.0));
+    _nResidual = 0;
+    _buffersInitialised = true;
+    return bufferSize;
+}
+
+
+/**
+* @details
+* Set up the sample histories used when oversampling, @p size samples per
+* sub-band and polarisation.
+*
+* If the histories are already set up for @p nItems items, the samples still
+* needed are copied to the start of the new ones; otherwise the histories
+* start with nTaps - 1 rows of zeros, as the delay line does.
+*/
+void PPFChanneliser::_setupHistory(unsigned nItems, unsigned size)
+{
+    bool keep = _buffersInitialised && _workBuffer.size() == nItems;
+    unsigned nKeep = keep ? _iEnd - _iStart
+            : (_nTaps - 1) * _nChannels;
+    size = PPFFirKernel::stride(std::max(size, nKeep));
+
+    vector<float*> history(nItems);
+    for (unsigned i = 0; i < nItems; ++i)
     {
-        for (unsigned p = 0; p < nPolarisations; ++p)
+        history[i] = PPFFirKernel::allocate(2 * size);
+        if (keep)
         {
-            _workBuffer[i].resize(bufferSize, Complex(0.0, 0.0));
-            i++;
+            const float* re = _workBuffer[i] + _iStart;
+            const float* im = _workBuffer[i] + _historySize + _iStart;
+            std::copy(re, re + nKeep, history[i]);
+            std::copy(im, im + nKeep, history[i] + size);
         }
     }
+
+    _freeWorkBuffers();
+    _workBuffer.swap(history);
+    _historySize = size;
+    _iStart = 0;
+    _iEnd = nKeep;
+    if (!keep)
+        _phase = 0;
     _buffersInitialised = true;
-    return bufferSize;
 }
 
 
+/**
+* @details
+* Free the delay line buffers.
+*/
+void PPFChanneliser::_freeWorkBuffers()
+{
+    for (unsigned i = 0; i < _workBuffer.size(); ++i)
+        PPFFirKernel::free(_workBuffer[i]);
+    _workBuffer.clear();
+    _buffersInitialised = false;
+}
+
+
+
+/**
+* @details
+* Returns the FFTW plan used to transform a batch of @p batch spectra held
+* in the work buffer of thread @p threadId, creating it if it is not
+* already cached. Only full batches are planned with the configured
+* rigour; the sizes of remainder batches depend on the chunk size, so they
+* are estimated to avoid stalling the first chunk of each new size.
+*
+* Must not be called from inside a parallel region.
+*/
+fftwf_plan PPFChanneliser::_fftPlan(unsigned batch, unsigned threadId)
+{
+    std::map<unsigned, fftwf_plan>& plans = _fftPlans[threadId];
+    std::map<unsigned, fftwf_plan>::const_iterator it = plans.find(batch);
+    if (it != plans.end())
+        return it->second;
+
+    fftwf_plan plan;
+    unsigned flags = (batch == _fftBatch) ? _fftwFlags : FFTW_ESTIMATE;
+    _createFFTWPlan(_nChannels, batch, _filteredData[threadId], plan, flags);
+    plans[batch] = plan;
+    return plan;
+}
 
-void PPFChanneliser::_createFFTWPlan(unsigned nChannels, fftwf_plan& plan)
+
+/**
+* @details
+* Creates an in-place plan for @p batch transforms of length @p nChannels
+* stored in consecutive rows of the FIR stride in the aligned buffer
+* @p data. Planning may overwrite the contents of the buffer.
+*/
+void PPFChanneliser::_createFFTWPlan(unsigned nChannels, unsigned batch,
+        Complex* data, fftwf_plan& plan, unsigned flags)
 {
-    size_t fftSize = nChannels * sizeof(fftwf_complex);
-    fftwf_complex* in  = (fftwf_complex*) fftwf_malloc(fftSize);
-    fftwf_complex* out = (fftwf_complex*) fftwf_malloc(fftSize);
-    plan = fftwf_plan_dft_1d(_nChannels, in, out, FFTW_FORWARD, FFTW_MEASURE);
-    fftwf_free(in);
-    fftwf_free(out);
+    int n = nChannels;
+    int dist = PPFFirKernel::stride(nChannels);
+    fftwf_complex* in = (fftwf_complex*) data;
+    plan = fftwf_plan_many_dft(1, &n, batch, in, NULL, 1, dist,
+            in, NULL, 1, dist, FFTW_FORWARD, flags);
+    if (!plan)
+        throw _err("Unable to create FFTW plan.");
 }
 
 
@@ -0,0 +1,159 @@
+#include "PPFCoefficientStore.h"
+#include "PPFFirKernel.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QtGlobal>
+
+#include <cstring>
+
+namespace pelican {
+namespace ampp {
+
+/*
+ * File header, padded to the FIR kernel alignment so the coefficients that
+ * follow it are aligned when the file is mapped.
+ */
+struct PPFCoefficientHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 nTaps;
+    quint32 nChannels;
+    quint32 window;
+    quint32 stride;
+    quint32 reserved[10];
+};
+
+// "PPFC" when read with the byte order the file was written in.
+static const quint32 _magic = 0x43465050;
+
+
+/**
+ * @details
+ * Constructs a coefficient store in @p directory, which is created when
+ * coefficients are first saved.
+ */
+PPFCoefficientStore::PPFCoefficientStore(const QString& directory)
+: _directory(directory), _data(0)
+{
+}
+
+
+/**
+ * @details
+ * Destroys the store. Pointers returned by map() are no longer valid.
+ */
+PPFCoefficientStore::~PPFCoefficientStore()
+{
+    _unmap();
+}
+
+
+/**
+ * @details
+ * Maps the stored coefficients for the filter, returning a pointer to
+ * nTaps rows of PPFFirKernel::stride(nChannels) floats which remains valid
+ * until the next call or the store is destroyed. Returns 0 if the file does
+ * not exist or does not match the key and format.
+ */
+const float* PPFCoefficientStore::map(unsigned nTaps, unsigned nChannels,
+        PolyphaseCoefficients::FirWindow window)
+{
+    _unmap();
+
+    unsigned stride = PPFFirKernel::stride(nChannels);
+    qint64 size = sizeof(PPFCoefficientHeader)
+            + qint64(nTaps) * stride * sizeof(float);
+
+    _file.setFileName(fileName(nTaps, nChannels, window));
+    if (!_file.open(QIODevice::ReadOnly))
+        return 0;
+
+    if (_file.size() == size)
+        _data = _file.map(0, size);
+
+    const PPFCoefficientHeader* header =
+            reinterpret_cast<const PPFCoefficientHeader*>(_data);
+    if (!header || header->magic != _magic || header->version != version
+            || header->nTaps != nTaps || header->nChannels != nChannels
+            || header->window != quint32(window) || header->stride != stride)
+    {
+        _unmap();
+        return 0;
+    }
+
+    return reinterpret_cast<const float*>(_data + sizeof(PPFCoefficientHeader));
+}
+
+
+/**
+ * @details
+ * Saves coefficients in the PPFFirKernel layout (nTaps rows of
+ * PPFFirKernel::stride(nChannels) floats). The file is written under a
+ * temporary name and renamed so other processes never map a partial file.
+ */
+void PPFCoefficientStore::save(const float* coeffs, unsigned nTaps,
+        unsigned nChannels, PolyphaseCoefficients::FirWindow window)
+{
+    if (!QDir().mkpath(_directory))
+        throw QString("PPFCoefficientStore: Unable to create directory %1.")
+                .arg(_directory);
+
+    PPFCoefficientHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = _magic;
+    header.version = version;
+    header.nTaps = nTaps;
+    header.nChannels = nChannels;
+    header.window = window;
+    header.stride = PPFFirKernel::stride(nChannels);
+
+    QString name = fileName(nTaps, nChannels, window);
+    QFile file(name + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw QString("PPFCoefficientStore: Unable to write %1.")
+                .arg(file.fileName());
+
+    qint64 bytes = qint64(nTaps) * header.stride * sizeof(float);
+    if (file.write((const char*)&header, sizeof(header)) != sizeof(header)
+            || file.write((const char*)coeffs, bytes) != bytes)
+    {
+        file.remove();
+        throw QString("PPFCoefficientStore: Error writing %1.")
+                .arg(file.fileName());
+    }
+    file.close();
+
+    QFile::remove(name);
+    if (!file.rename(name))
+        throw QString("PPFCoefficientStore: Unable to rename %1 to %2.")
+                .arg(file.fileName()).arg(name);
+}
+
+
+/**
+ * @details
+ * Returns the file name for the (nTaps, nChannels, window) key.
+ */
+QString PPFCoefficientStore::fileName(unsigned nTaps, unsigned nChannels,
+        PolyphaseCoefficients::FirWindow window) const
+{
+    return QString("%1/ppf_w%2_t%3_c%4.v%5.coeff").arg(_directory)
+            .arg(int(window)).arg(nTaps).arg(nChannels).arg(version);
+}
+
+
+/**
+ * @details
+ * Unmaps and closes the current file.
+ */
+void PPFCoefficientStore::_unmap()
+{
+    if (_data)
+        _file.unmap(_data);
+    _data = 0;
+    _file.close();
+}
+
+}// namespace ampp
+}// namespace pelican
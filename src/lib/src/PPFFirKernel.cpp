@@ -0,0 +1,287 @@
+#include "PPFFirKernel.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PPF_FIR_X86
+#include <immintrin.h>
+#endif
+
+namespace pelican {
+namespace ampp {
+
+typedef PPFFirKernel::Complex Complex;
+
+
+/**
+ * @details
+ * Reference implementation, used where no vector kernel is available.
+ */
+static void _firScalar(const float* re, const float* im, unsigned nTaps,
+        unsigned iOldest, unsigned stride, const float* coeffs,
+        Complex* filteredSamples)
+{
+    float* out = reinterpret_cast<float*>(filteredSamples);
+    for (unsigned c = 0; c < 2 * stride; ++c)
+        out[c] = 0.0f;
+
+    for (unsigned t = 0, row = iOldest; t < nTaps; ++t)
+    {
+        const float* cf = &coeffs[t * stride];
+        const float* r = &re[row * stride];
+        const float* i = &im[row * stride];
+        for (unsigned c = 0; c < stride; ++c)
+        {
+            out[2 * c]     += cf[c] * r[c];
+            out[2 * c + 1] += cf[c] * i[c];
+        }
+        if (++row == nTaps) row = 0;
+    }
+}
+
+
+#ifdef PPF_FIR_X86
+
+/**
+ * @details
+ * SSE kernel: 16 channels (one cache line) per iteration.
+ */
+__attribute__((target("sse2")))
+static void _firSse(const float* re, const float* im, unsigned nTaps,
+        unsigned iOldest, unsigned stride, const float* coeffs,
+        Complex* filteredSamples)
+{
+    float* out = reinterpret_cast<float*>(filteredSamples);
+    for (unsigned c = 0; c < stride; c += 16)
+    {
+        __m128 r0 = _mm_setzero_ps(), r1 = r0, r2 = r0, r3 = r0;
+        __m128 i0 = r0, i1 = r0, i2 = r0, i3 = r0;
+        for (unsigned t = 0, row = iOldest; t < nTaps; ++t)
+        {
+            const float* cf = &coeffs[t * stride + c];
+            const float* r = &re[row * stride + c];
+            const float* i = &im[row * stride + c];
+            __m128 k0 = _mm_load_ps(cf),     k1 = _mm_load_ps(cf + 4);
+            __m128 k2 = _mm_load_ps(cf + 8), k3 = _mm_load_ps(cf + 12);
+            r0 = _mm_add_ps(r0, _mm_mul_ps(k0, _mm_load_ps(r)));
+            r1 = _mm_add_ps(r1, _mm_mul_ps(k1, _mm_load_ps(r + 4)));
+            r2 = _mm_add_ps(r2, _mm_mul_ps(k2, _mm_load_ps(r + 8)));
+            r3 = _mm_add_ps(r3, _mm_mul_ps(k3, _mm_load_ps(r + 12)));
+            i0 = _mm_add_ps(i0, _mm_mul_ps(k0, _mm_load_ps(i)));
+            i1 = _mm_add_ps(i1, _mm_mul_ps(k1, _mm_load_ps(i + 4)));
+            i2 = _mm_add_ps(i2, _mm_mul_ps(k2, _mm_load_ps(i + 8)));
+            i3 = _mm_add_ps(i3, _mm_mul_ps(k3, _mm_load_ps(i + 12)));
+            if (++row == nTaps) row = 0;
+        }
+        // Interleave back to complex samples for the FFT.
+        float* o = &out[2 * c];
+        _mm_storeu_ps(o,      _mm_unpacklo_ps(r0, i0));
+        _mm_storeu_ps(o + 4,  _mm_unpackhi_ps(r0, i0));
+        _mm_storeu_ps(o + 8,  _mm_unpacklo_ps(r1, i1));
+        _mm_storeu_ps(o + 12, _mm_unpackhi_ps(r1, i1));
+        _mm_storeu_ps(o + 16, _mm_unpacklo_ps(r2, i2));
+        _mm_storeu_ps(o + 20, _mm_unpackhi_ps(r2, i2));
+        _mm_storeu_ps(o + 24, _mm_unpacklo_ps(r3, i3));
+        _mm_storeu_ps(o + 28, _mm_unpackhi_ps(r3, i3));
+    }
+}
+
+
+/**
+ * @details
+ * AVX2 kernel: 16 channels (one cache line) per iteration using FMA.
+ */
+__attribute__((target("avx2,fma")))
+static void _firAvx2(const float* re, const float* im, unsigned nTaps,
+        unsigned iOldest, unsigned stride, const float* coeffs,
+        Complex* filteredSamples)
+{
+    float* out = reinterpret_cast<float*>(filteredSamples);
+    for (unsigned c = 0; c < stride; c += 16)
+    {
+        __m256 r0 = _mm256_setzero_ps(), r1 = r0, i0 = r0, i1 = r0;
+        for (unsigned t = 0, row = iOldest; t < nTaps; ++t)
+        {
+            const float* cf = &coeffs[t * stride + c];
+            const float* r = &re[row * stride + c];
+            const float* i = &im[row * stride + c];
+            __m256 k0 = _mm256_load_ps(cf), k1 = _mm256_load_ps(cf + 8);
+            r0 = _mm256_fmadd_ps(k0, _mm256_load_ps(r), r0);
+            r1 = _mm256_fmadd_ps(k1, _mm256_load_ps(r + 8), r1);
+            i0 = _mm256_fmadd_ps(k0, _mm256_load_ps(i), i0);
+            i1 = _mm256_fmadd_ps(k1, _mm256_load_ps(i + 8), i1);
+            if (++row == nTaps) row = 0;
+        }
+        // Interleave back to complex samples (unpack works per 128-bit lane).
+        float* o = &out[2 * c];
+        __m256 lo = _mm256_unpacklo_ps(r0, i0), hi = _mm256_unpackhi_ps(r0, i0);
+        _mm256_storeu_ps(o,      _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(o + 8,  _mm256_permute2f128_ps(lo, hi, 0x31));
+        lo = _mm256_unpacklo_ps(r1, i1); hi = _mm256_unpackhi_ps(r1, i1);
+        _mm256_storeu_ps(o + 16, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(o + 24, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+}
+
+
+/**
+ * @details
+ * AVX-512 kernel: 32 channels per iteration where possible, one cache line
+ * for the remainder.
+ */
+__attribute__((target("avx512f")))
+static void _firAvx512(const float* re, const float* im, unsigned nTaps,
+        unsigned iOldest, unsigned stride, const float* coeffs,
+        Complex* filteredSamples)
+{
+    float* out = reinterpret_cast<float*>(filteredSamples);
+    const __m512i first  = _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19,
+            4, 5, 6, 7, 20, 21, 22, 23);
+    const __m512i second = _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27,
+            12, 13, 14, 15, 28, 29, 30, 31);
+
+    unsigned c = 0;
+    for (; c + 32 <= stride; c += 32)
+    {
+        __m512 r0 = _mm512_setzero_ps(), r1 = r0, i0 = r0, i1 = r0;
+        for (unsigned t = 0, row = iOldest; t < nTaps; ++t)
+        {
+            const float* cf = &coeffs[t * stride + c];
+            const float* r = &re[row * stride + c];
+            const float* i = &im[row * stride + c];
+            __m512 k0 = _mm512_load_ps(cf), k1 = _mm512_load_ps(cf + 16);
+            r0 = _mm512_fmadd_ps(k0, _mm512_load_ps(r), r0);
+            r1 = _mm512_fmadd_ps(k1, _mm512_load_ps(r + 16), r1);
+            i0 = _mm512_fmadd_ps(k0, _mm512_load_ps(i), i0);
+            i1 = _mm512_fmadd_ps(k1, _mm512_load_ps(i + 16), i1);
+            if (++row == nTaps) row = 0;
+        }
+        float* o = &out[2 * c];
+        __m512 lo = _mm512_unpacklo_ps(r0, i0), hi = _mm512_unpackhi_ps(r0, i0);
+        _mm512_storeu_ps(o,      _mm512_permutex2var_ps(lo, first, hi));
+        _mm512_storeu_ps(o + 16, _mm512_permutex2var_ps(lo, second, hi));
+        lo = _mm512_unpacklo_ps(r1, i1); hi = _mm512_unpackhi_ps(r1, i1);
+        _mm512_storeu_ps(o + 32, _mm512_permutex2var_ps(lo, first, hi));
+        _mm512_storeu_ps(o + 48, _mm512_permutex2var_ps(lo, second, hi));
+    }
+    for (; c < stride; c += 16)
+    {
+        __m512 r0 = _mm512_setzero_ps(), i0 = r0;
+        for (unsigned t = 0, row = iOldest; t < nTaps; ++t)
+        {
+            __m512 k0 = _mm512_load_ps(&coeffs[t * stride + c]);
+            r0 = _mm512_fmadd_ps(k0, _mm512_load_ps(&re[row * stride + c]), r0);
+            i0 = _mm512_fmadd_ps(k0, _mm512_load_ps(&im[row * stride + c]), i0);
+            if (++row == nTaps) row = 0;
+        }
+        float* o = &out[2 * c];
+        __m512 lo = _mm512_unpacklo_ps(r0, i0), hi = _mm512_unpackhi_ps(r0, i0);
+        _mm512_storeu_ps(o,      _mm512_permutex2var_ps(lo, first, hi));
+        _mm512_storeu_ps(o + 16, _mm512_permutex2var_ps(lo, second, hi));
+    }
+}
+
+#endif // PPF_FIR_X86
+
+
+/**
+ * @details
+ * Returns the fastest kernel supported by the host CPU.
+ */
+PPFFirKernel::Type PPFFirKernel::best()
+{
+    if (supported(AVX512)) return AVX512;
+    if (supported(AVX2)) return AVX2;
+    if (supported(SSE)) return SSE;
+    return SCALAR;
+}
+
+
+/**
+ * @details
+ * Returns true if the kernel type can run on the host CPU.
+ */
+bool PPFFirKernel::supported(Type type)
+{
+    switch (type)
+    {
+        case SCALAR:
+            return true;
+#ifdef PPF_FIR_X86
+        case SSE:
+            return __builtin_cpu_supports("sse2");
+        case AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * @details
+ * Returns the filter function for the specified kernel type.
+ */
+PPFFirKernel::Function PPFFirKernel::function(Type type)
+{
+    if (!supported(type))
+        throw QString("PPFFirKernel: %1 kernel not supported on this CPU.")
+                .arg(name(type));
+
+    switch (type)
+    {
+#ifdef PPF_FIR_X86
+        case SSE:    return _firSse;
+        case AVX2:   return _firAvx2;
+        case AVX512: return _firAvx512;
+#endif
+        default:     return _firScalar;
+    }
+}
+
+
+/**
+ * @details
+ * Returns the name of the kernel type.
+ */
+QString PPFFirKernel::name(Type type)
+{
+    switch (type)
+    {
+        case SSE:    return "sse";
+        case AVX2:   return "avx2";
+        case AVX512: return "avx512";
+        default:     return "scalar";
+    }
+}
+
+
+/**
+ * @details
+ * Allocates a zeroed buffer of n floats aligned to PPFFirKernel::alignment.
+ */
+float* PPFFirKernel::allocate(size_t n)
+{
+    void* buffer = 0;
+    if (posix_memalign(&buffer, alignment, n * sizeof(float)) != 0)
+        throw QString("PPFFirKernel: Unable to allocate aligned buffer.");
+    memset(buffer, 0, n * sizeof(float));
+    return static_cast<float*>(buffer);
+}
+
+
+/**
+ * @details
+ * Frees a buffer allocated with PPFFirKernel::allocate().
+ */
+void PPFFirKernel::free(float* buffer)
+{
+    ::free(buffer);
+}
+
+}// namespace ampp
+}// namespace pelican
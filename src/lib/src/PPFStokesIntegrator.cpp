@@ -0,0 +1,287 @@
+#include "PPFStokesIntegrator.h"
+
+#include "pelican/utility/ConfigNode.h"
+
+#include "TimeSeriesDataSet.h"
+#include "SpectrumDataSet.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace pelican {
+namespace ampp {
+
+
+/**
+ * @details
+ * Constructor.
+ *
+ * @param[in] config XML configuration node.
+ */
+PPFStokesIntegrator::PPFStokesIntegrator(const ConfigNode& config)
+: PPFChanneliser(config), _nPartial(0), _partialTimestamp(0.0)
+{
+    _numberOfStokes = config.getOption("numberOfStokes", "value", "4").toUInt();
+    _windowSize = config.getOption("integrateTimeBins", "value", "1").toUInt();
+    _binChannels = config.getOption("integrateFrequencyChannels", "value", "1").toUInt();
+
+    if (_numberOfStokes != 1 && _numberOfStokes != 4)
+        throw _err("Number of Stokes parameters must be 1 or 4.");
+
+    if (_nChannels == 1)
+        throw _err("Fused Stokes generation requires more than one channel.");
+
+    if (_hop != _nChannels)
+        throw _err("Oversampled channelisation is not supported.");
+
+    if (_windowSize == 0 || _binChannels == 0)
+        throw _err("Integration factors must be at least 1.");
+
+    if (_nChannels % _binChannels != 0)
+        throw _err("Number of channels %1 is not a multiple of "
+                "integrateFrequencyChannels %2.").arg(_nChannels)
+                .arg(_binChannels);
+
+    // Allocate the Y polarisation scratch buffers.
+    unsigned stride = PPFFirKernel::stride(_nChannels);
+    _filteredDataY.resize(_nThreads);
+    for (unsigned i = 0; i < _nThreads; ++i)
+        _filteredDataY[i] = (Complex*) PPFFirKernel::allocate(2 * stride * _fftBatch);
+}
+
+
+/**
+ * @details
+ * Destroys the fused channeliser module.
+ */
+PPFStokesIntegrator::~PPFStokesIntegrator()
+{
+    for (unsigned i = 0; i < _filteredDataY.size(); ++i)
+        PPFFirKernel::free((float*)_filteredDataY[i]);
+}
+
+
+/**
+ * @details
+ * Channelises the X and Y polarisations of each sub-band a batch of blocks
+ * at a time and accumulates the resulting Stokes parameters directly into
+ * the integrated output.
+ *
+ * Sub-bands are scheduled dynamically over the processing threads; each
+ * output spectrum belongs to a single sub-band so threads never write to
+ * the same output. Spectra of the trailing incomplete window are summed
+ * into the partial buffer of the sub-band and complete the first window
+ * of the next call.
+ *
+ * @param[in]  timeSeries Buffer of time samples to be channelised.
+ * @param[out] stokes     Integrated Stokes spectra.
+ */
+void PPFStokesIntegrator::run(const TimeSeriesDataSetC32* timeSeries,
+        SpectrumDataSetStokes* stokes)
+{
+    _checkData(timeSeries);
+
+    unsigned nSubbands      = timeSeries->nSubbands();
+    unsigned nPolarisations = timeSeries->nPolarisations();
+    unsigned nTimeBlocks    = timeSeries->nTimeBlocks();
+    unsigned nTimesPerBlock = timeSeries->nTimesPerBlock();
+
+    if (nPolarisations != 2)
+        throw _err("Two polarisations required, found %1.").arg(nPolarisations);
+
+    unsigned nFilterTaps = _nTaps;
+    unsigned nOutChannels = _nChannels / _binChannels;
+    if (!_buffersInitialised || _workBuffer.size() != nSubbands * nPolarisations)
+    {
+        // A new stream: also discard any partial window.
+        _setupWorkBuffers(nSubbands, nPolarisations, _nChannels, nFilterTaps);
+        _partial.assign(nSubbands * _numberOfStokes * nOutChannels, 0.0f);
+        _nPartial = 0;
+    }
+
+    // Number of complete spectra including left over samples (as for
+    // PPFChanneliser::run()).
+    unsigned nSamples = nTimeBlocks * nTimesPerBlock;
+    unsigned nSpectra = (_nResidual + nSamples) / _nChannels;
+    double spectrumRate = timeSeries->getBlockRate() * _nChannels;
+    double firstSpectrum = timeSeries->getLofarTimestamp()
+            - _nResidual * timeSeries->getBlockRate();
+
+    if (_nPartial == 0)
+        _partialTimestamp = firstSpectrum;
+
+    // Number of windows completed by this chunk.
+    unsigned newSamples = (_nPartial + nSpectra) / _windowSize;
+    stokes->resize(newSamples, nSubbands, _numberOfStokes, nOutChannels);
+    stokes->setLofarTimestamp(_partialTimestamp);
+    stokes->setBlockRate(spectrumRate * _windowSize);
+    unsigned nPartial = _nPartial;
+
+    // Get the FFT plans outside the parallel region.
+    unsigned batch = std::min(_fftBatch, nSpectra);
+    vector<fftwf_plan> batchPlans(_nThreads), lastPlans(_nThreads);
+    for (unsigned i = 0; i < _nThreads && nSpectra > 0; ++i)
+    {
+        batchPlans[i] = _fftPlan(batch, i);
+        lastPlans[i] = (nSpectra % batch) ?
+                _fftPlan(nSpectra % batch, i) : batchPlans[i];
+    }
+
+    unsigned stride = PPFFirKernel::stride(_nChannels);
+    size_t spectrumBytes = nOutChannels * sizeof(float);
+    const float* coeffs = _coeffs;
+    const Complex* timeStart = timeSeries->constData();
+    int nSubbandItems = nSubbands;
+
+    #pragma omp parallel num_threads(_nThreads)
+    {
+        unsigned threadId = omp_get_thread_num();
+        Complex* filtered[2] = { _filteredData[threadId], _filteredDataY[threadId] };
+        float* out[4] = { 0, 0, 0, 0 };
+
+        #pragma omp for schedule(dynamic)
+        for (int s = 0; s < nSubbandItems; ++s)
+        {
+            unsigned subband = s;
+            const Complex* timeData[2];
+            for (unsigned pol = 0; pol < 2; ++pol)
+                timeData[pol] = &timeStart[timeSeries->index(subband,
+                        nTimesPerBlock, pol, nPolarisations, 0, nTimeBlocks)];
+
+            for (unsigned block = 0; block < nSpectra; block += batch)
+            {
+                unsigned nBlocks = std::min(batch, nSpectra - block);
+                fftwf_plan plan = (nBlocks == batch) ?
+                        batchPlans[threadId] : lastPlans[threadId];
+
+                // Channelise a batch of blocks for both polarisations.
+                for (unsigned pol = 0; pol < 2; ++pol)
+                {
+                    unsigned item = subband * nPolarisations + pol;
+                    float* workBuffer = _workBuffer[item];
+                    unsigned& iOldest = _iOldestSamples[item];
+                    for (unsigned b = 0; b < nBlocks; ++b)
+                    {
+                        _updateBuffer(_spectrumSamples(timeData[pol], item, block + b),
+                                _nChannels, nFilterTaps, workBuffer, iOldest);
+                        _filter(workBuffer, nFilterTaps, _nChannels, iOldest,
+                                coeffs, &filtered[pol][b * stride]);
+                    }
+                    // The Y buffer has the same alignment and layout as the
+                    // buffer the plan was created for.
+                    fftwf_execute_dft(plan, (fftwf_complex*)filtered[pol],
+                            (fftwf_complex*)filtered[pol]);
+                }
+
+                // Form Stokes parameters and integrate, counting the
+                // spectra already in the partial sum.
+                for (unsigned b = 0; b < nBlocks; ++b)
+                {
+                    unsigned t = block + b;
+                    unsigned k = nPartial + t;
+                    unsigned u = k / _windowSize;
+                    for (unsigned p = 0; p < _numberOfStokes; ++p)
+                    {
+                        float* partial = &_partial[(subband * _numberOfStokes + p)
+                                * nOutChannels];
+                        if (u < newSamples)
+                        {
+                            out[p] = stokes->spectrumData(u, subband, p);
+                            if (t == 0 && nPartial > 0)
+                                memcpy(out[p], partial, spectrumBytes);
+                            else if (k % _windowSize == 0)
+                                memset(out[p], 0, spectrumBytes);
+                        }
+                        else
+                        {
+                            out[p] = partial;
+                            if (k % _windowSize == 0)
+                                memset(out[p], 0, spectrumBytes);
+                        }
+                    }
+                    _accumulate(&filtered[0][b * stride], &filtered[1][b * stride],
+                            out[0], out[1], out[2], out[3]);
+                }
+            }
+
+            // Keep samples of the incomplete spectrum for the next call.
+            for (unsigned pol = 0; pol < 2; ++pol)
+                _saveResidual(timeData[pol], nSamples,
+                        subband * nPolarisations + pol, nSpectra);
+        }
+    } // end of parallel region.
+
+    // Keep track of the incomplete window, which starts after the spectra
+    // used to complete windows in this chunk.
+    if (newSamples > 0)
+        _partialTimestamp = firstSpectrum
+                + (newSamples * _windowSize - _nPartial) * spectrumRate;
+    _nPartial = (_nPartial + nSpectra) % _windowSize;
+    _nResidual = (_nResidual + nSamples) % _nChannels;
+}
+
+
+/**
+ * @details
+ * Adds the Stokes parameters of the spectra X and Y to the output spectra,
+ * summing _binChannels adjacent channels into each output channel.
+ * Q, U and V are only used when generating 4 Stokes parameters.
+ */
+void PPFStokesIntegrator::_accumulate(const Complex* X, const Complex* Y,
+        float* I, float* Q, float* U, float* V)
+{
+    unsigned nOutChannels = _nChannels / _binChannels;
+    const float* x = reinterpret_cast<const float*>(X);
+    const float* y = reinterpret_cast<const float*>(Y);
+
+    if (_numberOfStokes == 1)
+    {
+        for (unsigned c = 0, nc = 0; nc < nOutChannels; ++nc)
+        {
+            float sumI = 0.0f;
+            for (unsigned k = 0; k < _binChannels; ++k, ++c)
+            {
+                float Xr = x[2 * c], Xi = x[2 * c + 1];
+                float Yr = y[2 * c], Yi = y[2 * c + 1];
+                sumI += Xr * Xr + Xi * Xi + Yr * Yr + Yi * Yi;
+            }
+            I[nc] += sumI;
+        }
+        return;
+    }
+
+    for (unsigned c = 0, nc = 0; nc < nOutChannels; ++nc)
+    {
+        float sumI = 0.0f, sumQ = 0.0f, sumU = 0.0f, sumV = 0.0f;
+        for (unsigned k = 0; k < _binChannels; ++k, ++c)
+        {
+            float Xr = x[2 * c], Xi = x[2 * c + 1];
+            float Yr = y[2 * c], Yi = y[2 * c + 1];
+            float powerX = Xr * Xr + Xi * Xi;
+            float powerY = Yr * Yr + Yi * Yi;
+            sumI += powerX + powerY;
+            sumQ += powerX - powerY;
+            sumU += 2.0f * (Xr * Yr + Xi * Yi);
+            sumV += 2.0f * (Xi * Yr - Xr * Yi);
+        }
+        I[nc] += sumI;
+        Q[nc] += sumQ;
+        U[nc] += sumU;
+        V[nc] += sumV;
+    }
+}
+
+
+/**
+ * @details
+ * Returns a message use for errors and throws from the module.
+ */
+QString PPFStokesIntegrator::_err(const QString& message)
+{
+    return QString("PPFStokesIntegrator: ") + message;
+}
+
+}// namespace ampp
+}// namespace pelican
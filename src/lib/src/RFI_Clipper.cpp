@@ -2,8 +2,12 @@
 #include "SpectrumDataSet.h"
 #include "WeightedSpectrumDataSet.h"
 #include <QtCore/QFile>
+#include <QtCore/QMutexLocker>
 #include <QtCore/QString>
+#include <algorithm>
+#include <cstring>
 #include "BandPassAdapter.h"
+#include "BandPassLoader.h"
 #include "BandPass.h"
 #include "BinMap.h"
 #include "pelican/utility/ConfigNode.h"
@@ -20,8 +24,9 @@ namespace ampp {
  *@details RFI_Clipper
  */
 RFI_Clipper::RFI_Clipper( const ConfigNode& config )
-  : AbstractModule( config ), _active(true), _crFactor(10.0),_srFactor(4.0), _current(0),
-    _badSpectra(0), _fractionBadChannels(0)
+  : AbstractModule( config ), _loader(0), _haveNextBandPass(false), _active(true),
+    _crFactor(10.0),_srFactor(4.0), _current(0), _badSpectra(0),
+    _bandPassUpdates(0)
 {
     _current = 0;
     if( config.hasAttribute("active") &&
@@ -45,6 +50,11 @@ RFI_Clipper::RFI_Clipper( const ConfigNode& config )
         dataFile.waitForReadyRead(-1);
         adapter.config(&_bandPass, dataFile.size());
         adapter.deserialise(&dataFile);
+
+        // watch the file for new versions of the model
+        unsigned long interval = config.getOption("BandPassData", "watch", "0").toULong();
+        if( interval > 0 )
+            _loader = new BandPassLoader(config, file, interval);
     }
     else {
         if( _active )
@@ -68,12 +78,39 @@ RFI_Clipper::RFI_Clipper( const ConfigNode& config )
     if( config.getOption("zeroDMing", "active" ) == "true" ) {
       _zeroDMing = 1;
     }
+    _useMeanOverRMS = 0;
     if( config.getOption("computeRMSfromMean", "active", "true" ) == "true" ) {
       _useMeanOverRMS = 1;
     }
+    _meanRunAve = 0.0;
+    _rmsRunAve = 0.0;
+    _meanOverRMS = 0.0;
+    _lastGoodMean = 0.0;
+    _lastGoodRMS = 0.0;
+    _remainingZeros = 0;
+    _nThreads = config.getOption("processingThreads", "value", "1").toUInt();
+    if( _nThreads == 0 )
+        throw(QString("RFI_Clipper: <processingThreads value=?> must be at least 1"));
+
+    _nBands = config.getOption("Bands", "number", "8").toUInt();
+    if( _nBands == 0 )
+        throw(QString("RFI_Clipper: <Bands number=?> must be at least 1"));
+
+    _maskHistory = config.getOption("ChannelMask", "history", "0").toUInt();
+    _maskThreshold = config.getOption("ChannelMask", "threshold", "5.0").toFloat();
+    _maskMinFraction = config.getOption("ChannelMask", "minFraction", "0.5").toFloat();
+
+    // Scratch space so that no allocation is done per spectrum
+    _bandStart.resize(_nBands + 1);
+    _bandModelMin.resize(_nBands);
+    _goodChannels.resize(_nBands);
+    _maskedInBand.resize(_nBands, 0);
+    _bandScratchSize = 2 * _nBands;
+    _bandScratch.resize(_nThreads * _bandScratchSize);
     _startFrequency = 0.0;
     _endFrequency = 0.0;
-    if( config.getOption("Band", "matching" ) == "true" ) {
+    _bandMatching = config.getOption("Band", "matching" ) == "true";
+    if( _bandMatching ) {
         _startFrequency = _bandPass.startFrequency();
         _endFrequency = _bandPass.endFrequency();
     }
@@ -108,6 +145,59 @@ RFI_Clipper::RFI_Clipper( const ConfigNode& config )
  */
 RFI_Clipper::~RFI_Clipper()
 {
+    delete _loader;
+}
+
+/**
+ * @details
+ * Stages a new bandpass model, e.g. received from a remote BandPass
+ * stream, to be used from the start of the next chunk. May be called from
+ * another thread than run().
+ */
+void RFI_Clipper::updateBandPass( const BandPass& bandPass )
+{
+    QMutexLocker lock(&_nextBandPassMutex);
+    _nextBandPass = bandPass;
+    _haveNextBandPass = true;
+}
+
+/**
+ * @details
+ * Swaps in any new bandpass model, staged by updateBandPass() or loaded
+ * from the watched file, keeping the running statistics. Returns true if
+ * the model was changed.
+ */
+bool RFI_Clipper::_swapBandPass()
+{
+    bool swapped = false;
+    if( _loader ) {
+        BandPass* bp = _loader->take();
+        if( bp ) {
+            _bandPass = *bp;
+            delete bp;
+            swapped = true;
+        }
+    }
+    // never wait for updateBandPass(): a model staged while it holds the
+    // lock is picked up on the next chunk
+    if( _nextBandPassMutex.tryLock() ) {
+        if( _haveNextBandPass ) {
+            _bandPass = _nextBandPass;
+            _haveNextBandPass = false;
+            swapped = true;
+        }
+        _nextBandPassMutex.unlock();
+    }
+    if( swapped ) {
+        _medianFromFile = _bandPass.median();
+        _rmsFromFile = _bandPass.rms();
+        if( _bandMatching ) {
+            _startFrequency = _bandPass.startFrequency();
+            _endFrequency = _bandPass.endFrequency();
+        }
+        ++_bandPassUpdates;
+    }
+    return swapped;
 }
   
   /**
@@ -124,37 +214,255 @@ RFI_Clipper::~RFI_Clipper()
    *
    */
 
-  static inline void clipSample( SpectrumDataSetStokes* stokesAll, float* W, unsigned t, std::vector<float> lastGoodSpectrum ) {
+  static inline void clipSample( SpectrumDataSetStokes* stokesAll, float* W, unsigned t, const float* lastGoodSpectrum ) {
 
     float* I = stokesAll->data();
     unsigned nSubbands = stokesAll->nSubbands();
     unsigned nPolarisations= stokesAll->nPolarisations();
     unsigned nChannels= stokesAll->nChannels();
-    // Clip entire spectrum
-    //#pragma omp parallel for num_threads(4)
+    // Clip entire spectrum, replacing each subband and polarisation
+    // with the corresponding slice of the last good spectrum
     for (unsigned s = 0; s < nSubbands; ++s) {
       // The following is for clipping the polarization
       for(unsigned int pol = 0; pol < nPolarisations; ++pol ) {
         long index = stokesAll->index(s, nSubbands,
                 pol, nPolarisations,
                 t, nChannels );
-        for (unsigned c = 0; c < nChannels; ++c) {
-	  //            I[index + c] = 0.0;
-	  W[index + c] = 1.0;
-          //  W[index + c] = 0.0;
-	  I[index + c] = lastGoodSpectrum[s*nChannels + c];
-        }
+        std::fill(W + index, W + index + nChannels, 1.0f);
+        std::memcpy(I + index, lastGoodSpectrum + s*nChannels,
+                    nChannels * sizeof(float));
       }
     }
 }
 
+/**
+ * @details
+ * Accumulates the minimum, sum and sum of squares of the @p n contiguous
+ * values at @p x. Only the minimum, which does not depend on the order of
+ * evaluation, is vectorised: the sums are accumulated in channel order so
+ * that the band statistics are the same as those of a scalar build.
+ */
+static inline void bandReduce( const float* x, unsigned n, float& minimum,
+                               float& sum, float& sumSq )
+{
+  float mn = minimum;
+  #pragma omp simd reduction(min:mn)
+  for (unsigned i = 0; i < n; ++i) {
+    mn = std::min(mn, x[i]);
+  }
+  minimum = mn;
+  for (unsigned i = 0; i < n; ++i) {
+    sum += x[i];
+    sumSq += x[i] * x[i];
+  }
+}
+
+/**
+ * @details
+ * Computes the band statistics of spectrum @p t used while the running
+ * averages are being trained: the minimum band RMS and the median distance
+ * between the band minima of the data and of the bandpass model. These only
+ * depend on the spectrum itself, so may be computed for all spectra of a
+ * chunk in parallel.
+ */
+void RFI_Clipper::_bandStatistics( SpectrumDataSetStokes* stokesAll,
+                                   const QVector<float>& bandPass, unsigned t,
+                                   float* scratch,
+                                   float& spectrumRMS, float& dataModel ) const
+{
+  const float* I = stokesAll->data();
+  unsigned nSubbands = stokesAll->nSubbands();
+  unsigned nChannels = stokesAll->nChannels();
+  unsigned nPolarisations = stokesAll->nPolarisations();
+
+  // The spectrum is split into _nBands bands for the purpose of
+  // matching it to the model: find the minima of I in each band and
+  // compare with the minima of the model
+  float* dataMinusModel = scratch;
+  float* bandSigma = dataMinusModel + _nBands;
+
+  // Find the data minima in each band, and estimate sigma in each
+  // band. A band is reduced one contiguous subband slice at a time.
+  for (unsigned b = 0; b < _nBands; ++b) {
+    float miniData = 1e6f;
+    float bandMean = 0.0f;
+    float bandMeanSquare = 0.0f;
+    unsigned bin = _bandStart[b];
+    while (bin < _bandStart[b+1]) {
+      unsigned s = bin / nChannels;
+      unsigned c = bin % nChannels;
+      unsigned n = std::min(_bandStart[b+1] - bin, nChannels - c);
+      long index = stokesAll->index(s, nSubbands,
+                                    0, nPolarisations,
+                                    t, nChannels );
+      bandReduce(I + index + c, n, miniData, bandMean, bandMeanSquare);
+      bin += n;
+    }
+
+    // Now find the distance between data and model and the RMS
+    unsigned channelsPerBand = _bandStart[b+1] - _bandStart[b];
+    dataMinusModel[b] = miniData - _bandModelMin[b];
+    bandSigma[b] = sqrt(bandMeanSquare/channelsPerBand - std::pow(bandMean/channelsPerBand,2));
+  }
+  // Assume the minimum bandSigma to be the best estimate of this
+  // spectrum RMS
+  spectrumRMS = *std::min_element(bandSigma, bandSigma + _nBands);
+
+  // Take the median of dataMinusModel to determine the distance
+  // from the model
+  std::nth_element(dataMinusModel, dataMinusModel + _nBands/2, dataMinusModel + _nBands);
+  dataModel = dataMinusModel[_nBands/2];
+}
+
+/**
+ * @details
+ * Subtracts the bandpass and data model from spectrum @p t and normalises
+ * it, to zero mean if zero-DMing or by the running mean otherwise, and to
+ * unit RMS. Only depends on the spectrum and the model values recorded for
+ * it, so may be applied to all spectra of a chunk in parallel.
+ */
+void RFI_Clipper::_normalise( SpectrumDataSetStokes* stokesAll,
+                              const QVector<float>& bandPass, unsigned t,
+                              float dataModel, float meanRunAve ) const
+{
+  float* I = stokesAll->data();
+  unsigned nSubbands = stokesAll->nSubbands();
+  unsigned nChannels = stokesAll->nChannels();
+  unsigned nPolarisations = stokesAll->nPolarisations();
+  unsigned nBins = nChannels * nSubbands;
+
+  // reset the spectrumSum, and SumSq, and flatten subtract the
+  // bandpass from the data.
+  float spectrumSum = 0.0;
+  float spectrumSumSq = 0.0;
+  for (unsigned s = 0; s < nSubbands; ++s) {
+    long index = stokesAll->index(s, nSubbands,
+                                  0, nPolarisations,
+                                  t, nChannels );
+    for (unsigned c = 0; c < nChannels; ++c) {
+      int binLocal = s*nChannels +c;
+      // flat bandpass with near zero mean
+      I[index+c] -= (bandPass[binLocal] + dataModel); 
+      spectrumSum += I[index+c];
+      spectrumSumSq += I[index+c]*I[index+c];
+    }
+  }
+
+  // and normalize: bring to zero mean if zerodm is specified or
+  // use the running mean if not
+  spectrumSum /= nBins; // New meaning of these two variables
+  float spectrumRMS = sqrt(spectrumSumSq/nBins - std::pow(spectrumSum,2));
+
+  // Avoid nastiness in those first spectra by avoiding divisions
+  // by zero, or by the NaN from the rounding error of a flat spectrum
+  if (!(spectrumRMS > 0.0)) spectrumRMS = 1.0;
+
+  for (unsigned s = 0; s < nSubbands; ++s) {
+    long index = stokesAll->index(s, nSubbands,
+                                  0, nPolarisations,
+                                  t, nChannels );
+    for (unsigned c = 0; c < nChannels; ++c) {
+      if (_zeroDMing == 1)
+        {
+          I[index+c] -= _zeroDMing * spectrumSum;
+        }
+      else
+        {
+          I[index+c] -= meanRunAve;
+        }
+      // it may be better to normalize by the running average RMS,
+      // given this is a sensitive operation. For example, an
+      // artificially low rms may scale things up
+      I[index+c] /= spectrumRMS;
+      // make sure this division is not introducing signals that
+      // you would have clipped
+      if (I[index+c] > _crFactor) I[index+c] = 0.0; 
+    }
+  }
+}
+
+/**
+ * @details
+ * Clears the channel mask and its clip history for spectra of @p nBins
+ * channels.
+ */
+void RFI_Clipper::_resetChannelMask( unsigned nBins )
+{
+  _channelMask.assign(nBins, 0);
+  _maskedChannels.clear();
+  std::fill(_maskedInBand.begin(), _maskedInBand.end(), 0u);
+  _maskClips.assign(nBins, 0);
+  _maskTested.assign(nBins, 0);
+  _maskHistoryClips.assign(_maskHistory * nBins, 0);
+  _maskHistoryTested.assign(_maskHistory * nBins, 0);
+  _maskRates.resize(nBins);
+  _maskChunk = 0;
+}
+
+/**
+ * @details
+ * Adds the clip counts of the chunk to the sliding window of the last
+ * _maskHistory chunks and remasks the channels. A channel's clip rate is
+ * the fraction of the spectra it was tested in that it was clipped;
+ * masked channels are not tested, so drop out of the window and are
+ * tested again once their history has expired. A channel is masked when
+ * its rate is above both _maskMinFraction and the median rate by more
+ * than _maskThreshold times the (normalised) median absolute deviation.
+ */
+void RFI_Clipper::_updateChannelMask( unsigned nSamples )
+{
+  unsigned nBins = _channelMask.size();
+  const RFI_Statistics& stats = _stats;
+  const unsigned* clipCounts = &stats.clipCounts()[0];
+  unsigned* oldClips = &_maskHistoryClips[_maskChunk * nBins];
+  unsigned* oldTested = &_maskHistoryTested[_maskChunk * nBins];
+
+  // replace the oldest chunk of the window with this one
+  unsigned nRates = 0;
+  for (unsigned i = 0; i < nBins; ++i) {
+    unsigned tested = _channelMask[i] ? 0 : nSamples;
+    _maskClips[i] += clipCounts[i] - oldClips[i];
+    _maskTested[i] += tested - oldTested[i];
+    oldClips[i] = clipCounts[i];
+    oldTested[i] = tested;
+    if (_maskTested[i] != 0)
+      _maskRates[nRates++] = (float)_maskClips[i] / _maskTested[i];
+  }
+  _maskChunk = (_maskChunk + 1) % _maskHistory;
+
+  // robust statistics of the clip rates
+  float threshold = _maskMinFraction;
+  if (nRates != 0) {
+    float* rates = &_maskRates[0];
+    std::nth_element(rates, rates + nRates/2, rates + nRates);
+    float median = rates[nRates/2];
+    for (unsigned i = 0; i < nRates; ++i)
+      rates[i] = std::abs(rates[i] - median);
+    std::nth_element(rates, rates + nRates/2, rates + nRates);
+    float mad = 1.4826f * rates[nRates/2];
+    threshold = std::max(threshold, median + _maskThreshold * mad);
+  }
+
+  // remask
+  _maskedChannels.clear();
+  std::fill(_maskedInBand.begin(), _maskedInBand.end(), 0u);
+  unsigned b = 0;
+  for (unsigned i = 0; i < nBins; ++i) {
+    while (i >= _bandStart[b+1]) ++b;
+    _channelMask[i] = _maskTested[i] != 0 &&
+                      (float)_maskClips[i] / _maskTested[i] > threshold;
+    if (_channelMask[i]) {
+      _maskedChannels.push_back(i);
+      ++_maskedInBand[b];
+    }
+  }
+}
+
 // RFI clipper to be used with Stokes-I out of Stokes Generator
 //void RFI_Clipper::run(SpectrumDataSetStokes* stokesAll)
 void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
 {
   if( _active ) {
-    float blobRMS = 0.0f;
-    float blobSum = 0.0f;
     SpectrumDataSetStokes* stokesAll =
       static_cast<SpectrumDataSetStokes*>(weightedStokes->dataSet());
     SpectrumDataSet<float>* weights = weightedStokes->weights();
@@ -165,7 +473,6 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
     unsigned nChannels = stokesAll->nChannels();
     unsigned nPolarisations = stokesAll->nPolarisations();
     unsigned nBins = nChannels * nSubbands;
-    unsigned goodSamples = 0;
     float k = 4; // degrees of freedom
     float meanMinusMinimum = k / sqrt(2.0*k); 
     float spectrumRMS;
@@ -173,94 +480,96 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
 
     if (_lastGoodSpectrum.size() != nBins) 
       {
+	if (nBins < _nBands)
+	  throw(QString("RFI_Clipper: %1 channels cannot be split into %2 bands")
+		.arg(nBins).arg(_nBands));
 	_lastGoodSpectrum.resize(nBins,0.0);
 	_remainingZeros = nBins;
 	std::cout << "RFI_Clipper: resizing _lastGoodSpectrum" << std::endl;
+	// Equal bands, with any remainder going into the last one
+	for (unsigned b = 0; b < _nBands; ++b)
+	  _bandStart[b] = b * (nBins / _nBands);
+	_bandStart[_nBands] = nBins;
+	_resetChannelMask(nBins);
       }
     
     //float modelRMS = _bandPass.rms();
     // This has all been tested..
+    bool newBandPass = _swapBandPass();
     _map.reset( nBins );
     _map.setStart( _startFrequency );
     _map.setEnd( _endFrequency );
     _bandPass.reBin(_map);
+    if (newBandPass && !_rmsBuffer.empty()) {
+      // carry the running statistics over to the new model
+      _bandPass.setMean(_meanRunAve);
+      _bandPass.setRMS(_rmsRunAve);
+    }
+    const QVector<float>& bandPass = _bandPass.currentSet();
+    // the model minima in each band are the same for all spectra
+    for (unsigned b = 0; b < _nBands; ++b) {
+      float minimum = 1e6f, sum = 0.0f, sumSq = 0.0f;
+      bandReduce(bandPass.constData() + _bandStart[b],
+                 _bandStart[b+1] - _bandStart[b], minimum, sum, sumSq);
+      _bandModelMin[b] = minimum;
+    }
+    unsigned halfBands = (_nBands + 1) / 2;
+    int nSpectra = nSamples;
+
+    _dataModel.resize(nSamples);
+    _meanRunAves.resize(nSamples);
+
+    _stats.reset(nSamples, nBins);
+    _stats.setTimestamp(stokesAll->getLofarTimestamp());
+    unsigned* clipCounts = _stats.clipCounts();
+
     // -------------------------------------------------------------
-    // Processing next chunk 
-    for (unsigned t = 0; t < nSamples; ++t) {
-      //      std::cout << "Next spectrum " << _num << std::endl;
+    // Pass 1: band statistics of each spectrum, needed while the
+    // running averages are being trained (if they are reset part way
+    // through the chunk, the remaining statistics are computed in
+    // pass 2).
+    bool haveBandStats = !_rmsBuffer.full();
+    if (haveBandStats) {
+      _bandRMS.resize(nSamples);
+      _bandModel.resize(nSamples);
+      #pragma omp parallel for num_threads(_nThreads) schedule(static)
+      for (int t = 0; t < nSpectra; ++t) {
+        float* scratch = &_bandScratch[omp_get_thread_num() * _bandScratchSize];
+        _bandStatistics(stokesAll, bandPass, t, scratch,
+                        _bandRMS[t], _bandModel[t]);
+      }
+    }
 
-      const QVector<float>& bandPass = _bandPass.currentSet();
+    // -------------------------------------------------------------
+    // Pass 2: clip channels and spectra against the running averages,
+    // which are updated in order.
+    for (unsigned t = 0; t < nSamples; ++t) {
       float spectrumSum = 0.0;
       float spectrumSumSq = 0.0;
-      // Split the spectrum into 8 bands for the purpose of matching
-      // the spectrum to the model
-      std::vector<float> goodChannels(8,0.0);
-      unsigned channelsPerBand = nBins / 8;
-      // find the minima of I in each band, and the minima of the
-      // model and compare
-      std::vector<float> miniData(8,1e6);
-      std::vector<float> miniModel(8,1e6);
-      std::vector<float> dataMinusModel(8);
-      std::vector<float> bandSigma(8);
-      std::vector<float> bandMean(8,0.0);
-      std::vector<float> bandMeanSquare(8,0.0);
-
-      // Find the data minima and model minima in each band
-      // Let us also estimate sigma in each band
-      
+      float* goodChannels = &_goodChannels[0];
+      std::fill(goodChannels, goodChannels + _nBands, 0.0f);
+
       // Try this over an adapting stage, lasting as long as the running average buffers
       if (!_rmsBuffer.full()){
-	for (unsigned s = 0; s < nSubbands; ++s) {
-	  long index = stokesAll->index(s, nSubbands,
-					0, nPolarisations,
-					t, nChannels );
-	  for (unsigned c = 0; c < nChannels ; ++c) {
-	    int binLocal = s*nChannels +c; 
-	    unsigned band = (int)binLocal / channelsPerBand;
-	    
-	    //	  std::cout << "----------------" << std::endl; std::
-	    //	  cout << band << " " << binLocal << " " << I[index+c]
-	    //	  << std::endl;
-	    
-	    if (I[index+c] < miniData[band]) miniData[band] = I[index+c];
-	    if (bandPass[binLocal] < miniModel[band]) miniModel[band] = bandPass[binLocal];
-	    bandMean[band] += I[index+c];
-	    bandMeanSquare[band] += (I[index+c]*I[index+c]);
-	  }
+	if (haveBandStats) {
+	  spectrumRMS = _bandRMS[t];
+	  dataModel = _bandModel[t];
 	}
-	
-	// Now find the distances between data and model and the RMSs in
-	// each band
-	
-	for (unsigned b = 0; b < 8; ++b){
-	  dataMinusModel[b] = miniData[b] - miniModel[b];
-	  bandSigma[b] = sqrt(bandMeanSquare[b]/channelsPerBand - std::pow(bandMean[b]/channelsPerBand,2));
-	  //std::cout << bandSigma[b] << " " << bandMean[b] << " " <<
-	  //bandMeanSquare[b] << std::endl;
+	else {
+	  _bandStatistics(stokesAll, bandPass, t, &_bandScratch[0],
+	                  spectrumRMS, dataModel);
 	}
-	// Assume the minimum bandSigma to be the best estimate of this
-	// spectrum RMS
-	spectrumRMS = *std::min_element(bandSigma.begin(), bandSigma.end());
-
-	// Take the median of dataMinusModel to determine the distance
-	// from the model
-	std::nth_element(dataMinusModel.begin(), dataMinusModel.begin()+dataMinusModel.size()/2, dataMinusModel.end());
-	dataModel = (float)*(dataMinusModel.begin()+dataMinusModel.size()/2);
-	//      std::cout << "data minus model " << dataModel << " " <<
-	// std::endl; since we have used the minima to determine this
+	// since we have used the minima to determine this
 	// distance, we assume that dataModel is actually k/sqrt(k)
 	// sigma away from the real value, where k is the number of the
 	// degrees of freedom of the chi-squared distribution of the
 	// incoming data. For no integration, k will be 4 (2 powers per
 	// poln)
 	
-	//      std::cout << "dataModel " << dataModel << std::endl;
-	
 	// Let us now build up a running average of spectrumRMS values
 	// (_maxHistory of them)
 	
 	// if the buffer is not full, compute the new rmsRunAve like this
-	// if (!_rmsBuffer.full()) {
 	_rmsBuffer.push_back(spectrumRMS);
 	_rmsRunAve = std::accumulate(_rmsBuffer.begin(), _rmsBuffer.end(), 0.0)/_rmsBuffer.size();
 	
@@ -307,70 +616,80 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
       // channels
       float margin = _crFactor * _rmsRunAve;
       
-      // Now loop around all the channels: if you find a channel where
-      // (I - bandpass) - datamodel > margin, then replace it 
-      for (unsigned s = 0; s < nSubbands; ++s) {
-	long index = stokesAll->index(s, nSubbands,
-				      0, nPolarisations,
-				      t, nChannels );
-	for (unsigned c = 0; c < nChannels; ++c) {
-	  int binLocal = s*nChannels +c;
-	  if (I[index+c] - dataModel - bandPass[binLocal] > margin) {
-	    // clipping this channel to values from the last good
-	    // spectrum 
-	    /*std::cout << "clipping channel " << I[index+c]
-		      << " " << dataModel << " " <<  bandPass[binLocal] 
-		      << " " << margin << std::endl;*/
-	    //The following is for polarization
-	    for(unsigned int pol = 0; pol < nPolarisations; ++pol ) {
-	      long index = stokesAll->index(s, nSubbands,
-					    pol, nPolarisations, t, nChannels );
-	      I[index + c] = _lastGoodSpectrum[binLocal];
-	      W[index +c] = 1.0;
-	      //	      W[index +c] = 0.0;
+      // Channels masked as persistently bad are replaced by the last
+      // good spectrum without being tested
+      for (unsigned i = 0; i < _maskedChannels.size(); ++i) {
+	unsigned binLocal = _maskedChannels[i];
+	unsigned s = binLocal / nChannels;
+	unsigned c = binLocal % nChannels;
+	for(unsigned int pol = 0; pol < nPolarisations; ++pol ) {
+	  long index = stokesAll->index(s, nSubbands,
+					pol, nPolarisations, t, nChannels );
+	  I[index + c] = _lastGoodSpectrum[binLocal];
+	  W[index +c] = 1.0;
+	}
+      }
+
+      // Now loop around all the channels of each band: if you find a
+      // channel where (I - bandpass) - datamodel > margin, then replace it
+      for (unsigned b = 0; b < _nBands; ++b) {
+	unsigned bin = _bandStart[b];
+	while (bin < _bandStart[b+1]) {
+	  unsigned s = bin / nChannels;
+	  unsigned c0 = bin % nChannels;
+	  unsigned n = std::min(_bandStart[b+1] - bin, nChannels - c0);
+	  long index = stokesAll->index(s, nSubbands,
+					0, nPolarisations,
+					t, nChannels );
+	  for (unsigned c = c0; c < c0 + n; ++c) {
+	    int binLocal = s*nChannels +c;
+	    if (_channelMask[binLocal]) continue;
+	    // channels flagged upstream (zero weight) are clipped too
+	    if (W[index+c] == 0.0f ||
+		I[index+c] - dataModel - bandPass[binLocal] > margin) {
+	      // clipping this channel to values from the last good
+	      // spectrum 
+	      //The following is for polarization
+	      for(unsigned int pol = 0; pol < nPolarisations; ++pol ) {
+		long index = stokesAll->index(s, nSubbands,
+					      pol, nPolarisations, t, nChannels );
+		I[index + c] = _lastGoodSpectrum[binLocal];
+		W[index +c] = 1.0;
+	      }
+	      ++clipCounts[binLocal];
+	    }
+	    else{
+	      ++goodChannels[b];
+	      spectrumSum += I[index+c];
 	    }
 	  }
-	  else{
-	    unsigned band = (int)binLocal / channelsPerBand;
-	    ++goodChannels[band];
-	    spectrumSum += I[index+c];
-	  }
+	  bin += n;
 	}
       }
       // So now we have the mean of the incoming data, in a reliable
       // form after channel clipping
-      unsigned totalGoodChannels=std::accumulate(goodChannels.begin(), goodChannels.end(), 0);
-      _fractionBadChannels += (float)(nBins - totalGoodChannels)/nBins;
+      unsigned totalGoodChannels=std::accumulate(goodChannels, goodChannels + _nBands, 0);
+      _stats.addBadChannels(nBins - totalGoodChannels);
       spectrumSum /= totalGoodChannels;
 
       // Check if more than 20% of the channels in each band were
-      // bad. If so in more than half of the bands, 4 in this case,
+      // bad. If so in at least half of the bands (halfBands),
       // keep record. Also, if one band is completely gone, or less
-      // than 80% of the total survive, keep record.
+      // than 80% of the total survive, keep record. Masked channels
+      // are not counted.
       
 
       unsigned badBands = 0; 
-      for (unsigned b = 0; b < 8; ++b){
-	if (goodChannels[b] < 0.8 * channelsPerBand) {
+      for (unsigned b = 0; b < _nBands; ++b){
+	unsigned bandChannels = _bandStart[b+1] - _bandStart[b] - _maskedInBand[b];
+	if (goodChannels[b] < 0.8 * bandChannels) {
 	  ++badBands;
 	}
-	if (goodChannels[b] == 0) {
-	  badBands += 4;
+	if (goodChannels[b] == 0 && bandChannels != 0) {
+	  badBands += halfBands;
 	}
       }
-      if (totalGoodChannels < 0.8 * nBins) badBands +=4;
-
-      //      std::cout << "Current model, mean and rms: " <<
-      //      _bandPass.mean() << " " << _bandPass.rms() << std::endl;
-      //      std::cout << "Current data, mean and rms: " <<
-      //      spectrumSum << " " << spectrumRMS << std::endl;
-      //      std::cout << "new dataModel: " << dataModel <<
-      //      std::endl;
-
-      //      std::cout << "good channels " << goodChannels <<
-      //      std::endl;
-      
-
+      if (totalGoodChannels < 0.8 * (nBins - _maskedChannels.size())) badBands += halfBands;
 
       // Let us now build up the running average of spectrumSum values
       // (_maxHistory of them) if the buffer is not full, compute the
@@ -390,7 +709,6 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
 	// Note there is a tiny descrepance at the point when the
 	// buffer is first full
 
-	//	std::cout << "History buffer now full " << _num << std::endl;
 	_meanRunAve -= _meanBuffer.front()/_meanBuffer.size();
       	_meanRunAve += _meanBuffer.back()/_meanBuffer.size();
       	_meanBuffer.push_back(spectrumSum);
@@ -407,19 +725,20 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
       //Now check, if spectrumSum - model > tolerance, declare this
       //time sample useless, replace its data and take care of the
       //running averages, also cut the first 1000 spectra, also cut
-      //spectra where badBands >= 4, see above
+      //spectra where badBands >= halfBands, see above
 
       if (_meanBuffer.size() < 1000) {
 	// clip the sample, but continue to build the stats; this
 	// helps the stats converge
-	clipSample( stokesAll, W, t, _lastGoodSpectrum );
+	clipSample( stokesAll, W, t, &_lastGoodSpectrum[0] );
       }
-      else if (spectrumSum - _meanRunAve > spectrumRMStolerance || badBands >= 4) {
+      else if (spectrumSum - _meanRunAve > spectrumRMStolerance || badBands >= halfBands) {
 
 	// we need to remove this entire spectrum
-	clipSample( stokesAll, W, t, _lastGoodSpectrum );
+	clipSample( stokesAll, W, t, &_lastGoodSpectrum[0] );
 	// keep a record of bad spectra
 	++_badSpectra;
+	_stats.addBadSpectrum();
 
 	// now remove the last samples from the running average
 	// buffers and replace them with the last good values.
@@ -449,9 +768,6 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
 		if (_lastGoodSpectrum[binLocal] == 0.0 && I[index+c] != 0.0 ){
 		  _lastGoodSpectrum[binLocal] = I[index+c];
 		  --_remainingZeros;
-		  std::cout << "remaining channels to fill in good spectrum: " 
-			    << _remainingZeros << " " << _num  
-			    << " " << totalGoodChannels << std::endl;
 		  spectrumSum += _lastGoodSpectrum[binLocal];
 		  spectrumSumSq += _lastGoodSpectrum[binLocal] * 
 		    _lastGoodSpectrum[binLocal];
@@ -464,91 +780,28 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
 	  }
       }
       
-      
       // Now we have a valid spectrum, either the original or
-      // replaced; this spectrum is good, so let us do the final
-      // bits of post processing reset the spectrumSum, and SumSq,
-      // and flatten subtract the bandpass from the data.
-      // 
-      spectrumSum = 0.0;
-      spectrumSumSq = 0.0;
-      for (unsigned s = 0; s < nSubbands; ++s) {
-	long index = stokesAll->index(s, nSubbands,
-				      0, nPolarisations,
-				      t, nChannels );
-	for (unsigned c = 0; c < nChannels; ++c) {
-	  int binLocal = s*nChannels +c;
-	  //std::cout << "here1 " << bandPass[binLocal] << " " << dataModel << std::endl;
-	  // flat bandpass with near zero mean
-	  I[index+c] -= (bandPass[binLocal] + dataModel); 
-	  //std::cout << "here2" << std::endl;
-	  spectrumSum += I[index+c];
-	  //std::cout << "here3" << std::endl;
-	  spectrumSumSq += I[index+c]*I[index+c];
-	}
-      }
-
-      // and normalize: bring to zero mean if zerodm is specified or
-      // use the running mean if not
-      spectrumSum /= nBins; // New meaning of these two variables
-      spectrumRMS = sqrt(spectrumSumSq/nBins - std::pow(spectrumSum,2));
-      //std::cout << "Values used for normalization" << std::endl;
-      //std::cout << spectrumSum << " " << spectrumRMS << std::endl;
+      // replaced; this spectrum is good. Record the model and running
+      // mean it is flattened and normalised with in pass 3.
+      _dataModel[t] = dataModel;
+      _meanRunAves[t] = _meanRunAve;
 
-      // Avoid nastiness in those first spectra by avoiding divisions
-      // by zero
-      if (spectrumRMS == 0.0) spectrumRMS = 1.0;
-      
-      
-      for (unsigned s = 0; s < nSubbands; ++s) {
-	long index = stokesAll->index(s, nSubbands,
-				      0, nPolarisations,
-				      t, nChannels );
-	for (unsigned c = 0; c < nChannels; ++c) {
-	  if (_zeroDMing == 1)
-	    {
-	      I[index+c] -= _zeroDMing * spectrumSum;
-	    }
-	  else
-	    {
-	      I[index+c] -= _meanRunAve;
-	    }
-	  // it may be better to normalize by the running average RMS,
-	  // given this is a sensitive operation. For example, an
-	  // artificially low rms may scale things up
-	  I[index+c] /= spectrumRMS;
-	  //	  I[index+c] /= _rmsRunAve;
-	  // make sure this division is not introducing signals that
-	  // you would have clipped
-	  if (I[index+c] > _crFactor) I[index+c] = 0.0; 
-	}
-      }
-      // The bandpass is flat and the spectrum clean and normalized,
-      // so move to the next spectrum and write out some stats:
+      // write out some stats:
       unsigned reportStatsEvery = 10 * _maxHistory;
       if (_num == 0) {
 	// calculate fractions
 	float fractionBadSpectra = 100.0 * (float)_badSpectra / (float)reportStatsEvery; 
-	float fractionBadChannels = 100.0 * _fractionBadChannels / (float)reportStatsEvery ;
 
 	// if the fraction of bad spectra becomes >99%, then empty the
 	// circular buffers and go into learning mode again
 	if (fractionBadSpectra > 99.0) {
 	  _rmsBuffer.resize(0);
 	  _meanBuffer.resize(0);
-	  std::cout << "Lost track of the RFI model, retraining.";
+	  std::cout << "Lost track of the RFI model, retraining." << std::endl;
 	}
 	
-	std::cout << std::endl;
-	//	std::cout << "# Mean RMS %badSpectra %badChannels : "
-	//	<< std::endl;
-	std::cout <<  "RFIstats: " << _meanRunAve << " " << _rmsRunAve << " " 
-		  << fractionBadSpectra << " " << fractionBadChannels << std::endl;
-	std::cout << std::endl;
-	std::cout << nBins << std::endl;
 	// Reset _bad
 	_badSpectra = 0;
-	_fractionBadChannels = 0.0;
 
       }    
       // and update the model
@@ -558,9 +811,22 @@ void RFI_Clipper::run( WeightedSpectrumDataSet* weightedStokes )
       _num = _num % reportStatsEvery;
       
     }
+
+    // -------------------------------------------------------------
+    // Pass 3: the bandpass is flat and the spectra clean, so
+    // normalise them.
+    #pragma omp parallel for num_threads(_nThreads) schedule(static)
+    for (int t = 0; t < nSpectra; ++t) {
+      _normalise(stokesAll, bandPass, t, _dataModel[t], _meanRunAves[t]);
+    }
+
     // set the stats of the chunk
     weightedStokes->setRMS( _rmsRunAve );
     weightedStokes->setMean( _meanRunAve);
+    _stats.setRMS( _rmsRunAve );
+    _stats.setMean( _meanRunAve );
+
+    if (_maskHistory > 0) _updateChannelMask(nSamples);
   }
 }
 } // namespace ampp
@@ -0,0 +1,112 @@
+#include "RFI_Statistics.h"
+#include <QtCore/QIODevice>
+#include <QtCore/QString>
+#include <algorithm>
+
+namespace pelican {
+
+namespace ampp {
+
+
+/**
+ *@details RFI_Statistics
+ */
+RFI_Statistics::RFI_Statistics()
+   : BlobStatistics("RFI_Statistics"), _timestamp(0.0), _nSpectra(0),
+     _nBadSpectra(0), _nBadChannels(0)
+{
+}
+
+/**
+ *@details
+ */
+RFI_Statistics::~RFI_Statistics()
+{
+}
+
+/**
+ * @details
+ * Clears the counts, keeping the clip count histogram allocated if the
+ * number of channels does not change.
+ */
+void RFI_Statistics::reset( unsigned nSpectra, unsigned nChannels )
+{
+    _nSpectra = nSpectra;
+    _nBadSpectra = 0;
+    _nBadChannels = 0;
+    _clipCounts.resize(nChannels);
+    std::fill(_clipCounts.begin(), _clipCounts.end(), 0u);
+}
+
+float RFI_Statistics::percentBadSpectra() const
+{
+    if( _nSpectra == 0 ) return 0.0f;
+    return 100.0f * _nBadSpectra / _nSpectra;
+}
+
+float RFI_Statistics::percentBadChannels() const
+{
+    if( _nSpectra == 0 || _clipCounts.empty() ) return 0.0f;
+    return 100.0f * _nBadChannels / ((float)_nSpectra * _clipCounts.size());
+}
+
+/**
+ * @details
+ * Returns the number of serialised bytes in the data blob when using
+ * the serialise() method.
+ */
+quint64 RFI_Statistics::serialisedBytes() const
+{
+    quint64 size = 3 * sizeof(float);
+    size += sizeof(double);
+    size += 4 * sizeof(unsigned);
+    size += _clipCounts.size() * sizeof(unsigned);
+    return size;
+}
+
+/**
+ * @details
+ * Serialises the data blob.
+ */
+void RFI_Statistics::serialise(QIODevice& out) const
+{
+    float stats[3] = { mean(), rms(), median() };
+    unsigned counts[4] = { _nSpectra, _nBadSpectra, _nBadChannels,
+                           (unsigned)_clipCounts.size() };
+    out.write((const char*)stats, sizeof(stats));
+    out.write((const char*)&_timestamp, sizeof(double));
+    out.write((const char*)counts, sizeof(counts));
+    if( ! _clipCounts.empty() )
+        out.write((const char*)&_clipCounts[0],
+                  _clipCounts.size() * sizeof(unsigned));
+}
+
+/**
+ * @details
+ * Deserialises the data blob.
+ */
+void RFI_Statistics::deserialise(QIODevice& in, QSysInfo::Endian endian)
+{
+    if (endian != QSysInfo::ByteOrder) {
+        throw QString("RFI_Statistics::deserialise(): Endianness "
+                "of serial data not supported.");
+    }
+
+    float stats[3];
+    unsigned counts[4];
+    in.read((char*)stats, sizeof(stats));
+    in.read((char*)&_timestamp, sizeof(double));
+    in.read((char*)counts, sizeof(counts));
+    setMean(stats[0]);
+    setRMS(stats[1]);
+    setMedian(stats[2]);
+    _nSpectra = counts[0];
+    _nBadSpectra = counts[1];
+    _nBadChannels = counts[2];
+    _clipCounts.resize(counts[3]);
+    if( ! _clipCounts.empty() )
+        in.read((char*)&_clipCounts[0], _clipCounts.size() * sizeof(unsigned));
+}
+
+} // namespace ampp
+} // namespace pelican
@@ -0,0 +1,175 @@
+#include "SpectralKurtosisFlagger.h"
+#include "SpectrumDataSet.h"
+#include "WeightedSpectrumDataSet.h"
+
+#include "pelican/utility/ConfigNode.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <omp.h>
+
+namespace pelican {
+namespace ampp {
+
+
+///
+SpectralKurtosisFlagger::SpectralKurtosisFlagger(const ConfigNode& config)
+: AbstractModule(config), _flaggedFraction(0.0f)
+{
+    _window = config.getOption("window", "value", "0").toUInt();
+    _threshold = config.getOption("threshold", "sigma", "3.0").toFloat();
+    _nThreads = config.getOption("processingThreads", "value", "4").toUInt();
+
+    if (_threshold <= 0.0f)
+        throw QString("SpectralKurtosisFlagger: threshold must be positive.");
+
+    if (_nThreads == 0)
+        throw QString("SpectralKurtosisFlagger: processingThreads must be at least 1.");
+}
+
+
+///
+SpectralKurtosisFlagger::~SpectralKurtosisFlagger()
+{
+}
+
+
+/**
+ * @details
+ * Flags each window of spectra, distributing sub-bands over the threads.
+ */
+void SpectralKurtosisFlagger::run(const SpectrumDataSetC32* spectra,
+        WeightedSpectrumDataSet* weightedStokes)
+{
+    unsigned nSamples = spectra->nTimeBlocks();
+    unsigned nSubbands = spectra->nSubbands();
+    unsigned nChannels = spectra->nChannels();
+    const SpectrumDataSet<float>* weights = weightedStokes->weights();
+
+    if (weights->nTimeBlocks() != nSamples
+            || weights->nSubbands() != nSubbands
+            || weights->nChannels() != nChannels)
+        throw QString("SpectralKurtosisFlagger: Weights dimensions do not "
+                "match the spectra.");
+
+    unsigned window = _window == 0 ? nSamples : std::min(_window, nSamples);
+    _scratch.resize(_nThreads * 3 * nChannels);
+    _flaggedFraction = 0.0f;
+    if (window < 2)
+        return;
+
+    unsigned nWindows = 0;
+    for (unsigned t0 = 0; t0 + 2 <= nSamples; t0 += window)
+        ++nWindows;
+
+    unsigned nFlagged = 0;
+    #pragma omp parallel for num_threads(_nThreads) schedule(dynamic) \
+            reduction(+:nFlagged)
+    for (int s = 0; s < (int)nSubbands; ++s) {
+        float* scratch = &_scratch[omp_get_thread_num() * 3 * nChannels];
+        for (unsigned t0 = 0; t0 + 2 <= nSamples; t0 += window) {
+            unsigned m = std::min(window, nSamples - t0);
+            nFlagged += _flagWindow(spectra, weightedStokes, s, t0, m, scratch);
+        }
+    }
+
+    _flaggedFraction = float(nFlagged) / (float(nWindows) * nSubbands * nChannels);
+}
+
+
+/**
+ * @details
+ * Sums the powers and squared powers of @p n channels from @p c0 of
+ * sub-band @p s and polarisation @p p over spectra [t0, t0 + m) into
+ * @p s1 and @p s2. Called with n == BLOCK for all but the last block so that
+ * the inner loop has a fixed length and is vectorised.
+ */
+inline void SpectralKurtosisFlagger::_sumPowers(const SpectrumDataSetC32* spectra,
+        unsigned s, unsigned p, unsigned t0, unsigned m, unsigned c0,
+        unsigned n, float* s1, float* s2)
+{
+    float sum1[BLOCK], sum2[BLOCK];
+    std::fill(sum1, sum1 + BLOCK, 0.0f);
+    std::fill(sum2, sum2 + BLOCK, 0.0f);
+    for (unsigned t = t0; t < t0 + m; ++t) {
+        const float* x = reinterpret_cast<const float*>(
+                spectra->spectrumData(t, s, p) + c0);
+        #pragma omp simd
+        for (unsigned c = 0; c < n; ++c) {
+            float power = x[2 * c] * x[2 * c] + x[2 * c + 1] * x[2 * c + 1];
+            sum1[c] += power;
+            sum2[c] += power * power;
+        }
+    }
+    std::copy(sum1, sum1 + n, s1);
+    std::copy(sum2, sum2 + n, s2);
+}
+
+
+/**
+ * @details
+ * Forms the spectral kurtosis of each channel of sub-band @p s over
+ * spectra [t0, t0 + m) and zeros the weights and Stokes data of the
+ * channels outside the threshold. Returns the number of channels flagged.
+ */
+unsigned SpectralKurtosisFlagger::_flagWindow(const SpectrumDataSetC32* spectra,
+        WeightedSpectrumDataSet* weightedStokes, unsigned s, unsigned t0,
+        unsigned m, float* scratch) const
+{
+    unsigned nChannels = spectra->nChannels();
+    unsigned nPols = spectra->nPolarisations();
+    SpectrumDataSet<float>* weights = weightedStokes->weights();
+    SpectrumDataSet<float>* stokes = weightedStokes->dataSet();
+    unsigned nWeightPols = weights->nPolarisations();
+
+    float* s1 = scratch;
+    float* s2 = s1 + nChannels;
+    float* flag = s2 + nChannels;
+    std::fill(flag, flag + nChannels, 0.0f);
+
+    float M = float(m);
+    float scale = (M + 1.0f) / (M - 1.0f);
+    float sigma = std::sqrt(4.0f * M * M
+            / ((M - 1.0f) * (M + 2.0f) * (M + 3.0f)));
+    float lower = 1.0f - _threshold * sigma;
+    float upper = 1.0f + _threshold * sigma;
+
+    for (unsigned p = 0; p < nPols; ++p) {
+        // Sum a block of channels over the window at a time, so that the
+        // sums stay in registers rather than being reloaded every spectrum.
+        for (unsigned c0 = 0; c0 < nChannels; c0 += BLOCK) {
+            if (c0 + BLOCK <= nChannels)
+                _sumPowers(spectra, s, p, t0, m, c0, BLOCK, &s1[c0], &s2[c0]);
+            else
+                _sumPowers(spectra, s, p, t0, m, c0, nChannels - c0,
+                        &s1[c0], &s2[c0]);
+        }
+
+        // Channels with no power give NaN and are not flagged.
+        #pragma omp simd
+        for (unsigned c = 0; c < nChannels; ++c) {
+            float sk = scale * (M * s2[c] / (s1[c] * s1[c]) - 1.0f);
+            if (sk < lower || sk > upper)
+                flag[c] = 1.0f;
+        }
+    }
+
+    // Zero the data along with the weights: the dedispersion buffer replaces
+    // zero weight samples by adding noise, assuming they hold no signal.
+    unsigned nFlagged = 0;
+    for (unsigned c = 0; c < nChannels; ++c) {
+        if (flag[c] == 0.0f)
+            continue;
+        ++nFlagged;
+        for (unsigned t = t0; t < t0 + m; ++t)
+            for (unsigned p = 0; p < nWeightPols; ++p) {
+                weights->spectrumData(t, s, p)[c] = 0.0f;
+                stokes->spectrumData(t, s, p)[c] = 0.0f;
+            }
+    }
+    return nFlagged;
+}
+
+}// namespace ampp
+}// namespace pelican
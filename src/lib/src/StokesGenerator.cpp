@@ -17,12 +17,28 @@ namespace ampp {
 StokesGenerator::StokesGenerator(const ConfigNode& config)
 : AbstractModule(config)
 {
-  // Get the number of Stokes to produce, which can either be 1 or 4
-  _numberOfStokes = config.getOption("numberOfStokes", "value", "4").toUInt();
-  if (_numberOfStokes != 1 && _numberOfStokes != 4){
-    std::cout << "You can either generate 1 or 4 Stokes parameters. Change numberOfStokes in xml file." << std::endl;
-    exit (EXIT_FAILURE);
-  }
+    // Get the Stokes parameters to produce; numberOfStokes (1 or 4) is
+    // used if no explicit selection is given.
+    unsigned numberOfStokes = config.getOption("numberOfStokes", "value", "4").toUInt();
+    QString mode = config.getOption("stokes", "value",
+            numberOfStokes == 1 ? "I" : "IQUV").toUpper();
+    _nThreads = config.getOption("processingThreads", "value", "4").toUInt();
+
+    if (numberOfStokes != 1 && numberOfStokes != 4)
+        throw QString("StokesGenerator: You can either generate 1 or 4 Stokes "
+                "parameters. Change numberOfStokes in xml file.");
+
+    if (mode == "I")
+        _mode = STOKES_I;
+    else if (mode == "IQUV")
+        _mode = STOKES_IQUV;
+    else if (mode == "XXYY")
+        _mode = STOKES_XXYY;
+    else
+        throw QString("StokesGenerator: Unknown Stokes selection '%1'.").arg(mode);
+
+    if (_nThreads == 0)
+        throw QString("StokesGenerator: processingThreads must be at least 1.");
 }
 
 
@@ -34,135 +50,180 @@ StokesGenerator::~StokesGenerator()
 
 /**
  * @details
- *
+ * Generates the selected Stokes parameters of each spectrum.
  */
-
 void StokesGenerator::run(const SpectrumDataSetC32* channeliserOutput,
         SpectrumDataSetStokes* stokes)
 {
-  typedef std::complex<float> Complex;
-  unsigned nSamples = channeliserOutput->nTimeBlocks();
-  unsigned nSubbands = channeliserOutput->nSubbands();
-  unsigned nChannels = channeliserOutput->nChannels();
-  Q_ASSERT( channeliserOutput->nPolarisations() >= 2 );
-  
-  stokes->setLofarTimestamp(channeliserOutput->getLofarTimestamp());
-  stokes->setBlockRate(channeliserOutput->getBlockRate());
-  stokes->resize(nSamples, nSubbands, _numberOfStokes, nChannels);
-  
-  const Complex* dataPolDataBlock = channeliserOutput->data();
-
-  for (unsigned t = 0; t < nSamples; ++t) {
-#pragma omp parallel for num_threads(4)
-    for (unsigned s = 0; s < nSubbands; ++s) {
-      const Complex* dataPolX, *dataPolY;
-      float *I, *Q, *U, *V;
-      float powerX, powerY;
-      float XxYstarReal;
-      float XxYstarImag;
-      
-      unsigned dataPolIndexX = channeliserOutput->index( s, nSubbands, 
-                                                         0,2,
-                                                         t, nChannels);
-      unsigned dataPolIndexY = channeliserOutput->index( s, nSubbands, 
-                                                         1,2,
-                                                         t, nChannels);
-      //unsigned indexStokes = stokes->index( s, nSubbands,
-      //                                      0,2,
-      //                                      t, nChannels );
-      //dataPolX = channeliserOutput->spectrumData(t, s, 0);
-      //dataPolY = channeliserOutput->spectrumData(t, s, 1);
-      dataPolX = &dataPolDataBlock[dataPolIndexX];
-      dataPolY = &dataPolDataBlock[dataPolIndexY];
-      // TODO speed up
-      I = stokes->spectrumData(t, s, 0);
-      if (_numberOfStokes == 4){
-        Q = stokes->spectrumData(t, s, 1);
-        U = stokes->spectrumData(t, s, 2);
-        V = stokes->spectrumData(t, s, 3);
-      }
-      //std::cout << "nSamples=" << nSamples << " t=" << t << " s=" << s;
-      //std::cout << "  dataPolIndexX=" << dataPolIndexX;
-      //std::cout << "  dataPolIndexY=" << dataPolIndexY << std::endl;
-      // std::cout << I << " "<< Q <<" "<< U << " "<< V <<std::endl;
-      for (unsigned c = 0; c < nChannels; ++c) {
-        float Xr = dataPolX[c].real();
-        float Xi = dataPolX[c].imag();
-        float Yr = dataPolY[c].real();
-        float Yi = dataPolY[c].imag();
-        XxYstarReal = Xr*Yr + Xi*Yi;
-        XxYstarImag = Xi*Yr - Xr*Yi;
-        
-        powerX = _sqr(Xr) + _sqr(Xi);
-        powerY = _sqr(Yr) + _sqr(Yi);
-        
-        I[c] = powerX + powerY;
-        if (_numberOfStokes == 4){
-          Q[c] = powerX - powerY;
-          U[c] = 2.0f * XxYstarReal;
-          V[c] = 2.0f * XxYstarImag;
-        }
-      }
+    switch (_mode)
+    {
+        case STOKES_I:
+            generate<STOKES_I>(channeliserOutput, stokes, _nThreads);
+            break;
+        case STOKES_IQUV:
+            generate<STOKES_IQUV>(channeliserOutput, stokes, _nThreads);
+            break;
+        case STOKES_XXYY:
+            generate<STOKES_XXYY>(channeliserOutput, stokes, _nThreads);
+            break;
     }
-  }
 }
-  
-
 
 
 /**
  * @details
+ * Generates the selected Stokes parameters of each time sample, treating
+ * every sample as a single channel spectrum.
+ *
  * Not used?
  */
 void StokesGenerator::run(const TimeSeriesDataSetC32* streamData,
         SpectrumDataSetStokes* stokes)
 {
-    typedef std::complex<float> Complex;
+    switch (_mode)
+    {
+        case STOKES_I:
+            _generate<STOKES_I>(streamData, stokes, _nThreads);
+            break;
+        case STOKES_IQUV:
+            _generate<STOKES_IQUV>(streamData, stokes, _nThreads);
+            break;
+        case STOKES_XXYY:
+            _generate<STOKES_XXYY>(streamData, stokes, _nThreads);
+            break;
+    }
+}
+
+
+/**
+ * @details
+ * Forms the Stokes parameters of @p n channels of the X and Y spectra,
+ * writing parameter p to out[p]. The mode is a template parameter so each
+ * specialisation has a branch free channel loop the compiler can vectorise.
+ */
+template <StokesGenerator::Mode mode>
+inline void StokesGenerator::_formStokes(const Complex* X, const Complex* Y,
+        unsigned n, float* const out[4])
+{
+    const float* x = reinterpret_cast<const float*>(X);
+    const float* y = reinterpret_cast<const float*>(Y);
+    float* I = out[0];
+    float* Q = out[1];
+    float* U = out[2];
+    float* V = out[3];
+
+    for (unsigned c = 0; c < n; ++c)
+    {
+        float Xr = x[2 * c], Xi = x[2 * c + 1];
+        float Yr = y[2 * c], Yi = y[2 * c + 1];
+        float powerX = Xr * Xr + Xi * Xi;
+        float powerY = Yr * Yr + Yi * Yi;
+
+        if (mode == STOKES_XXYY)
+        {
+            I[c] = powerX;
+            Q[c] = powerY;
+            continue;
+        }
+
+        I[c] = powerX + powerY;
+        if (mode == STOKES_IQUV)
+        {
+            Q[c] = powerX - powerY;
+            U[c] = 2.0f * (Xr * Yr + Xi * Yi);
+            V[c] = 2.0f * (Xi * Yr - Xr * Yi);
+        }
+    }
+}
+
+
+/**
+ * @details
+ * Generates the Stokes parameters of the X and Y polarisations of all
+ * spectra in a single parallel region over (time block, sub-band) tiles.
+ */
+template <StokesGenerator::Mode mode>
+void StokesGenerator::generate(const SpectrumDataSetC32* spectra,
+        SpectrumDataSetStokes* stokes, unsigned nThreads)
+{
+    unsigned nSamples = spectra->nTimeBlocks();
+    unsigned nSubbands = spectra->nSubbands();
+    unsigned nChannels = spectra->nChannels();
+    unsigned nPols = spectra->nPolarisations();
+    unsigned nParams = nStokes(mode);
+    Q_ASSERT( nPols >= 2 );
+
+    stokes->setLofarTimestamp(spectra->getLofarTimestamp());
+    stokes->setBlockRate(spectra->getBlockRate());
+    stokes->resize(nSamples, nSubbands, nParams, nChannels);
+
+    const Complex* data = spectra->data();
+    float* out = stokes->data();
+    int nTiles = nSamples * nSubbands;
+
+    #pragma omp parallel for num_threads(nThreads) schedule(static)
+    for (int i = 0; i < nTiles; ++i)
+    {
+        unsigned t = i / nSubbands;
+        unsigned s = i % nSubbands;
+        const Complex* X = &data[spectra->index(s, nSubbands, 0, nPols, t, nChannels)];
+        const Complex* Y = &data[spectra->index(s, nSubbands, 1, nPols, t, nChannels)];
+        float* params[4] = { 0, 0, 0, 0 };
+        for (unsigned p = 0; p < nParams; ++p)
+            params[p] = &out[stokes->index(s, nSubbands, p, nParams, t, nChannels)];
+        _formStokes<mode>(X, Y, nChannels, params);
+    }
+}
+
+
+/**
+ * @details
+ * Generates the parameters of each sample of the X and Y time series of
+ * every sub-band, parallelised over (time block, sub-band) tiles.
+ */
+template <StokesGenerator::Mode mode>
+void StokesGenerator::_generate(const TimeSeriesDataSetC32* streamData,
+        SpectrumDataSetStokes* stokes, unsigned nThreads)
+{
     unsigned nSamples = streamData->nTimeBlocks();
     unsigned nSubbands = streamData->nSubbands();
     unsigned nSamps = streamData->nTimesPerBlock();
+    unsigned nParams = nStokes(mode);
 
     stokes->setLofarTimestamp(streamData->getLofarTimestamp());
     stokes->setBlockRate(streamData->getBlockRate());
-    stokes->resize(nSamples * nSamps, nSubbands, 4, 1);
-
-    const Complex* dataPolX, *dataPolY;
-    float XxYstarReal;
-    float XxYstarImag;
-    float *I, *Q, *U, *V;
-    float powerX, powerY;
-
-    for (unsigned t = 0; t < nSamples; ++t) {
-        for(unsigned s = 0; s < nSubbands; ++s) {
-            dataPolX = streamData->timeSeriesData(t, s, 0);
-            dataPolY = streamData->timeSeriesData(t, s, 1);
-            for(unsigned c = 0; c < nSamps; ++c) {
-                I = stokes->spectrumData(t * nSamps + c, s, 0);
-                Q = stokes->spectrumData(t * nSamps + c, s, 1);
-                U = stokes->spectrumData(t * nSamps + c, s, 2);
-                V = stokes->spectrumData(t * nSamps + c, s, 3);
-                // NOTE: We have one channel per subband since we are not channelising
-                float Xr = dataPolX[c].real();
-                float Xi = dataPolX[c].imag();
-                float Yr = dataPolY[c].real();
-                float Yi = dataPolY[c].imag();
-                XxYstarReal = Xr*Yr + Xi*Yi;
-                XxYstarImag = Xi*Yr - Xr*Yi;
-
-                powerX = _sqr(Xr) + _sqr(Xi);
-                powerY = _sqr(Yr) + _sqr(Yi);
-
-                I[c] = powerX + powerY;
-                Q[c] = powerX - powerY;
-                U[c] = 2.0f * XxYstarReal;
-                V[c] = 2.0f * XxYstarImag;
-
-            }
+    stokes->resize(nSamples * nSamps, nSubbands, nParams, 1);
+
+    float* out = stokes->data();
+    int nTiles = nSamples * nSubbands;
+
+    #pragma omp parallel for num_threads(nThreads) schedule(static)
+    for (int i = 0; i < nTiles; ++i)
+    {
+        unsigned t = i / nSubbands;
+        unsigned s = i % nSubbands;
+        // NOTE: We have one channel per subband since we are not channelising
+        const Complex* X = streamData->timeSeriesData(t, s, 0);
+        const Complex* Y = streamData->timeSeriesData(t, s, 1);
+        for (unsigned c = 0; c < nSamps; ++c)
+        {
+            float* params[4] = { 0, 0, 0, 0 };
+            for (unsigned p = 0; p < nParams; ++p)
+                params[p] = &out[stokes->index(s, nSubbands, p, nParams,
+                        t * nSamps + c, 1)];
+            _formStokes<mode>(&X[c], &Y[c], 1, params);
         }
     }
 }
 
 
+// Instantiate the kernels for each mode (used by EmbracePowerGenerator).
+template void StokesGenerator::generate<StokesGenerator::STOKES_I>(
+        const SpectrumDataSetC32*, SpectrumDataSetStokes*, unsigned);
+template void StokesGenerator::generate<StokesGenerator::STOKES_IQUV>(
+        const SpectrumDataSetC32*, SpectrumDataSetStokes*, unsigned);
+template void StokesGenerator::generate<StokesGenerator::STOKES_XXYY>(
+        const SpectrumDataSetC32*, SpectrumDataSetStokes*, unsigned);
+
 }// namespace ampp
 }// namespace pelican
-
@@ -4,8 +4,12 @@
 #include "pelican/utility/pelicanTimer.h"
 #include "pelican/utility/ConfigNode.h"
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <cstring>
+
+#include <omp.h>
 
 namespace pelican {
 namespace ampp {
@@ -13,12 +17,20 @@ namespace ampp {
 
 ///
 StokesIntegrator::StokesIntegrator(const ConfigNode& config)
-: AbstractModule(config)
+: AbstractModule(config), _nPartial(0), _partialTimestamp(0.0),
+  _nSubbands(0), _nPols(0)
 {
     // Get the size for the integration window(step) from the parameter file.
 
     _windowSize    = config.getOption("integrateTimeBins", "value", "1").toUInt();
     _binChannels    = config.getOption("integrateFrequencyChannels", "value", "1").toUInt();
+    _nThreads = config.getOption("processingThreads", "value", "4").toUInt();
+
+    if (_windowSize == 0 || _binChannels == 0)
+        throw QString("StokesIntegrator: Integration factors must be at least 1.");
+
+    if (_nThreads == 0)
+        throw QString("StokesIntegrator: processingThreads must be at least 1.");
 }
 
 
@@ -28,7 +40,17 @@ StokesIntegrator::~StokesIntegrator()
 }
 
 
-///
+/**
+ * @details
+ * Integrates the spectra into windows of _windowSize spectra, carrying the
+ * partial sum of an incomplete window over to the next call.
+ *
+ * (sub-band, polarisation) items are distributed over the threads. Each
+ * thread sums the spectra of a window, binned in frequency, into a
+ * scratch spectrum which stays in cache and is then written to the output
+ * once; the spectra of the trailing incomplete window are summed into the
+ * partial buffer of the item.
+ */
 void StokesIntegrator::run(const SpectrumDataSetStokes* stokesGeneratorOutput,
         SpectrumDataSetStokes* intStokes)
 {
@@ -36,92 +58,116 @@ void StokesIntegrator::run(const SpectrumDataSetStokes* stokesGeneratorOutput,
     unsigned nSubbands = stokesGeneratorOutput->nSubbands();
     unsigned nChannels = stokesGeneratorOutput->nChannels();
     unsigned nPols = stokesGeneratorOutput->nPolarisations();
-    //std::cout << "nSamples= " << nSamples << std::endl;
-    //std::cout << "nSubbands= " << nSubbands << std::endl;
-    //std::cout << "nChannels= " << nChannels << std::endl;
-    //std::cout << "nPols= " << nPols << std::endl;
-
-    //TIMER_ENABLE
+    unsigned newChannels = nChannels / _binChannels;
+    double blockRate = stokesGeneratorOutput->getBlockRate();
 
-    //    intStokes -> setLofarTimestamp(stokesGeneratorOutput -> getLofarTimestamp());
-    //    intStokes -> setBlockRate(stokesGeneratorOutput -> getBlockRate());
+    if (nChannels % _binChannels != 0)
+        throw QString("StokesIntegrator: Number of channels %1 is not a "
+                "multiple of integrateFrequencyChannels %2.").arg(nChannels)
+                .arg(_binChannels);
 
-    // Checking if the integration window is bigger than the available samples. In case
-    // // it is greater a warning is produced and the window size is reduced to the size
-    // // of the samples.
+    // A change of dimensions starts a new stream.
+    if (nSubbands != _nSubbands || nPols != _nPols
+            || _partial.size() != nSubbands * nPols * newChannels)
+        _resetPartial(nSubbands, nPols, newChannels);
 
-    if (_windowSize>nSamples){
-        std::cout << "Warning the window size has been reduced from" << _windowSize << "to the total sample count" << nSamples << std::endl;
-        _windowSize=nSamples;
-    }
-    //std::cout << "_windowSize= " << _windowSize << std::endl;
+    if (_nPartial == 0)
+        _partialTimestamp = stokesGeneratorOutput->getLofarTimestamp();
 
-    unsigned newSamples = nSamples/_windowSize;
-    unsigned newChannels = nChannels / _binChannels;
-    const float* value;
-    //    unsigned timeFloats = nPols*nSubbands*nChannels;
-
-    //    intStokes->resize(newSamples, nSubbands, nPols, nChannels);
+    // Number of windows completed by this chunk.
+    unsigned newSamples = (_nPartial + nSamples) / _windowSize;
+    size_t spectrumSize = newChannels * sizeof(float);
     intStokes->resize(newSamples, nSubbands, nPols, newChannels);
-
-    // Not sure what business this has here
-    float* value2;
-    value2 = intStokes->data();
-    for (unsigned i = 0; i < newSamples * nSubbands * nPols * newChannels; ++i)
-        value2[i] = 0.0;
-
-
-    //    unsigned bufferCounter;
-    //unsigned ts;
-    //TIMER_START;
-    /* Code before frequency integrator
-    for (unsigned u = 0; u < newSamples; ++u) {
-      for (unsigned t = timeStart; t < _windowSize+timeStart; ++t) {
-	for (unsigned s = 0; s < nSubbands; ++s) {
-	  for (unsigned p = 0; p < nPols; ++p) {
-                    value = stokesGeneratorOutput->spectrumData(t, s, p);
-                    float* timeBuffer = intStokes->spectrumData(u,s,p);
-                    for (unsigned c = 0; c < nChannels; ++c){
-                        timeBuffer[c]+= value[c];
-                        bufferCounter++;
-                    }
-                }
+    intStokes->setLofarTimestamp(_partialTimestamp);
+    intStokes->setBlockRate(blockRate * _windowSize);
+
+    unsigned nPartial = _nPartial;
+    int nItems = nSubbands * nPols;
+
+    #pragma omp parallel num_threads(_nThreads)
+    {
+        std::vector<float> window(newChannels);
+
+        #pragma omp for schedule(static)
+        for (int item = 0; item < nItems; ++item)
+        {
+            unsigned s = item / nPols;
+            unsigned p = item % nPols;
+            float* partial = &_partial[item * newChannels];
+
+            // Spectra already in the partial sum count towards the first
+            // window.
+            unsigned t = 0;
+            for (unsigned u = 0; u < newSamples; ++u)
+            {
+                if (u == 0 && nPartial > 0)
+                    memcpy(&window[0], partial, spectrumSize);
+                else
+                    std::fill(window.begin(), window.end(), 0.0f);
+
+                unsigned tEnd = (u + 1) * _windowSize - nPartial;
+                for (; t < tEnd; ++t)
+                    _accumulate(stokesGeneratorOutput->spectrumData(t, s, p),
+                            &window[0], newChannels);
+                memcpy(intStokes->spectrumData(u, s, p), &window[0], spectrumSize);
             }
+
+            // Sum the spectra of the incomplete window.
+            if (newSamples > 0)
+                std::fill(partial, partial + newChannels, 0.0f);
+            for (; t < nSamples; ++t)
+                _accumulate(stokesGeneratorOutput->spectrumData(t, s, p),
+                        partial, newChannels);
         }
-        timeStart=timeStart+_windowSize;
+    } // end of parallel region.
+
+    // Keep track of the incomplete window, which starts after the spectra
+    // used to complete windows in this chunk.
+    if (newSamples > 0)
+        _partialTimestamp = stokesGeneratorOutput->getLofarTimestamp()
+                + (newSamples * _windowSize - _nPartial) * blockRate;
+    _nPartial = (_nPartial + nSamples) % _windowSize;
+}
+
+
+/**
+ * @details
+ * Adds the spectrum @p in to @p out, summing _binChannels adjacent input
+ * channels into each output channel.
+ */
+void StokesIntegrator::_accumulate(const float* in, float* out,
+        unsigned nOutChannels)
+{
+    if (_binChannels == 1)
+    {
+        for (unsigned c = 0; c < nOutChannels; ++c)
+            out[c] += in[c];
+        return;
     }
-    */
-    unsigned timeStart=0;
-    unsigned channelStart=0;
-
-    for (unsigned u = 0; u < newSamples; ++u) {
-      for (unsigned t = timeStart; t < _windowSize+timeStart; ++t) {
-	for (unsigned s = 0; s < nSubbands; ++s) {
-	  for (unsigned p = 0; p < nPols; ++p) {
-	    value = stokesGeneratorOutput->spectrumData(t, s, p);
-	    float* timeBuffer = intStokes->spectrumData(u,s,p);
-	    channelStart = 0;
-	    for (unsigned nc = 0; nc < newChannels; ++nc){
-	      for (unsigned c = channelStart; c < channelStart + _binChannels; ++c){
-		timeBuffer[nc]+= value[c];
-	      }
-	      channelStart += _binChannels;
-	    }
-	  }
-	}
-      }
-      timeStart=timeStart+_windowSize;
+
+    for (unsigned nc = 0, c = 0; nc < nOutChannels; ++nc)
+    {
+        float sum = 0.0f;
+        for (unsigned k = 0; k < _binChannels; ++k, ++c)
+            sum += in[c];
+        out[nc] += sum;
     }
+}
 
-    // Set the timestamp of the first time sample
-    intStokes->setLofarTimestamp(stokesGeneratorOutput->getLofarTimestamp());
-    intStokes->setBlockRate(stokesGeneratorOutput->getBlockRate() * _windowSize);
 
-    //std::cout << "timestamp in integrator:" << intStokes->getLofarTimestamp() << std::endl;
-    //TIMER_STOP(ts);
-    //std::cout << ts << std::endl;
+/**
+ * @details
+ * Discards any partial window and sizes the partial buffer for data of the
+ * specified dimensions.
+ */
+void StokesIntegrator::_resetPartial(unsigned nSubbands, unsigned nPols,
+        unsigned nOutChannels)
+{
+    _partial.assign(nSubbands * nPols * nOutChannels, 0.0f);
+    _nPartial = 0;
+    _nSubbands = nSubbands;
+    _nPols = nPols;
 }
 
 }// namespace ampp
 }// namespace pelican
-
@@ -34,6 +34,7 @@ class AdapterTimeSeriesDataSetTest : public CppUnit::TestFixture
         //CPPUNIT_TEST(test_checkDataVariablePacket);
         CPPUNIT_TEST(test_deserialise);
         CPPUNIT_TEST(test_deserialise_timing);
+        CPPUNIT_TEST(test_deserialise_partialBlock);
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -59,6 +60,10 @@ class AdapterTimeSeriesDataSetTest : public CppUnit::TestFixture
 
         void test_deserialise_timing();
 
+        /// Method to check deserialising a chunk which is not a whole number
+        /// of output blocks.
+        void test_deserialise_partialBlock();
+
     private:
         ConfigNode _configXml(const QString& fixedSizePackets,
                 unsigned dataBitSize, unsigned udpPacketsPerIteration,
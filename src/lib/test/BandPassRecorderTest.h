@@ -0,0 +1,70 @@
+#ifndef BANDPASSRECORDERTEST_H
+#define BANDPASSRECORDERTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+/**
+ * @file BandPassRecorderTest.h
+ */
+
+namespace pelican {
+
+class ConfigNode;
+
+namespace ampp {
+class SpectrumDataSetStokes;
+
+/**
+ * @class BandPassRecorderTest
+ *
+ * @brief
+ *   Unit test for the BandPassRecorder module
+ * @details
+ *
+ */
+
+class BandPassRecorderTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( BandPassRecorderTest );
+        CPPUNIT_TEST( test_fit );
+        CPPUNIT_TEST( test_refit );
+        CPPUNIT_TEST( test_rankDeficient );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_fit();
+        void test_refit();
+        void test_rankDeficient();
+
+    public:
+        BandPassRecorderTest(  );
+        ~BandPassRecorderTest();
+
+    private:
+        ConfigNode _config( unsigned requiredSamples, unsigned refitSamples,
+                            unsigned coefficients ) const;
+        // fill stokes with the polynomial params, plus outliers
+        void _fill( SpectrumDataSetStokes* stokes,
+                    const QVector<float>& params ) const;
+
+    private:
+        unsigned _nSubbands;
+        unsigned _nChannels;
+        float _start;
+        float _end;
+        float _channelOffset; // alternating offset of the mean of each channel
+        float _rms; // alternating offset of each spectrum
+        float _outlier; // added to the outlier channels
+        QVector<unsigned> _outliers;
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // BANDPASSRECORDERTEST_H
@@ -26,6 +26,7 @@ class BandPassTest : public CppUnit::TestFixture
         CPPUNIT_TEST_SUITE( BandPassTest );
         CPPUNIT_TEST( test_reBin );
         CPPUNIT_TEST( test_setMedian );
+        CPPUNIT_TEST( test_setMedianCached );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -35,6 +36,7 @@ class BandPassTest : public CppUnit::TestFixture
         // Test Methods
         void test_reBin();
         void test_setMedian();
+        void test_setMedianCached();
 
     public:
         BandPassTest(  );
@@ -0,0 +1,62 @@
+#ifndef DEDISPERSIONHOSTKERNELTEST_H
+#define DEDISPERSIONHOSTKERNELTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <vector>
+
+/**
+ * @file DedispersionHostKernelTest.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+
+/**
+ * @class DedispersionHostKernelTest
+ *  
+ * @brief
+ *    Unit tests for the host CPU dedispersion kernels
+ * @details
+ * 
+ */
+
+class DedispersionHostKernelTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( DedispersionHostKernelTest );
+        CPPUNIT_TEST( test_bruteForce );
+        CPPUNIT_TEST( test_subband );
+        CPPUNIT_TEST( test_fdmt );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_bruteForce();
+        void test_subband();
+        void test_fdmt();
+
+    public:
+        DedispersionHostKernelTest(  );
+        ~DedispersionHostKernelTest();
+
+    protected:
+        // straightforward brute force dedispersion to compare against
+        static void reference( std::vector<float>& out, const std::vector<float>& in,
+                               float startdm, float dmstep, unsigned tdms,
+                               unsigned nsamp, const std::vector<float>& dmShift,
+                               unsigned maxshift );
+
+    private:
+        unsigned _nChans;
+        unsigned _nsamp;
+        std::vector<float> _data;
+        std::vector<float> _dmShift;
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // DEDISPERSIONHOSTKERNELTEST_H 
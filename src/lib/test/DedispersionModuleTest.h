@@ -3,6 +3,9 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 #include <QString>
+#include <QMap>
+#include <QMutex>
+#include <vector>
 #include "pelican/utility/LockingCircularBuffer.hpp"
 #include "LockingPtrContainer.hpp"
 #include "DedispersionSpectra.h"
@@ -36,6 +39,7 @@ class DedispersionModuleTest : public CppUnit::TestFixture
         CPPUNIT_TEST( test_multipleBlobs );
         CPPUNIT_TEST( test_multipleBuffersPerBlob );
         CPPUNIT_TEST( test_multipleBlobsPerBufferUnaligned );
+        CPPUNIT_TEST( test_ringBuffer );
         //CPPUNIT_TEST( test_dataConsistency ); Overkill!
         CPPUNIT_TEST_SUITE_END();
 
@@ -49,12 +53,14 @@ class DedispersionModuleTest : public CppUnit::TestFixture
         void test_multipleBlobsPerBuffer();
         void test_multipleBlobsPerBufferUnaligned();
         void test_multipleBuffersPerBlob();
+        void test_ringBuffer();
         void test_dataConsistency();
 
         // utility methods
         void connected( DataBlob* dataOut );
         void connectFinished();
         void unlockCallback( const QList<DataBlob*>&  );
+        void collect( DataBlob* dataOut );
 
     public:
         DedispersionModuleTest(  );
@@ -63,11 +69,18 @@ class DedispersionModuleTest : public CppUnit::TestFixture
     protected:
         ConfigNode testConfig( unsigned nBufferSamples ) const;
 
+    private:
+        int _collectedSize();
+
     private:
         int _connectCount;
         DedispersionSpectra* _connectData;
         int _chainFinished;
         QList<DataBlob*> _unlocked;
+        // output of collect(), keyed by the first sample in the input stream
+        QList<SpectrumDataSetStokes*> _collectInput;
+        QMap<unsigned long, std::vector<float> > _collected;
+        QMutex _collectMutex;
 };
 
 } // namespace ampp
@@ -0,0 +1,48 @@
+#ifndef DEDISPERSIONRINGBUFFERTEST_H
+#define DEDISPERSIONRINGBUFFERTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file DedispersionRingBufferTest.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+
+/**
+ * @class DedispersionRingBufferTest
+ *  
+ * @brief
+ *  unit test for DedispersionRingBuffer
+ * @details
+ * 
+ */
+
+class DedispersionRingBufferTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( DedispersionRingBufferTest );
+        CPPUNIT_TEST( test_windows );
+        CPPUNIT_TEST( test_invertChannels );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_windows();
+        void test_invertChannels();
+
+    public:
+        DedispersionRingBufferTest(  );
+        ~DedispersionRingBufferTest();
+
+    private:
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // DEDISPERSIONRINGBUFFERTEST_H 
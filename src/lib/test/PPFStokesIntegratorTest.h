@@ -0,0 +1,61 @@
+#ifndef PPF_STOKES_INTEGRATOR_TEST_H_
+#define PPF_STOKES_INTEGRATOR_TEST_H_
+
+/**
+ * @file PPFStokesIntegratorTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <QtCore/QString>
+
+namespace pelican {
+namespace ampp {
+
+/**
+ * @class PPFStokesIntegratorTest
+ *
+ * @brief
+ * CppUnit testing for the fused PPF, Stokes and integration module.
+ */
+
+class PPFStokesIntegratorTest : public CppUnit::TestFixture
+{
+    public:
+        PPFStokesIntegratorTest() : CppUnit::TestFixture() {}
+        virtual ~PPFStokesIntegratorTest() {}
+
+    public:
+        /// Register test methods.
+        CPPUNIT_TEST_SUITE(PPFStokesIntegratorTest);
+        CPPUNIT_TEST(test_configuration);
+        CPPUNIT_TEST(test_run);
+        CPPUNIT_TEST(test_partialWindows);
+        CPPUNIT_TEST(test_stokesI);
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp() {}
+        void tearDown() {}
+
+        /// Test module configuration.
+        void test_configuration();
+
+        /// Test the output matches the separate modules.
+        void test_run();
+
+        /// Test windows are carried across chunks of any size.
+        void test_partialWindows();
+
+        /// Test total intensity only matches the separate modules.
+        void test_stokesI();
+
+    private:
+        QString _configXml(unsigned nChannels, unsigned nThreads,
+                unsigned nStokes, unsigned window, unsigned bin);
+};
+
+} // namespace ampp
+} // namespace pelican
+
+#endif // PPF_STOKES_INTEGRATOR_TEST_H_
@@ -32,9 +32,14 @@ class PPFChanneliserTest : public CppUnit::TestFixture
         CPPUNIT_TEST(test_channelProfile);
         CPPUNIT_TEST(test_makeSpectrum);
         CPPUNIT_TEST(test_configuration);
-        CPPUNIT_TEST(test_threadAssign);
+        CPPUNIT_TEST(test_threadCount);
+        CPPUNIT_TEST(test_residual);
+        CPPUNIT_TEST(test_shortChunk);
+        CPPUNIT_TEST(test_oversampled);
+        CPPUNIT_TEST(test_coefficientStore);
         CPPUNIT_TEST(test_updateBuffer);
         CPPUNIT_TEST(test_filter);
+        CPPUNIT_TEST(test_filterKernels);
         CPPUNIT_TEST(test_fft);
         CPPUNIT_TEST_SUITE_END();
 
@@ -44,8 +49,20 @@ class PPFChanneliserTest : public CppUnit::TestFixture
         /// Test module configuration.
         void test_configuration();
 
-        /// Test various thread assignment schemes.
-        void test_threadAssign();
+        /// Test the output is independent of the number of threads.
+        void test_threadCount();
+
+        /// Test chunks which are not a whole number of spectra.
+        void test_residual();
+
+        /// Test chunks shorter than one spectrum.
+        void test_shortChunk();
+
+        /// Test oversampled output against critically sampled output.
+        void test_oversampled();
+
+        /// Test mapping coefficients from the binary coefficient store.
+        void test_coefficientStore();
 
         /// Test updating the delay buffer.
         void test_updateBuffer();
@@ -53,6 +70,9 @@ class PPFChanneliserTest : public CppUnit::TestFixture
         /// Test the FIR filter stage.
         void test_filter();
 
+        /// Test the vector FIR kernels.
+        void test_filterKernels();
+
         /// Test the FFT stage.
         void test_fft();
 
@@ -68,7 +88,8 @@ class PPFChanneliserTest : public CppUnit::TestFixture
     private:
         /// Generate configuration XML.
         QString _configXml(unsigned nChannels, unsigned nThreads,
-                unsigned nTaps, const QString& windowType = "kaiser");
+                unsigned nTaps, const QString& windowType = "kaiser",
+                const QString& oversampling = "1");
 
     private:
         bool     _verbose;
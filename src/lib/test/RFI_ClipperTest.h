@@ -4,6 +4,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <QtCore/QList>
 #include <QtCore/QString>
+#include <QtCore/QVector>
 
 /**
  * @file RFI_ClipperTest.h
@@ -14,7 +15,7 @@ namespace pelican {
 
 namespace ampp {
     class SpectrumDataSetStokes;
-    class BandPass;
+    class RFI_Clipper;
 
 /**
  * @class RFI_ClipperTest
@@ -32,6 +33,9 @@ class RFI_ClipperTest : public CppUnit::TestFixture
         CPPUNIT_TEST( test_goodData );
         CPPUNIT_TEST( test_badChannel );
         CPPUNIT_TEST( test_badSubband );
+        CPPUNIT_TEST( test_threads );
+        CPPUNIT_TEST( test_updateBandPass );
+        CPPUNIT_TEST( test_channelMask );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -42,6 +46,9 @@ class RFI_ClipperTest : public CppUnit::TestFixture
         void test_goodData();
         void test_badSubband();
         void test_badChannel();
+        void test_threads();
+        void test_updateBandPass();
+        void test_channelMask();
 
     public:
         RFI_ClipperTest(  );
@@ -64,9 +71,35 @@ class RFI_ClipperTest : public CppUnit::TestFixture
 
     private:
         void dump(const SpectrumDataSetStokes a);
-        void  _initSubbandData( SpectrumDataSetStokes& s, SpectrumDataSetStokes& shifted, const BandPass& bandpass, int numberOfSubbands, int numberOfChannels = 16 );
         QList<StokesIndex> _diff(const SpectrumDataSetStokes& a, const SpectrumDataSetStokes& b );
-        ConfigNode testConfig(const QString& = "t191_BAND.bp");
+        // clipper configuration for the bandpass file fileName, with the
+        // band taken from the file and any further options
+        ConfigNode _config( const QString& fileName,
+                            const QString& options = "" ) const;
+        // write a bandpass file over _nSubbands * _nChannels channels
+        // from _start with the polynomial params
+        void _writeBandPass( const QString& fileName, float rms,
+                             const QVector<float>& params ) const;
+        // fill stokes with level plus noise of the given rms
+        void _fill( SpectrumDataSetStokes& stokes, unsigned nBlocks,
+                    float level, float rms ) const;
+        // fill stokes with level +/- rms, alternating in channel and time
+        void _alternate( SpectrumDataSetStokes& stokes, unsigned nBlocks,
+                         float level, float rms ) const;
+        // run the warm-up of the running averages
+        void _train( RFI_Clipper& rfi ) const;
+        // spectrum t scaled to zero mean and unit rms
+        QVector<float> _standardised( const SpectrumDataSetStokes& stokes,
+                                      unsigned t ) const;
+        // true if the spectra agree to the precision of the normalisation
+        bool _same( const QVector<float>& a, const QVector<float>& b ) const;
+
+    private:
+        unsigned _nSubbands;
+        unsigned _nChannels;
+        double _start; // frequency of the first channel
+        double _width; // channel width
+        QString _fileName; // temporary bandpass file
 };
 
 } // namespace ampp
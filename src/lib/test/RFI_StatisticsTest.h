@@ -0,0 +1,44 @@
+#ifndef RFI_STATISTICSTEST_H
+#define RFI_STATISTICSTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file RFI_StatisticsTest.h
+ */
+
+namespace pelican {
+
+namespace ampp {
+
+/**
+ * @class RFI_StatisticsTest
+ *
+ * @brief
+ *   unit test for the RFI_Statistics data blob
+ * @details
+ *
+ */
+
+class RFI_StatisticsTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( RFI_StatisticsTest );
+        CPPUNIT_TEST( test_serialise_deserialise );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_serialise_deserialise();
+
+    public:
+        RFI_StatisticsTest(  );
+        ~RFI_StatisticsTest();
+};
+
+} // namespace ampp
+} // namespace pelican
+#endif // RFI_STATISTICSTEST_H
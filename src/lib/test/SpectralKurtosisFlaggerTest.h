@@ -0,0 +1,48 @@
+#ifndef SPECTRAL_KURTOSIS_FLAGGER_TEST_H_
+#define SPECTRAL_KURTOSIS_FLAGGER_TEST_H_
+
+/**
+ * @file SpectralKurtosisFlaggerTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <QtCore/QString>
+
+namespace pelican {
+namespace ampp {
+
+/**
+ * @class SpectralKurtosisFlaggerTest
+ *
+ * @brief
+ * CppUnit testing for the spectral kurtosis flagger module.
+ */
+
+class SpectralKurtosisFlaggerTest : public CppUnit::TestFixture
+{
+    public:
+        SpectralKurtosisFlaggerTest() : CppUnit::TestFixture() {}
+        virtual ~SpectralKurtosisFlaggerTest() {}
+
+    public:
+        /// Register test methods.
+        CPPUNIT_TEST_SUITE(SpectralKurtosisFlaggerTest);
+        CPPUNIT_TEST(test_flagCW);
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp() {}
+        void tearDown() {}
+
+        /// Test a continuous wave in Gaussian noise is flagged.
+        void test_flagCW();
+
+    private:
+        QString _configXml(unsigned window, float sigma, unsigned nThreads);
+};
+
+} // namespace ampp
+} // namespace pelican
+
+#endif // SPECTRAL_KURTOSIS_FLAGGER_TEST_H_
@@ -0,0 +1,62 @@
+#ifndef STOKES_GENERATOR_TEST_H_
+#define STOKES_GENERATOR_TEST_H_
+
+/**
+ * @file StokesGeneratorTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <QtCore/QString>
+
+namespace pelican {
+namespace ampp {
+
+class SpectrumDataSetC32;
+class SpectrumDataSetStokes;
+
+/**
+ * @class StokesGeneratorTest
+ *
+ * @brief
+ * CppUnit testing for the Stokes generator module.
+ */
+
+class StokesGeneratorTest : public CppUnit::TestFixture
+{
+    public:
+        StokesGeneratorTest() : CppUnit::TestFixture() {}
+        virtual ~StokesGeneratorTest() {}
+
+    public:
+        /// Register test methods.
+        CPPUNIT_TEST_SUITE(StokesGeneratorTest);
+        CPPUNIT_TEST(test_configuration);
+        CPPUNIT_TEST(test_modes);
+        CPPUNIT_TEST(test_embracePower);
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp() {}
+        void tearDown() {}
+
+        /// Test module configuration.
+        void test_configuration();
+
+        /// Test each mode against a scalar reference.
+        void test_modes();
+
+        /// Test EmbracePowerGenerator gives the XXYY powers.
+        void test_embracePower();
+
+    private:
+        QString _configXml(const QString& mode, unsigned nThreads);
+        void _fillSpectra(SpectrumDataSetC32* spectra);
+        void _checkStokes(const QString& mode, const SpectrumDataSetC32& spectra,
+                const SpectrumDataSetStokes& stokes);
+};
+
+} // namespace ampp
+} // namespace pelican
+
+#endif // STOKES_GENERATOR_TEST_H_
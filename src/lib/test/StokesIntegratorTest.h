@@ -0,0 +1,48 @@
+#ifndef STOKES_INTEGRATOR_TEST_H_
+#define STOKES_INTEGRATOR_TEST_H_
+
+/**
+ * @file StokesIntegratorTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <QtCore/QString>
+
+namespace pelican {
+namespace ampp {
+
+/**
+ * @class StokesIntegratorTest
+ *
+ * @brief
+ * CppUnit testing for the Stokes integrator module.
+ */
+
+class StokesIntegratorTest : public CppUnit::TestFixture
+{
+    public:
+        StokesIntegratorTest() : CppUnit::TestFixture() {}
+        virtual ~StokesIntegratorTest() {}
+
+    public:
+        /// Register test methods.
+        CPPUNIT_TEST_SUITE(StokesIntegratorTest);
+        CPPUNIT_TEST(test_partialWindows);
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp() {}
+        void tearDown() {}
+
+        /// Test windows spanning several chunks.
+        void test_partialWindows();
+
+    private:
+        QString _configXml(unsigned window, unsigned bin, unsigned nThreads);
+};
+
+} // namespace ampp
+} // namespace pelican
+
+#endif // STOKES_INTEGRATOR_TEST_H_
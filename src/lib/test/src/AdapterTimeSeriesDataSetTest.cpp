@@ -333,6 +333,76 @@ void AdapterTimeSeriesDataSetTest::test_deserialise_timing()
     }
 }
 
+/**
+ * @details
+ * Method to test deserialising a chunk whose samples are not a multiple of
+ * outputChannelsPerSubband, which is adapted into blocks of one packet.
+ */
+void AdapterTimeSeriesDataSetTest::test_deserialise_partialBlock()
+{
+    try {
+        // 5 packets of 16 samples, for spectra of 64 channels.
+        _fixedSizePackets = "false";
+        _udpPacketsPerIteration = 5;
+        _outputChannelsPerSubband = 64;
+        _subbandsPerPacket = 3;
+        _config = _configXml(_fixedSizePackets, _dataBitSize,
+                _udpPacketsPerIteration, _samplesPerPacket,
+                _outputChannelsPerSubband, _subbandsPerPacket, _nRawPolarisations);
+
+        typedef TYPES::i16complex i16c;
+
+        // Construct the adapter.
+        AdapterTimeSeriesDataSet adapter(_config);
+
+        // Construct a data blob to adapt into.
+        TimeSeriesDataSetC32 timeSeries;
+
+        unsigned nData = _subbandsPerPacket * _nRawPolarisations * _samplesPerPacket;
+        size_t packetSize = sizeof(UDPPacket::Header) + (nData * _dataBitSize * 2) / 8;
+        size_t chunkSize = packetSize * _udpPacketsPerIteration;
+        adapter.config(&timeSeries, chunkSize, QHash<QString, DataBlob*>());
+
+        // Fill the packets, in the order subband, time, polarisation, with
+        // the time of the sample and its subband and polarisation.
+        std::vector<char> chunk(chunkSize, 0);
+        for (unsigned i = 0; i < _udpPacketsPerIteration; ++i) {
+            UDPPacket::Header* header =
+                    reinterpret_cast<UDPPacket::Header*>(&chunk[i * packetSize]);
+            header->configuration = uint16_t(_dataBitSize);
+            header->timestamp = uint32_t(6);
+            header->blockSequenceNumber = uint32_t(7 + i * _samplesPerPacket);
+            i16c* data = reinterpret_cast<i16c*>(&chunk[i * packetSize
+                    + sizeof(UDPPacket::Header)]);
+            for (unsigned index = 0, c = 0; c < _subbandsPerPacket; ++c)
+                for (unsigned t = 0; t < _samplesPerPacket; ++t)
+                    for (unsigned p = 0; p < _nRawPolarisations; ++p)
+                        data[index++] = i16c(i * _samplesPerPacket + t,
+                                c * _nRawPolarisations + p);
+        }
+
+        QBuffer buffer;
+        buffer.setData(&chunk[0], chunkSize);
+        buffer.open(QBuffer::ReadOnly);
+        adapter.deserialise(&buffer);
+
+        CPPUNIT_ASSERT_EQUAL(_samplesPerPacket, timeSeries.nTimesPerBlock());
+        CPPUNIT_ASSERT_EQUAL(_udpPacketsPerIteration, timeSeries.nTimeBlocks());
+        for (unsigned b = 0; b < _udpPacketsPerIteration; ++b)
+            for (unsigned c = 0; c < _subbandsPerPacket; ++c)
+                for (unsigned p = 0; p < _nRawPolarisations; ++p)
+                    for (unsigned t = 0; t < _samplesPerPacket; ++t) {
+                        std::complex<float> z = timeSeries.timeSeriesData(b, c, p)[t];
+                        CPPUNIT_ASSERT_EQUAL(float(b * _samplesPerPacket + t), z.real());
+                        CPPUNIT_ASSERT_EQUAL(float(c * _nRawPolarisations + p), z.imag());
+                    }
+    }
+    catch (const QString& err) {
+        CPPUNIT_FAIL(err.toStdString().data());
+    }
+}
+
+
 
 
 
@@ -0,0 +1,175 @@
+#include "BandPassRecorderTest.h"
+#include "BandPassRecorder.h"
+#include "BandPass.h"
+#include "SpectrumDataSet.h"
+#include "pelican/utility/ConfigNode.h"
+#include <QtCore/QVector>
+
+
+namespace pelican {
+
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( BandPassRecorderTest );
+/**
+ *@details BandPassRecorderTest
+ */
+BandPassRecorderTest::BandPassRecorderTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ *@details
+ */
+BandPassRecorderTest::~BandPassRecorderTest()
+{
+}
+
+void BandPassRecorderTest::setUp()
+{
+    _nSubbands = 4;
+    _nChannels = 16;
+    _start = 10.0;
+    _end = 20.0;
+    _channelOffset = 0.001;
+    _rms = 2.0;
+    _outlier = 100.0;
+    _outliers.clear();
+    _outliers << 5 << 40;
+}
+
+void BandPassRecorderTest::tearDown()
+{
+}
+
+void BandPassRecorderTest::test_fit()
+{
+    // Use Case:
+    // Spectra drawn from a known polynomial with a few bright channels
+    // Expect:
+    // the polynomial and the rms of the spectra recovered, with the
+    // bright channels rejected from the fit
+    QVector<float> params;
+    params << 50.0 << -3.0 << 0.1;
+    BandPassRecorder recorder( _config( 100, 100, 3 ) );
+    SpectrumDataSetStokes stokes;
+    stokes.resize( 100, _nSubbands, 1, _nChannels );
+    _fill( &stokes, params );
+
+    BandPass bp;
+    CPPUNIT_ASSERT( recorder.run( &stokes, &bp ) );
+    CPPUNIT_ASSERT_EQUAL( params.size(), bp.params().size() );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( params[0], bp.params()[0], 0.05 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( params[1], bp.params()[1], 0.005 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( params[2], bp.params()[2], 0.0005 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( _rms, bp.rms(), 0.01 );
+}
+
+void BandPassRecorderTest::test_refit()
+{
+    // Use Case:
+    // Chunks of 30 spectra with a first fit after 200 spectra and
+    // refits every 100, without keeping history; the bandpass changes
+    // after the first fit
+    // Expect:
+    // run() to report a fit on the chunks that complete 200 spectra, then
+    // every 100, with the refit following the new bandpass
+    QVector<float> params;
+    params << 50.0 << -3.0 << 0.1;
+    QVector<float> newParams;
+    newParams << 20.0 << 1.0 << -0.02;
+    BandPassRecorder recorder( _config( 200, 100, 3 ) );
+    SpectrumDataSetStokes stokes;
+    stokes.resize( 30, _nSubbands, 1, _nChannels );
+
+    BandPass bp;
+    QVector<unsigned> fits;
+    for( unsigned chunk = 1; chunk <= 20; ++chunk ) {
+        _fill( &stokes, fits.size() ? newParams : params );
+        if( recorder.run( &stokes, &bp ) ) {
+            fits << chunk;
+            const QVector<float>& expected = fits.size() == 1 ? params : newParams;
+            CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[0], bp.params()[0], 0.05 );
+            CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[1], bp.params()[1], 0.005 );
+            CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[2], bp.params()[2], 0.0005 );
+        }
+    }
+    QVector<unsigned> expectedFits;
+    expectedFits << 7 << 11 << 15 << 19;
+    CPPUNIT_ASSERT( expectedFits == fits );
+}
+
+void BandPassRecorderTest::test_rankDeficient()
+{
+    // Use Case:
+    // More coefficients than channels to fit
+    // Expect:
+    // throw when the fit is due
+    _nSubbands = 1;
+    _nChannels = 2;
+    _outliers.clear();
+    QVector<float> params;
+    params << 50.0;
+    BandPassRecorder recorder( _config( 4, 4, 3 ) );
+    SpectrumDataSetStokes stokes;
+    stokes.resize( 2, _nSubbands, 1, _nChannels );
+    _fill( &stokes, params );
+
+    BandPass bp;
+    CPPUNIT_ASSERT( ! recorder.run( &stokes, &bp ) );
+    CPPUNIT_ASSERT_THROW( recorder.run( &stokes, &bp ), QString );
+}
+
+/**
+ * @details
+ * Each channel is the polynomial at the bin frequency, offset by
+ * +/- _channelOffset on alternate channels (a pattern the fit cannot
+ * follow) and by +/- _rms on alternate spectra, so over an even number of
+ * spectra the mean is the offset polynomial and the standard deviation
+ * _rms. _outlier is added to the channels in _outliers.
+ */
+void BandPassRecorderTest::_fill( SpectrumDataSetStokes* stokes,
+                                  const QVector<float>& params ) const
+{
+    unsigned nBins = _nSubbands * _nChannels;
+    float width = ( _end - _start ) / nBins;
+    for( unsigned t = 0; t < stokes->nTimeBlocks(); ++t ) {
+        for( unsigned s = 0; s < _nSubbands; ++s ) {
+            float* I = stokes->spectrumData( t, s, 0 );
+            for( unsigned c = 0; c < _nChannels; ++c ) {
+                unsigned bin = s * _nChannels + c;
+                double f = _start + bin * width;
+                double value = 0.0;
+                for( int p = params.size() - 1; p >= 0; --p ) {
+                    value = value * f + params[p];
+                }
+                value += ( bin % 2 ) ? _channelOffset : -_channelOffset;
+                value += ( t % 2 ) ? _rms : -_rms;
+                if( _outliers.contains( bin ) ) value += _outlier;
+                I[c] = value;
+            }
+        }
+    }
+}
+
+ConfigNode BandPassRecorderTest::_config( unsigned requiredSamples,
+                                          unsigned refitSamples,
+                                          unsigned coefficients ) const
+{
+    QString xml = "<BandPassRecorder>"
+                  "    <Band startFrequency=\"%1\" endFrequency=\"%2\" />"
+                  "    <requiredSamples value=\"%3\" />"
+                  "    <fitParmaters coefficients=\"%4\" />"
+                  "    <refit samples=\"%5\" />"
+                  "</BandPassRecorder>";
+    xml = xml.arg( _start );
+    xml = xml.arg( _end );
+    xml = xml.arg( requiredSamples );
+    xml = xml.arg( coefficients );
+    xml = xml.arg( refitSamples );
+    return ConfigNode( xml );
+}
+
+} // namespace ampp
+} // namespace pelican
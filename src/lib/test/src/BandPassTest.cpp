@@ -105,5 +105,39 @@ void BandPassTest::test_setMedian()
      }
 }
 
+void BandPassTest::test_setMedianCached()
+{
+     // setup the reference bandpass
+     BandPass bp;
+     BinMap map(7936);
+     float start=137.304688;
+     float width=-0.0007628;
+     map.setStart(start);
+     map.setBinWidth(width);
+     QVector<float> params;
+     params << 4460.84130843 << -24.8135957376 << 0.0125;
+     bp.setData(map, params);
+
+     BinMap map2(7936*2);
+     map2.setStart(start);
+     map2.setBinWidth(width/2.0);
+     bp.reBin(map2);
+
+     {  // Use Case:
+        // set the median on a rebinned map
+        // expect the cached primary map values to be shifted to match
+        // the new polynomial
+        bp.setMedian(bp.median() + 100.0);
+        bp.resetMap();
+        BandPass bp2;
+        bp2.setData(map, bp.params());
+        for( unsigned int i=0; i < map.numberBins(); i += 97 ) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL( bp2.intensityOfBin(i),
+                    bp.intensityOfBin(i), 0.01 );
+        }
+        CPPUNIT_ASSERT_DOUBLES_EQUAL( bp2.median() , bp.median() , 0.01 );
+     }
+}
+
 } // namespace ampp
 } // namespace pelican
@@ -0,0 +1,234 @@
+#include "DedispersionHostKernelTest.h"
+#include "DedispersionHostKernel.h"
+#include <QString>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace pelican {
+
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( DedispersionHostKernelTest );
+/**
+ *@details DedispersionHostKernelTest 
+ */
+DedispersionHostKernelTest::DedispersionHostKernelTest()
+    : CppUnit::TestFixture(), _nChans(64), _nsamp(4096)
+{
+}
+
+/**
+ *@details
+ */
+DedispersionHostKernelTest::~DedispersionHostKernelTest()
+{
+}
+
+void DedispersionHostKernelTest::setUp()
+{
+    // gaussian noise with a dispersed pulse, and the LOFAR
+    // delays (in seconds per unit DM) of the channels
+    boost::mt19937 eng(7);
+    boost::normal_distribution<float> dist(0.0f, 1.0f);
+    boost::variate_generator<boost::mt19937&,
+            boost::normal_distribution<float> > gen(eng, dist);
+    double fch1 = 150.0, foff = -0.1;
+    _dmShift.resize(_nChans);
+    for( unsigned c = 0; c < _nChans; ++c ) {
+        double f = fch1 + foff * c;
+        _dmShift[c] = 4148.741601 * (1.0 / f / f - 1.0 / fch1 / fch1);
+    }
+    _data.resize(_nChans * _nsamp);
+    for( unsigned i = 0; i < _data.size(); ++i ) _data[i] = gen();
+    for( unsigned c = 0; c < _nChans; ++c ) {
+        _data[c * _nsamp + 1000 + (int)(_dmShift[c] * 20.0 / 0.001)] += 10.0f;
+    }
+}
+
+void DedispersionHostKernelTest::tearDown()
+{
+}
+
+void DedispersionHostKernelTest::reference( std::vector<float>& out,
+        const std::vector<float>& in, float startdm, float dmstep, unsigned tdms,
+        unsigned nsamp, const std::vector<float>& dmShift, unsigned maxshift )
+{
+    unsigned nOut = nsamp - maxshift;
+    out.assign(tdms * nOut, 0.0f);
+    for( unsigned dm = 0; dm < tdms; ++dm ) {
+        float shiftTemp = fmaf( (float)dm, dmstep, startdm );
+        for( unsigned t = 0; t < nOut; ++t ) {
+            float sum = 0.0f;
+            for( unsigned c = 0; c < dmShift.size(); ++c ) {
+                sum += in[c * nsamp + t + (int)(dmShift[c] * shiftTemp)];
+            }
+            out[dm * nOut + t] = sum;
+        }
+    }
+}
+
+void DedispersionHostKernelTest::test_bruteForce()
+{
+    // Use Case:
+    // DM trials and samples that do not fill the last tile
+    // Expect:
+    // results identical to summing each trial in channel order
+    float tsamp = 0.001;
+    float dmstep = 0.5 / tsamp;
+    float startdm = 1.0 / tsamp;
+    unsigned tdms = 61;
+    unsigned maxshift = (unsigned)std::ceil( _dmShift[_nChans - 1]
+                        * (startdm + dmstep * (tdms - 1)) ) + 3;
+    unsigned nOut = _nsamp - maxshift;
+    std::vector<float> expected;
+    reference( expected, _data, startdm, dmstep, tdms, _nsamp, _dmShift, maxshift );
+
+    for( unsigned threads = 1; threads <= 4; threads += 3 ) {
+        std::vector<float> out( tdms * nOut, -1.0f );
+        hostDedisperseLoop( &out[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                            &_dmShift[0], maxshift, _nChans, threads );
+        for( unsigned i = 0; i < out.size(); ++i ) {
+            CPPUNIT_ASSERT_EQUAL( expected[i], out[i] );
+        }
+    }
+
+    // the pulse is recovered at DM 20
+    unsigned dmIndex = (unsigned)((20.0 / tsamp - startdm) / dmstep);
+    CPPUNIT_ASSERT( expected[dmIndex * nOut + 1000] > 5.0f * std::sqrt((float)_nChans) );
+}
+
+void DedispersionHostKernelTest::test_subband()
+{
+    // Use Case:
+    // subband dedispersion with one channel per group, with all the channels
+    // in one group, and with 8 groups for coarse trials (blocks of 2) and
+    // for fine trials (blocks of many)
+    // Expect:
+    // the first two to be identical to brute force, and the others to
+    // recover the pulse and to be within a sample per channel of brute
+    // force
+    float tsamp = 0.001;
+    float dmstep = 0.5 / tsamp;
+    float startdm = 1.0 / tsamp;
+    unsigned tdms = 61;
+    unsigned maxshift = (unsigned)std::ceil( _dmShift[_nChans - 1]
+                        * (startdm + dmstep * (tdms - 1)) ) + 3;
+    unsigned nOut = _nsamp - maxshift;
+    std::vector<float> expected( tdms * nOut );
+    hostDedisperseLoop( &expected[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                        &_dmShift[0], maxshift, _nChans, 1 );
+
+    std::vector<float> out( tdms * nOut );
+    for( unsigned subbands = 1; subbands <= _nChans; subbands *= _nChans ) {
+        hostSubbandDedisperse( &out[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                               &_dmShift[0], maxshift, _nChans, subbands, 4 );
+        for( unsigned i = 0; i < out.size(); ++i ) {
+            CPPUNIT_ASSERT_EQUAL( expected[i], out[i] );
+        }
+    }
+
+    hostSubbandDedisperse( &out[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                           &_dmShift[0], maxshift, _nChans, 8, 4 );
+    unsigned dmIndex = (unsigned)((20.0 / tsamp - startdm) / dmstep);
+    float peak = *std::max_element( &out[dmIndex * nOut + 999], &out[dmIndex * nOut + 1002] );
+    CPPUNIT_ASSERT( peak > 0.5 * expected[dmIndex * nOut + 1000] );
+
+    // finer trials around the pulse, so that the groups are summed once
+    // for blocks of neighbouring trials (the last one partial)
+    unsigned nSubbands = 8;
+    dmstep = 0.05 / tsamp;
+    startdm = 18.0 / tsamp;
+    float span = 0.0f;
+    for( unsigned s = 0; s < nSubbands; ++s ) {
+        unsigned first = s * _nChans / nSubbands;
+        unsigned last = ( s + 1 ) * _nChans / nSubbands - 1;
+        span = std::max( span, std::fabs( _dmShift[last] - _dmShift[first] ) );
+    }
+    unsigned block = std::min( tdms, (unsigned)( 2.0f / ( span * dmstep ) ) );
+    CPPUNIT_ASSERT( block > 1 && tdms % block != 0 );
+    maxshift = (unsigned)std::ceil( _dmShift[_nChans - 1]
+               * (startdm + dmstep * (tdms - 1)) ) + 3;
+    nOut = _nsamp - maxshift;
+    expected.resize( tdms * nOut );
+    out.resize( tdms * nOut );
+
+    // within a block the delay of each channel is out by at most a sample,
+    // so on a ramp each output is out by at most a step per channel
+    float slope = 0.001f;
+    std::vector<float> ramp( _nChans * _nsamp );
+    for( unsigned c = 0; c < _nChans; ++c ) {
+        for( unsigned t = 0; t < _nsamp; ++t ) {
+            ramp[c * _nsamp + t] = slope * t;
+        }
+    }
+    hostDedisperseLoop( &expected[0], &ramp[0], startdm, dmstep, tdms, _nsamp,
+                        &_dmShift[0], maxshift, _nChans, 1 );
+    hostSubbandDedisperse( &out[0], &ramp[0], startdm, dmstep, tdms, _nsamp,
+                           &_dmShift[0], maxshift, _nChans, nSubbands, 4 );
+    for( unsigned i = 0; i < out.size(); ++i ) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[i], out[i], 1.01 * slope * _nChans );
+    }
+
+    hostDedisperseLoop( &expected[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                        &_dmShift[0], maxshift, _nChans, 1 );
+    hostSubbandDedisperse( &out[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                           &_dmShift[0], maxshift, _nChans, nSubbands, 4 );
+    dmIndex = (unsigned)((20.0 / tsamp - startdm) / dmstep + 0.5);
+    peak = *std::max_element( &out[dmIndex * nOut + 999], &out[dmIndex * nOut + 1002] );
+    CPPUNIT_ASSERT( peak > 0.5 * expected[dmIndex * nOut + 1000] );
+}
+
+void DedispersionHostKernelTest::test_fdmt()
+{
+    // Use Case:
+    // FDMT of constant data, and of the pulse, with a number of channels
+    // that is not a power of two
+    // Expect:
+    // every output to be the number of channels, and the pulse
+    // recovered at the same trial and sample as the brute force
+    float tsamp = 0.001;
+    float dmstep = 0.5 / tsamp;
+    float startdm = 1.0 / tsamp;
+    unsigned tdms = 61;
+    unsigned nChans = _nChans - 3;
+    unsigned maxshift = (unsigned)std::ceil( _dmShift[nChans - 1]
+                        * (startdm + dmstep * (tdms - 1)) ) + 3;
+    unsigned nOut = _nsamp - maxshift;
+    std::vector<float> out( tdms * nOut );
+
+    std::vector<float> constant( nChans * _nsamp, 1.0f );
+    hostFdmtDedisperse( &out[0], &constant[0], startdm, dmstep, tdms, _nsamp,
+                        &_dmShift[0], maxshift, nChans, 4 );
+    for( unsigned i = 0; i < out.size(); ++i ) {
+        CPPUNIT_ASSERT_EQUAL( (float)nChans, out[i] );
+    }
+
+    std::vector<float> expected( tdms * nOut );
+    hostDedisperseLoop( &expected[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                        &_dmShift[0], maxshift, nChans, 1 );
+    hostFdmtDedisperse( &out[0], &_data[0], startdm, dmstep, tdms, _nsamp,
+                        &_dmShift[0], maxshift, nChans, 4 );
+    unsigned dmIndex = (unsigned)((20.0 / tsamp - startdm) / dmstep);
+    unsigned peak = std::max_element( out.begin(), out.end() ) - out.begin();
+    unsigned expectedPeak = std::max_element( expected.begin(), expected.end() ) - expected.begin();
+    CPPUNIT_ASSERT_EQUAL( dmIndex * nOut + 1000, expectedPeak );
+    CPPUNIT_ASSERT_EQUAL( expectedPeak / nOut, peak / nOut );
+    CPPUNIT_ASSERT_EQUAL( expectedPeak % nOut, peak % nOut );
+    // the rounding of the FDMT delays spreads a single sample pulse over
+    // the peak and one neighbour
+    float pulse = out[peak] + std::max( out[peak - 1], out[peak + 1] );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[expectedPeak], pulse, 0.15 * expected[expectedPeak] );
+    CPPUNIT_ASSERT( out[peak] > 10.0f * std::sqrt((float)nChans) );
+
+    // channel delays must increase
+    std::vector<float> reversed( _dmShift.rbegin(), _dmShift.rend() );
+    CPPUNIT_ASSERT_THROW( hostFdmtDedisperse( &out[0], &_data[0], startdm, dmstep,
+                          tdms, _nsamp, &reversed[0], maxshift, _nChans, 1 ), QString );
+}
+
+} // namespace ampp
+} // namespace pelican
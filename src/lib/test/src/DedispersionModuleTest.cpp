@@ -8,6 +8,7 @@
 #include <iostream>
 #include "pelican/utility/ConfigNode.h"
 #include <QDebug>
+#include <QMutexLocker>
 
 
 namespace pelican {
@@ -275,6 +276,82 @@ void DedispersionModuleTest::test_multipleBlobsPerBuffer ()
      stokesData.deleteData(spectrumData);
 }
 
+void DedispersionModuleTest::test_ringBuffer()
+{
+     // Use Case:
+     // The same stream of blobs, split unevenly across overlapping
+     // windows, dedispersed with and without the ring buffer
+     // Expect:
+     // identical dedispersion output for every window, and the blobs
+     // whose samples are all before the pending window unlocked
+     float dm = 10.0;
+     unsigned ddSamples = 200;
+     unsigned nBlocks = 12;
+     unsigned nSamples = 3200;
+     DedispersionDataGenerator stokesData;
+     stokesData.setTimeSamplesPerBlock( nSamples );
+     QList<SpectrumDataSetStokes*> spectrumData = stokesData.generate( nBlocks, dm );
+     QString configString = QString("<DedispersionModule>"
+            " <invertedData value=\"0\" />"
+            " <device type=\"cpu\" />"
+            " <timeBinsPerBufferPow2 value=\"13\" />"
+            " <frequencyChannel1 MHz=\"%1\"/>"
+            " <channelBandwidth MHz=\"%2\"/>"
+            " <dedispersionSamples value=\"%3\" />"
+            " <dedispersionStepSize value=\"0.1\" />"
+            " <numberOfBuffers value=\"3\" />"
+            " %4"
+            "</DedispersionModule>")
+        .arg( stokesData.startFrequency())
+        .arg( stokesData.bandwidthOfSample())
+        .arg( ddSamples );
+     QMap<unsigned long, std::vector<float> > output[2];
+     _collectInput = spectrumData;
+     try {
+         int expected = 0; // number of windows, from the ring
+         for( int ring = 1; ring >= 0; --ring ) {
+             ConfigNode config;
+             config.setFromString( configString.arg( ring ?
+                         "<ringBuffer value=\"true\" samples=\"8192\" />" : "" ) );
+             DedispersionModule ddm(config);
+             ddm.connect( boost::bind( &DedispersionModuleTest::collect, this, _1 ) );
+             _collected.clear();
+             for( int i = 0; i < spectrumData.size(); ++i ) {
+                 WeightedSpectrumDataSet weightedData(spectrumData[i]);
+                 ddm.dedisperse( &weightedData ); // asynchronous task
+             }
+             // buffered jobs are launched from another thread
+             while( _collectedSize() < expected ) { sleep(1); };
+             ddm.waitForJobCompletion();
+             output[ring] = _collected;
+             CPPUNIT_ASSERT( output[ring].size() >= 3 );
+             expected = output[ring].size();
+
+             // windows advance by a fixed number of samples, the next
+             // (incomplete) one starting after the last exported
+             QList<unsigned long> starts = output[ring].keys();
+             unsigned long advance = starts[1] - starts[0];
+             unsigned long pending = starts.last() + advance;
+             for( int i = 0; i < spectrumData.size(); ++i ) {
+                 if( (i + 1) * nSamples <= pending )
+                     CPPUNIT_ASSERT_EQUAL( 0, ddm.lockNumber( spectrumData[i] ) );
+             }
+             // the ring holds a blob from its arrival
+             if( ring )
+                 CPPUNIT_ASSERT_EQUAL( 1, ddm.lockNumber( spectrumData.last() ) );
+         }
+     }
+     catch( const QString& s )
+     {
+         CPPUNIT_FAIL(s.toStdString());
+     }
+     CPPUNIT_ASSERT( output[0].keys() == output[1].keys() );
+     foreach( unsigned long start, output[0].keys() ) {
+         CPPUNIT_ASSERT( output[0][start] == output[1][start] );
+     }
+     stokesData.deleteData(spectrumData);
+}
+
 void DedispersionModuleTest::unlockCallback( const QList<DataBlob*>& data ) {
      _unlocked=data;
 }
@@ -463,6 +540,20 @@ void DedispersionModuleTest::connectFinished() {
     ++_chainFinished;
 }
 
+void DedispersionModuleTest::collect( DataBlob* dataOut ) {
+    DedispersionSpectra* spectra = dynamic_cast<DedispersionSpectra*>(dataOut);
+    CPPUNIT_ASSERT( spectra );
+    unsigned long start = (unsigned long)_collectInput.indexOf( spectra->inputDataBlobs()[0] )
+                          * _collectInput[0]->nTimeBlocks() + spectra->firstSample();
+    QMutexLocker lock( &_collectMutex );
+    _collected[start] = spectra->data();
+}
+
+int DedispersionModuleTest::_collectedSize() {
+    QMutexLocker lock( &_collectMutex );
+    return _collected.size();
+}
+
 ConfigNode DedispersionModuleTest::testConfig(unsigned nSamples) const
 {
     ConfigNode node;
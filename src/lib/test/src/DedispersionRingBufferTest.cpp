@@ -0,0 +1,139 @@
+#include "DedispersionRingBufferTest.h"
+#include "DedispersionRingBuffer.h"
+#include "SpectrumDataSet.h"
+#include "WeightedSpectrumDataSet.h"
+#include <vector>
+
+
+namespace pelican {
+
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( DedispersionRingBufferTest );
+/**
+ *@details DedispersionRingBufferTest 
+ */
+DedispersionRingBufferTest::DedispersionRingBufferTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ *@details
+ */
+DedispersionRingBufferTest::~DedispersionRingBufferTest()
+{
+}
+
+void DedispersionRingBufferTest::setUp()
+{
+}
+
+void DedispersionRingBufferTest::tearDown()
+{
+}
+
+void DedispersionRingBufferTest::test_windows()
+{
+    // Use Case:
+    // A stream of short blobs, each sample set to its number in the
+    // stream (plus 1000 x the channel), fed through a ring that wraps
+    // Expect:
+    // each window to hold the consecutive samples it overlaps with
+    // the previous one, and the right blobs to be attached
+    unsigned windowSize = 8;
+    unsigned overlap = 3;
+    unsigned advance = windowSize - overlap;
+    unsigned nSamples = 4;
+    unsigned nChannels = 2;
+    const unsigned nBlobs = 6;
+    DedispersionRingBuffer ring( windowSize, overlap, 2, nChannels );
+    CPPUNIT_ASSERT_EQUAL( windowSize, ring.windowSize() );
+    std::vector<float> noise( windowSize * nChannels, 0.0 );
+
+    SpectrumDataSetStokes blobs[nBlobs];
+    unsigned window = 0;
+    for( unsigned b = 0; b < nBlobs; ++b ) {
+        blobs[b].resize( nSamples, 1, 1, nChannels );
+        for( unsigned t = 0; t < nSamples; ++t ) {
+            for( unsigned c = 0; c < nChannels; ++c ) {
+                blobs[b].spectrumData( t, 0, 0 )[c] = b * nSamples + t + 1000.0 * c;
+            }
+        }
+        WeightedSpectrumDataSet wdata( &blobs[b] );
+        unsigned sampleNumber = 0;
+        do {
+            if( 0 == ring.addSamples( &wdata, noise, &sampleNumber ) ) {
+                CPPUNIT_ASSERT_EQUAL( (unsigned long)window, ring.window() );
+                const float* data = ring.windowData();
+                for( unsigned c = 0; c < nChannels; ++c ) {
+                    for( unsigned i = 0; i < windowSize; ++i ) {
+                        CPPUNIT_ASSERT_EQUAL( (float)(window * advance + i + 1000.0 * c),
+                                              data[c * ring.rowStride() + i] );
+                    }
+                }
+                if( window == 0 ) {
+                    CPPUNIT_ASSERT_EQUAL( 2, ring.windowBlobs().size() );
+                    CPPUNIT_ASSERT_EQUAL( (unsigned)0, ring.windowFirstSample() );
+                }
+                if( window == 1 ) {
+                    CPPUNIT_ASSERT_EQUAL( 3, ring.windowBlobs().size() );
+                    CPPUNIT_ASSERT_EQUAL( &blobs[1], ring.windowBlobs()[0] );
+                    CPPUNIT_ASSERT_EQUAL( (unsigned)1, ring.windowFirstSample() );
+                }
+                QList<SpectrumDataSetStokes*> finished = ring.advance();
+                if( window == 0 ) {
+                    CPPUNIT_ASSERT_EQUAL( 1, finished.size() );
+                    CPPUNIT_ASSERT_EQUAL( &blobs[0], finished[0] );
+                }
+                ring.release( window++ );
+            }
+        }
+        while( sampleNumber != nSamples );
+    }
+    CPPUNIT_ASSERT_EQUAL( (unsigned)4, window );
+}
+
+void DedispersionRingBufferTest::test_invertChannels()
+{
+    // Use Case:
+    // Inverted channels, with channel and sample counts that are not
+    // multiples of the transpose blocks, and some samples flagged
+    // Expect:
+    // subbands and channels reversed, flagged samples replaced from
+    // the noise template
+    unsigned windowSize = 37;
+    unsigned nChannels = 19;
+    unsigned nSubbands = 2;
+    unsigned sampleSize = nChannels * nSubbands;
+    DedispersionRingBuffer ring( windowSize, 5, 2, sampleSize, true );
+    std::vector<float> noise( windowSize * sampleSize );
+    for( unsigned i = 0; i < noise.size(); ++i ) noise[i] = -1.0 - i;
+
+    SpectrumDataSetStokes blob;
+    blob.resize( windowSize, nSubbands, 1, nChannels );
+    for( unsigned t = 0; t < windowSize; ++t ) {
+        for( unsigned s = 0; s < nSubbands; ++s ) {
+            for( unsigned c = 0; c < nChannels; ++c ) {
+                blob.spectrumData( t, s, 0 )[c] = 1000.0 * ( s * nChannels + c ) + t;
+            }
+        }
+    }
+    WeightedSpectrumDataSet wdata( &blob );
+    wdata.weights()->spectrumData( 3, 1, 0 )[2] = 0.0;
+    unsigned sampleNumber = 0;
+    CPPUNIT_ASSERT_EQUAL( (unsigned)0, ring.addSamples( &wdata, noise, &sampleNumber ) );
+    const float* data = ring.windowData();
+    for( unsigned row = 0; row < sampleSize; ++row ) {
+        unsigned channel = sampleSize - 1 - row;
+        for( unsigned t = 0; t < windowSize; ++t ) {
+            float expected = 1000.0 * channel + t;
+            // subband 1 channel 2 is row 16
+            if( row == 16 && t == 3 ) expected += noise[row * windowSize + t];
+            CPPUNIT_ASSERT_EQUAL( expected, data[row * ring.rowStride() + t] );
+        }
+    }
+}
+
+} // namespace ampp
+} // namespace pelican
@@ -0,0 +1,350 @@
+#include "PPFStokesIntegratorTest.h"
+
+#include "PPFStokesIntegrator.h"
+#include "PPFChanneliser.h"
+#include "StokesGenerator.h"
+#include "StokesIntegrator.h"
+#include "SpectrumDataSet.h"
+#include "TimeSeriesDataSet.h"
+
+#include "pelican/utility/ConfigNode.h"
+
+#include <complex>
+#include <cmath>
+#include <vector>
+
+namespace pelican {
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PPFStokesIntegratorTest);
+
+
+/**
+ * @details
+ * Test module configuration.
+ */
+void PPFStokesIntegratorTest::test_configuration()
+{
+    try {
+        ConfigNode config(_configXml(16, 2, 4, 4, 2));
+        PPFStokesIntegrator module(config);
+        CPPUNIT_ASSERT_EQUAL(4u, module._numberOfStokes);
+        CPPUNIT_ASSERT_EQUAL(4u, module._windowSize);
+        CPPUNIT_ASSERT_EQUAL(2u, module._binChannels);
+        CPPUNIT_ASSERT_EQUAL(size_t(2), module._filteredDataY.size());
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+
+    // Invalid options.
+    {
+        ConfigNode config(_configXml(16, 1, 2, 1, 1));
+        CPPUNIT_ASSERT_THROW(PPFStokesIntegrator module(config), QString);
+    }
+    {
+        ConfigNode config(_configXml(16, 1, 1, 1, 3));
+        CPPUNIT_ASSERT_THROW(PPFStokesIntegrator module(config), QString);
+    }
+}
+
+
+/**
+ * @details
+ * Test the fused module gives the same result as the channeliser followed
+ * by Stokes generation and integration, over several chunks.
+ */
+void PPFStokesIntegratorTest::test_run()
+{
+    typedef std::complex<float> Complex;
+    unsigned nChannels = 16;
+    unsigned nSubbands = 3;
+    unsigned nPols     = 2;
+    unsigned nBlocks   = 20;
+    unsigned window    = 4;
+    unsigned bin       = 2;
+
+    TimeSeriesDataSetC32 data;
+    data.resize(nBlocks, nSubbands, nPols, nChannels);
+
+    try {
+        ConfigNode configPPF(_configXml(nChannels, 1, 4, 1, 1));
+        ConfigNode configFused(_configXml(nChannels, 2, 4, window, bin));
+        PPFChanneliser channeliser(configPPF);
+        PPFStokesIntegrator fused(configFused);
+        SpectrumDataSetC32 spectra;
+        SpectrumDataSetStokes stokes;
+
+        for (unsigned chunk = 0; chunk < 3; ++chunk)
+        {
+            Complex* timeData = data.data();
+            for (unsigned i = 0; i < data.size(); ++i)
+                timeData[i] = Complex(float((i + chunk) % 13) - 6.0f,
+                        float(i % 7) - 3.0f);
+
+            channeliser.run(&data, &spectra);
+            fused.run(&data, &stokes);
+
+            unsigned nOut = nChannels / bin;
+            CPPUNIT_ASSERT_EQUAL(nBlocks / window, stokes.nTimeBlocks());
+            CPPUNIT_ASSERT_EQUAL(nSubbands, stokes.nSubbands());
+            CPPUNIT_ASSERT_EQUAL(4u, stokes.nPolarisations());
+            CPPUNIT_ASSERT_EQUAL(nOut, stokes.nChannels());
+
+            for (unsigned u = 0; u < nBlocks / window; ++u)
+            {
+                for (unsigned s = 0; s < nSubbands; ++s)
+                {
+                    for (unsigned c = 0; c < nOut; ++c)
+                    {
+                        float expected[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                        for (unsigned t = u * window; t < (u + 1) * window; ++t)
+                        {
+                            const Complex* X = spectra.spectrumData(t, s, 0);
+                            const Complex* Y = spectra.spectrumData(t, s, 1);
+                            for (unsigned k = c * bin; k < (c + 1) * bin; ++k)
+                            {
+                                float powerX = std::norm(X[k]);
+                                float powerY = std::norm(Y[k]);
+                                expected[0] += powerX + powerY;
+                                expected[1] += powerX - powerY;
+                                expected[2] += 2.0f * (X[k].real() * Y[k].real()
+                                        + X[k].imag() * Y[k].imag());
+                                expected[3] += 2.0f * (X[k].imag() * Y[k].real()
+                                        - X[k].real() * Y[k].imag());
+                            }
+                        }
+                        for (unsigned p = 0; p < 4; ++p)
+                        {
+                            double tol = 1.0e-4 * (1.0 + std::fabs(expected[p]));
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[p],
+                                    stokes.spectrumData(u, s, p)[c], tol);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Test chunks whose length is not a multiple of integrateTimeBins *
+ * nChannels: the windows left incomplete by one chunk must be completed
+ * by the next, giving the same spectra and timestamps as one long stream.
+ */
+void PPFStokesIntegratorTest::test_partialWindows()
+{
+    typedef std::complex<float> Complex;
+    unsigned nChannels = 16;
+    unsigned nSubbands = 2;
+    unsigned nPols     = 2;
+    unsigned nTimes    = 12; // samples per block
+    unsigned window    = 3;
+    unsigned chunkBlocks[] = { 7, 5, 9, 3, 11 };
+    unsigned nChunks = sizeof(chunkBlocks) / sizeof(chunkBlocks[0]);
+    double sampleRate = 1.0e-3;
+    double start = 100.0;
+
+    try {
+        ConfigNode configPPF(_configXml(nChannels, 1, 4, 1, 1));
+        ConfigNode configFused(_configXml(nChannels, 2, 4, window, 1));
+        PPFChanneliser channeliser(configPPF);
+        PPFStokesIntegrator fused(configFused);
+        SpectrumDataSetC32 spectra;
+        SpectrumDataSetStokes stokes;
+
+        // Stokes parameters of every spectrum, [t][s][p][c].
+        std::vector<float> reference;
+        // Integrated output of the fused module, [u][s][p][c].
+        std::vector<float> output;
+        unsigned nWindows = 0;
+        unsigned sample = 0;
+        for (unsigned chunk = 0; chunk < nChunks; ++chunk)
+        {
+            TimeSeriesDataSetC32 data;
+            data.resize(chunkBlocks[chunk], nSubbands, nPols, nTimes);
+            data.setLofarTimestamp(start + sample * sampleRate);
+            data.setBlockRate(sampleRate);
+            Complex* timeData = data.data();
+            for (unsigned i = 0; i < data.size(); ++i)
+                timeData[i] = Complex(float((i + 3 * chunk) % 13) - 6.0f,
+                        float((i + chunk) % 7) - 3.0f);
+            sample += chunkBlocks[chunk] * nTimes;
+
+            channeliser.run(&data, &spectra);
+            for (unsigned t = 0; t < spectra.nTimeBlocks(); ++t)
+            {
+                for (unsigned s = 0; s < nSubbands; ++s)
+                {
+                    const Complex* X = spectra.spectrumData(t, s, 0);
+                    const Complex* Y = spectra.spectrumData(t, s, 1);
+                    float stokesParams[4][16];
+                    for (unsigned c = 0; c < nChannels; ++c)
+                    {
+                        float powerX = std::norm(X[c]);
+                        float powerY = std::norm(Y[c]);
+                        stokesParams[0][c] = powerX + powerY;
+                        stokesParams[1][c] = powerX - powerY;
+                        stokesParams[2][c] = 2.0f * (X[c].real() * Y[c].real()
+                                + X[c].imag() * Y[c].imag());
+                        stokesParams[3][c] = 2.0f * (X[c].imag() * Y[c].real()
+                                - X[c].real() * Y[c].imag());
+                    }
+                    for (unsigned p = 0; p < 4; ++p)
+                        reference.insert(reference.end(), stokesParams[p],
+                                stokesParams[p] + nChannels);
+                }
+            }
+
+            fused.run(&data, &stokes);
+            if (stokes.nTimeBlocks() > 0)
+            {
+                double expected = start + nWindows * window * nChannels * sampleRate;
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(expected,
+                        stokes.getLofarTimestamp(), 1.0e-9);
+            }
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(window * nChannels * sampleRate,
+                    stokes.getBlockRate(), 1.0e-12);
+            for (unsigned u = 0; u < stokes.nTimeBlocks(); ++u)
+                for (unsigned s = 0; s < nSubbands; ++s)
+                    for (unsigned p = 0; p < 4; ++p)
+                        output.insert(output.end(), stokes.spectrumData(u, s, p),
+                                stokes.spectrumData(u, s, p) + nChannels);
+            nWindows += stokes.nTimeBlocks();
+        }
+
+        // Every complete window of the stream is output once.
+        unsigned spectrumSize = nSubbands * 4 * nChannels;
+        unsigned nSpectra = reference.size() / spectrumSize;
+        CPPUNIT_ASSERT_EQUAL(sample / nChannels, nSpectra);
+        CPPUNIT_ASSERT_EQUAL(nSpectra / window, nWindows);
+        for (unsigned u = 0; u < nWindows; ++u)
+        {
+            for (unsigned i = 0; i < spectrumSize; ++i)
+            {
+                float expected = 0.0f;
+                for (unsigned t = u * window; t < (u + 1) * window; ++t)
+                    expected += reference[t * spectrumSize + i];
+                double tol = 1.0e-4 * (1.0 + std::fabs(expected));
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(expected,
+                        output[u * spectrumSize + i], tol);
+            }
+        }
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Test the fused module generating total intensity only gives the same
+ * result as the channeliser followed by the StokesGenerator and the
+ * StokesIntegrator, for chunks that leave windows incomplete.
+ */
+void PPFStokesIntegratorTest::test_stokesI()
+{
+    typedef std::complex<float> Complex;
+    unsigned nChannels = 16;
+    unsigned nSubbands = 3;
+    unsigned nPols     = 2;
+    unsigned window    = 4;
+    unsigned bin       = 2;
+    unsigned chunkBlocks[] = { 7, 5, 9, 11 };
+    unsigned nChunks = sizeof(chunkBlocks) / sizeof(chunkBlocks[0]);
+    double sampleRate = 1.0e-3;
+    double start = 100.0;
+
+    try {
+        ConfigNode configPPF(_configXml(nChannels, 1, 1, 1, 1));
+        ConfigNode configFused(_configXml(nChannels, 2, 1, window, bin));
+        ConfigNode configGenerator(
+                "<StokesGenerator>"
+                "	<numberOfStokes value=\"1\"/>"
+                "	<processingThreads value=\"2\"/>"
+                "</StokesGenerator>");
+        ConfigNode configIntegrator(
+                "<StokesIntegrator>"
+                "	<integrateTimeBins value=\"" + QString::number(window) + "\"/>"
+                "	<integrateFrequencyChannels value=\"" + QString::number(bin) + "\"/>"
+                "	<processingThreads value=\"2\"/>"
+                "</StokesIntegrator>");
+        PPFChanneliser channeliser(configPPF);
+        StokesGenerator generator(configGenerator);
+        StokesIntegrator integrator(configIntegrator);
+        PPFStokesIntegrator fused(configFused);
+        SpectrumDataSetC32 spectra;
+        SpectrumDataSetStokes stokes;
+        SpectrumDataSetStokes expected;
+        SpectrumDataSetStokes output;
+
+        unsigned sample = 0;
+        for (unsigned chunk = 0; chunk < nChunks; ++chunk)
+        {
+            TimeSeriesDataSetC32 data;
+            data.resize(chunkBlocks[chunk], nSubbands, nPols, nChannels);
+            data.setLofarTimestamp(start + sample * sampleRate);
+            data.setBlockRate(sampleRate);
+            Complex* timeData = data.data();
+            for (unsigned i = 0; i < data.size(); ++i)
+                timeData[i] = Complex(float((i + 5 * chunk) % 13) - 6.0f,
+                        float((i + chunk) % 7) - 3.0f);
+            sample += chunkBlocks[chunk] * nChannels;
+
+            channeliser.run(&data, &spectra);
+            generator.run(&spectra, &stokes);
+            integrator.run(&stokes, &expected);
+            fused.run(&data, &output);
+
+            CPPUNIT_ASSERT_EQUAL(1u, output.nPolarisations());
+            CPPUNIT_ASSERT_EQUAL(expected.nTimeBlocks(), output.nTimeBlocks());
+            CPPUNIT_ASSERT_EQUAL(expected.nSubbands(), output.nSubbands());
+            CPPUNIT_ASSERT_EQUAL(expected.nPolarisations(), output.nPolarisations());
+            CPPUNIT_ASSERT_EQUAL(nChannels / bin, output.nChannels());
+            if (output.nTimeBlocks() > 0)
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getLofarTimestamp(),
+                        output.getLofarTimestamp(), 1.0e-9);
+            for (unsigned u = 0; u < output.nTimeBlocks(); ++u)
+            {
+                for (unsigned s = 0; s < nSubbands; ++s)
+                {
+                    const float* I = expected.spectrumData(u, s, 0);
+                    for (unsigned c = 0; c < output.nChannels(); ++c)
+                    {
+                        double tol = 1.0e-4 * (1.0 + std::fabs(I[c]));
+                        CPPUNIT_ASSERT_DOUBLES_EQUAL(I[c],
+                                output.spectrumData(u, s, 0)[c], tol);
+                    }
+                }
+            }
+        }
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+QString PPFStokesIntegratorTest::_configXml(unsigned nChannels,
+        unsigned nThreads, unsigned nStokes, unsigned window, unsigned bin)
+{
+    QString xml =
+            "<PPFStokesIntegrator>"
+            "	<outputChannelsPerSubband value=\"" + QString::number(nChannels) + "\"/>"
+            "	<processingThreads value=\"" + QString::number(nThreads) + "\"/>"
+            "	<filter nTaps=\"8\" filterWindow=\"kaiser\"/>"
+            "	<numberOfStokes value=\"" + QString::number(nStokes) + "\"/>"
+            "	<integrateTimeBins value=\"" + QString::number(window) + "\"/>"
+            "	<integrateFrequencyChannels value=\"" + QString::number(bin) + "\"/>"
+            "</PPFStokesIntegrator>";
+    return xml;
+}
+
+} // namespace ampp
+} // namespace pelican
@@ -1,8 +1,10 @@
 #include "PPF_ChanneliserTest.h"
 
 #include "PPFChanneliser.h"
+#include "PPFFirKernel.h"
 #include "SpectrumDataSet.h"
 #include "TimeSeriesDataSet.h"
+#include "TestDir.h"
 #include "constants.h"
 
 #include "pelican/utility/ConfigNode.h"
@@ -268,6 +270,8 @@ void PPFChanneliserTest::test_configuration()
         PPFChanneliser channeliser(config);
         CPPUNIT_ASSERT_EQUAL(_nChannels, channeliser._nChannels);
         CPPUNIT_ASSERT_EQUAL(nThreads, channeliser._nThreads);
+        CPPUNIT_ASSERT_EQUAL(unsigned(FFTW_MEASURE), channeliser._fftwFlags);
+        CPPUNIT_ASSERT_EQUAL(size_t(nThreads), channeliser._fftPlans.size());
     }
     catch (QString const& err) {
         CPPUNIT_FAIL(err.toLatin1().data());
@@ -277,81 +281,333 @@ void PPFChanneliserTest::test_configuration()
 
 /**
  * @details
+ * Test that the output does not depend on the number of threads, including
+ * thread counts that do not divide the number of sub-bands, and that the
+ * delay lines are carried correctly between calls.
  */
-void PPFChanneliserTest::test_threadAssign()
+void PPFChanneliserTest::test_threadCount()
 {
-    unsigned nThreads = 2;
-    ConfigNode config(_configXml(_nChannels, nThreads, _nTaps));
-    PPFChanneliser channeliser(config);
+    typedef PPFChanneliser::Complex Complex;
+    unsigned nSubbands = 5;
+    unsigned nPols     = 2;
+    unsigned nBlocks   = 11;
+
+    TimeSeriesDataSetC32 data;
+    data.resize(nBlocks, nSubbands, nPols, _nChannels);
+
     try {
-        unsigned start     = 0;
-        unsigned end       = 0;
-        unsigned nSubbands = 62;
-        unsigned threadId  = 0;
-
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(31), end);
-
-        threadId = 1;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(31), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(62), end);
-
-        nSubbands = 1;
-        threadId  = 0;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(1), end);
-
-        threadId = 1;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), end);
-
-        nSubbands = 3;
-        threadId  = 0;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(2), end);
-
-        threadId = 1;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(2), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(3), end);
-
-        nSubbands = 4;
-        threadId  = 0;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(2), end);
-
-        threadId = 1;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(2), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(4), end);
-
-        nSubbands = 4;
-        nThreads  = 3;
-        threadId  = 0;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(0), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(2), end);
-
-        threadId = 1;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(2), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(3), end);
-
-        threadId = 2;
-        channeliser._assign_threads(start, end, nSubbands, nThreads, threadId);
-        CPPUNIT_ASSERT_EQUAL(unsigned(3), start);
-        CPPUNIT_ASSERT_EQUAL(unsigned(4), end);
+        ConfigNode config1(_configXml(_nChannels, 1, _nTaps));
+        ConfigNode config3(_configXml(_nChannels, 3, _nTaps));
+        PPFChanneliser channeliser1(config1);
+        PPFChanneliser channeliser3(config3);
+        SpectrumDataSetC32 spectra1, spectra3;
+
+        for (unsigned chunk = 0; chunk < 3; ++chunk)
+        {
+            Complex* timeData = data.data();
+            for (unsigned i = 0; i < data.size(); ++i)
+                timeData[i] = Complex(float((i + chunk) % 13), float(i % 7));
+
+            channeliser1.run(&data, &spectra1);
+            channeliser3.run(&data, &spectra3);
+
+            CPPUNIT_ASSERT_EQUAL(spectra1.size(), spectra3.size());
+            for (int i = 0; i < spectra1.size(); ++i)
+            {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(spectra1.data()[i].real(),
+                        spectra3.data()[i].real(), 1.0e-4);
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(spectra1.data()[i].imag(),
+                        spectra3.data()[i].imag(), 1.0e-4);
+            }
+        }
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Test that chunks which are not a whole number of spectra give the same
+ * spectra as a single chunk with the same stream of samples.
+ */
+void PPFChanneliserTest::test_residual()
+{
+    typedef PPFChanneliser::Complex Complex;
+    unsigned nSubbands = 3;
+    unsigned nPols     = 2;
+    unsigned nTimes    = 7;   // Samples per block of the chunked input.
+    unsigned nBlocks   = 5;
+    unsigned nChunks   = 3;
+    unsigned nSpectra  = (nChunks * nBlocks * nTimes) / _nChannels;
+
+    try {
+        ConfigNode config(_configXml(_nChannels, 2, _nTaps));
+        PPFChanneliser channeliser(config);
+        PPFChanneliser reference(config);
+
+        // Reference: a single chunk of whole spectra.
+        TimeSeriesDataSetC32 data;
+        data.resize(nSpectra, nSubbands, nPols, _nChannels);
+        for (unsigned s = 0; s < nSubbands; ++s)
+            for (unsigned p = 0; p < nPols; ++p)
+                for (unsigned b = 0; b < nSpectra; ++b)
+                    for (unsigned c = 0; c < _nChannels; ++c)
+                        data.timeSeriesData(b, s, p)[c] = Complex(
+                                float((b * _nChannels + c + s) % 11),
+                                float((b * _nChannels + c + p) % 5));
+        SpectrumDataSetC32 expected;
+        reference.run(&data, &expected);
+
+        // Same stream in chunks of 35 samples.
+        SpectrumDataSetC32 spectra;
+        unsigned iSpectrum = 0;
+        for (unsigned chunk = 0; chunk < nChunks; ++chunk)
+        {
+            TimeSeriesDataSetC32 chunkData;
+            chunkData.resize(nBlocks, nSubbands, nPols, nTimes);
+            chunkData.setBlockRate(1.0);
+            chunkData.setLofarTimestamp(double(chunk * nBlocks * nTimes));
+            for (unsigned s = 0; s < nSubbands; ++s)
+                for (unsigned p = 0; p < nPols; ++p)
+                    for (unsigned b = 0; b < nBlocks; ++b)
+                        for (unsigned t = 0; t < nTimes; ++t)
+                        {
+                            unsigned i = (chunk * nBlocks + b) * nTimes + t;
+                            chunkData.timeSeriesData(b, s, p)[t] = Complex(
+                                    float((i + s) % 11), float((i + p) % 5));
+                        }
+            channeliser.run(&chunkData, &spectra);
+
+            // Timestamp of the first sample of the first spectrum.
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(double(iSpectrum * _nChannels),
+                    spectra.getLofarTimestamp(), 1.0e-9);
+
+            for (unsigned b = 0; b < spectra.nTimeBlocks(); ++b, ++iSpectrum)
+                for (unsigned s = 0; s < nSubbands; ++s)
+                    for (unsigned p = 0; p < nPols; ++p)
+                        for (unsigned c = 0; c < _nChannels; ++c)
+                        {
+                            Complex a = spectra.spectrumData(b, s, p)[c];
+                            Complex e = expected.spectrumData(iSpectrum, s, p)[c];
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(e.real(), a.real(), 1.0e-4);
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(e.imag(), a.imag(), 1.0e-4);
+                        }
+        }
+        CPPUNIT_ASSERT_EQUAL(nSpectra, iSpectrum);
     }
     catch (QString const& err) {
         CPPUNIT_FAIL(err.toLatin1().data());
     }
+}
 
+
+/**
+ * @details
+ * Test that chunks shorter than one spectrum give no spectra until enough
+ * samples are buffered, and then the spectra of the whole stream.
+ */
+void PPFChanneliserTest::test_shortChunk()
+{
+    typedef PPFChanneliser::Complex Complex;
+    unsigned nSubbands = 2;
+    unsigned nPols     = 2;
+    unsigned nTimes    = 5;   // Samples per chunk, fewer than a spectrum.
+    unsigned nChunks   = 16;
+    unsigned nSpectra  = (nChunks * nTimes) / _nChannels;
+
+    try {
+        ConfigNode config(_configXml(_nChannels, 2, _nTaps));
+        PPFChanneliser channeliser(config);
+        PPFChanneliser reference(config);
+
+        // Reference: a single chunk of whole spectra.
+        TimeSeriesDataSetC32 data;
+        data.resize(nSpectra, nSubbands, nPols, _nChannels);
+        for (unsigned s = 0; s < nSubbands; ++s)
+            for (unsigned p = 0; p < nPols; ++p)
+                for (unsigned b = 0; b < nSpectra; ++b)
+                    for (unsigned c = 0; c < _nChannels; ++c)
+                        data.timeSeriesData(b, s, p)[c] = Complex(
+                                float((b * _nChannels + c + s) % 11),
+                                float((b * _nChannels + c + p) % 5));
+        SpectrumDataSetC32 expected;
+        reference.run(&data, &expected);
+
+        // Same stream in chunks of a single block of 5 samples.
+        SpectrumDataSetC32 spectra;
+        unsigned iSpectrum = 0;
+        for (unsigned chunk = 0; chunk < nChunks; ++chunk)
+        {
+            TimeSeriesDataSetC32 chunkData;
+            chunkData.resize(1, nSubbands, nPols, nTimes);
+            chunkData.setBlockRate(1.0);
+            chunkData.setLofarTimestamp(double(chunk * nTimes));
+            for (unsigned s = 0; s < nSubbands; ++s)
+                for (unsigned p = 0; p < nPols; ++p)
+                    for (unsigned t = 0; t < nTimes; ++t)
+                    {
+                        unsigned i = chunk * nTimes + t;
+                        chunkData.timeSeriesData(0, s, p)[t] = Complex(
+                                float((i + s) % 11), float((i + p) % 5));
+                    }
+            channeliser.run(&chunkData, &spectra);
+
+            // A spectrum is produced by each chunk that completes one.
+            unsigned nNew = ((chunk + 1) * nTimes) / _nChannels
+                    - (chunk * nTimes) / _nChannels;
+            CPPUNIT_ASSERT_EQUAL(nNew, spectra.nTimeBlocks());
+            if (chunk < 3)
+                CPPUNIT_ASSERT_EQUAL(0u, spectra.nTimeBlocks());
+
+            for (unsigned b = 0; b < spectra.nTimeBlocks(); ++b, ++iSpectrum)
+                for (unsigned s = 0; s < nSubbands; ++s)
+                    for (unsigned p = 0; p < nPols; ++p)
+                        for (unsigned c = 0; c < _nChannels; ++c)
+                        {
+                            Complex a = spectra.spectrumData(b, s, p)[c];
+                            Complex e = expected.spectrumData(iSpectrum, s, p)[c];
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(e.real(), a.real(), 1.0e-4);
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(e.imag(), a.imag(), 1.0e-4);
+                        }
+        }
+        CPPUNIT_ASSERT_EQUAL(nSpectra, iSpectrum);
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Test that every other spectrum of a 2x oversampled channeliser matches
+ * the critically sampled spectra of the same stream, with the stream fed
+ * in chunks which are not a whole number of hops.
+ */
+void PPFChanneliserTest::test_oversampled()
+{
+    typedef PPFChanneliser::Complex Complex;
+    unsigned nChannels = 32;
+    unsigned nSubbands = 3;
+    unsigned nPols     = 2;
+    unsigned nTimes    = 9;   // Samples per block of the chunked input.
+    unsigned nBlocks   = 13;
+    unsigned nChunks   = 4;
+    unsigned nSpectra  = (nChunks * nBlocks * nTimes) / nChannels;
+
+    try {
+        ConfigNode config43(_configXml(64, 1, _nTaps, "kaiser", "4/3"));
+        CPPUNIT_ASSERT_EQUAL(48u, PPFChanneliser(config43).hop());
+
+        ConfigNode configBad(_configXml(nChannels, 1, _nTaps, "kaiser", "3"));
+        CPPUNIT_ASSERT_THROW(PPFChanneliser channeliser(configBad), QString);
+
+        ConfigNode config(_configXml(nChannels, 2, _nTaps, "kaiser", "2"));
+        ConfigNode configRef(_configXml(nChannels, 1, _nTaps));
+        PPFChanneliser channeliser(config);
+        PPFChanneliser reference(configRef);
+        CPPUNIT_ASSERT_EQUAL(nChannels / 2, channeliser.hop());
+
+        // Reference: critically sampled spectra of the whole stream.
+        TimeSeriesDataSetC32 data;
+        data.resize(nSpectra, nSubbands, nPols, nChannels);
+        for (unsigned s = 0; s < nSubbands; ++s)
+            for (unsigned p = 0; p < nPols; ++p)
+                for (unsigned b = 0; b < nSpectra; ++b)
+                    for (unsigned c = 0; c < nChannels; ++c)
+                        data.timeSeriesData(b, s, p)[c] = Complex(
+                                float((b * nChannels + c + s) % 11),
+                                float((b * nChannels + c + p) % 5));
+        SpectrumDataSetC32 expected;
+        reference.run(&data, &expected);
+
+        SpectrumDataSetC32 spectra;
+        unsigned iSpectrum = 0;
+        for (unsigned chunk = 0; chunk < nChunks; ++chunk)
+        {
+            TimeSeriesDataSetC32 chunkData;
+            chunkData.resize(nBlocks, nSubbands, nPols, nTimes);
+            chunkData.setBlockRate(1.0);
+            chunkData.setLofarTimestamp(double(chunk * nBlocks * nTimes));
+            for (unsigned s = 0; s < nSubbands; ++s)
+                for (unsigned p = 0; p < nPols; ++p)
+                    for (unsigned b = 0; b < nBlocks; ++b)
+                        for (unsigned t = 0; t < nTimes; ++t)
+                        {
+                            unsigned i = (chunk * nBlocks + b) * nTimes + t;
+                            chunkData.timeSeriesData(b, s, p)[t] = Complex(
+                                    float((i + s) % 11), float((i + p) % 5));
+                        }
+            channeliser.run(&chunkData, &spectra);
+
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(double(nChannels / 2),
+                    spectra.getBlockRate(), 1.0e-9);
+            if (spectra.nTimeBlocks() > 0)
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(double(iSpectrum * nChannels / 2),
+                        spectra.getLofarTimestamp(), 1.0e-9);
+
+            for (unsigned b = 0; b < spectra.nTimeBlocks(); ++b, ++iSpectrum)
+            {
+                if (iSpectrum % 2 || iSpectrum / 2 >= nSpectra) continue;
+                for (unsigned s = 0; s < nSubbands; ++s)
+                    for (unsigned p = 0; p < nPols; ++p)
+                        for (unsigned c = 0; c < nChannels; ++c)
+                        {
+                            Complex a = spectra.spectrumData(b, s, p)[c];
+                            Complex e = expected.spectrumData(iSpectrum / 2, s, p)[c];
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(e.real(), a.real(), 1.0e-3);
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(e.imag(), a.imag(), 1.0e-3);
+                        }
+            }
+        }
+        // One spectrum per hop once the first window is complete.
+        unsigned nSamples = nChunks * nBlocks * nTimes;
+        CPPUNIT_ASSERT_EQUAL((nSamples - nChannels) / (nChannels / 2) + 1,
+                iSpectrum);
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Test that coefficients saved to the store by one channeliser are mapped,
+ * unchanged, by the next and that mismatched files are ignored.
+ */
+void PPFChanneliserTest::test_coefficientStore()
+{
+    test::TestDir dir("PPFCoefficientStore", true);
+    QString xml = _configXml(_nChannels, 1, _nTaps).replace("filterWindow=",
+            "store=\"" + dir.absolutePath() + "\" filterWindow=");
+    unsigned stride = PPFFirKernel::stride(_nChannels);
+
+    try {
+        ConfigNode config(xml);
+        PPFChanneliser generated(config);
+        CPPUNIT_ASSERT(generated._coeffBuffer != 0);
+        CPPUNIT_ASSERT(QFile::exists(generated._coeffStore->fileName(_nTaps,
+                _nChannels, PolyphaseCoefficients::KAISER)));
+
+        PPFChanneliser mapped(config);
+        CPPUNIT_ASSERT(mapped._coeffBuffer == 0);
+        CPPUNIT_ASSERT_EQUAL(unsigned(0), mapped._ppfCoeffs.size());
+        CPPUNIT_ASSERT_EQUAL(size_t(0), size_t(mapped._coeffs) % PPFFirKernel::alignment);
+        for (unsigned i = 0; i < _nTaps * stride; ++i)
+            CPPUNIT_ASSERT_EQUAL(generated._coeffs[i], mapped._coeffs[i]);
+
+        // A different key is not served from the same file.
+        PPFCoefficientStore store(dir.absolutePath());
+        CPPUNIT_ASSERT(store.map(_nTaps, _nChannels, PolyphaseCoefficients::KAISER));
+        CPPUNIT_ASSERT(!store.map(_nTaps, _nChannels, PolyphaseCoefficients::HAMMING));
+        CPPUNIT_ASSERT(!store.map(_nTaps + 1, _nChannels, PolyphaseCoefficients::KAISER));
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
 }
 
 
@@ -375,7 +631,7 @@ void PPFChanneliserTest::test_updateBuffer()
                 * _nPols * _nBlocks);
 
         // Local pointers to buffers.
-        PPFChanneliser::Complex* subbandBuffer;
+        float* subbandBuffer;
         PPFChanneliser::Complex* newSamples;
 
         // Iterate over the update buffer method to time it.
@@ -389,8 +645,9 @@ void PPFChanneliserTest::test_updateBuffer()
                 {
                     unsigned i = _nChannels * (p +  _nPols * (s + _nSubbands * b));
                     newSamples = &sampleBuffer[i];;
-                    subbandBuffer = &(channeliser._workBuffer[s * _nPols + p])[0];
-                    channeliser._updateBuffer(newSamples, _nChannels, _nTaps, subbandBuffer);
+                    subbandBuffer = channeliser._workBuffer[s * _nPols + p];
+                    channeliser._updateBuffer(newSamples, _nChannels, _nTaps,
+                            subbandBuffer, channeliser._iOldestSamples[s * _nPols + p]);
                 }
             }
         }
@@ -431,15 +688,11 @@ void PPFChanneliserTest::test_filter()
     // Setup work buffers.
     channeliser._setupWorkBuffers(_nSubbands, _nPols, _nChannels, _nTaps);
 
-    std::vector<PPFChanneliser::Complex> filteredData(_nChannels);
+    std::vector<PPFChanneliser::Complex> filteredData(
+            PPFFirKernel::stride(_nChannels));
     PPFChanneliser::Complex* filteredSamples = &filteredData[0];
-    PPFChanneliser::Complex* workBuffer;
-
-    double const* coeff = channeliser._ppfCoeffs.ptr();
-    unsigned nCoeffs    = channeliser._ppfCoeffs.size();
-    float* fCoeffs = new float[nCoeffs];
-    for (unsigned i = 0; i < nCoeffs; ++i)
-        fCoeffs[i] = float(coeff[i]);
+    float* workBuffer;
+    const float* fCoeffs = channeliser._coeffs;
 
     QTime timer;
     timer.start();
@@ -449,8 +702,9 @@ void PPFChanneliserTest::test_filter()
         {
             for (unsigned p = 0; p < _nPols; ++p)
             {
-                workBuffer = &(channeliser._workBuffer[s * _nPols + p])[0];
-                channeliser._filter(workBuffer, _nTaps, _nChannels, fCoeffs,
+                workBuffer = channeliser._workBuffer[s * _nPols + p];
+                channeliser._filter(workBuffer, _nTaps, _nChannels,
+                        channeliser._iOldestSamples[s * _nPols + p], fCoeffs,
                         filteredSamples);
             }
         }
@@ -474,6 +728,60 @@ void PPFChanneliserTest::test_filter()
 }
 
 
+/**
+ * @details
+ * Test the vector FIR kernels against the scalar kernel.
+ */
+void PPFChanneliserTest::test_filterKernels()
+{
+    typedef PPFFirKernel::Complex Complex;
+    unsigned nTaps = 8;
+    unsigned nChannelsList[] = { 2, 16, 18, 64, 100 };
+
+    for (unsigned n = 0; n < 5; ++n)
+    {
+        unsigned nChannels = nChannelsList[n];
+        unsigned stride = PPFFirKernel::stride(nChannels);
+        CPPUNIT_ASSERT(stride >= nChannels);
+        CPPUNIT_ASSERT_EQUAL(0u, stride % 16);
+
+        float* buffer = PPFFirKernel::allocate(2 * nTaps * stride);
+        float* coeffs = PPFFirKernel::allocate(nTaps * stride);
+        for (unsigned i = 0; i < nTaps * stride; ++i)
+        {
+            buffer[i] = float(i % 7) - 3.0f;
+            buffer[nTaps * stride + i] = float(i % 5) * 0.5f;
+            coeffs[i] = float(i % 11) * 0.1f - 0.5f;
+        }
+
+        std::vector<Complex> expected(stride), filtered(stride);
+        for (unsigned iOldest = 0; iOldest < nTaps; ++iOldest)
+        {
+            PPFFirKernel::function(PPFFirKernel::SCALAR)(buffer,
+                    &buffer[nTaps * stride], nTaps, iOldest, stride, coeffs,
+                    &expected[0]);
+
+            for (unsigned k = PPFFirKernel::SSE; k <= PPFFirKernel::AVX512; ++k)
+            {
+                PPFFirKernel::Type type = PPFFirKernel::Type(k);
+                if (!PPFFirKernel::supported(type)) continue;
+                PPFFirKernel::function(type)(buffer, &buffer[nTaps * stride],
+                        nTaps, iOldest, stride, coeffs, &filtered[0]);
+                for (unsigned c = 0; c < nChannels; ++c)
+                {
+                    CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[c].real(),
+                            filtered[c].real(), 1.0e-5);
+                    CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[c].imag(),
+                            filtered[c].imag(), 1.0e-5);
+                }
+            }
+        }
+        PPFFirKernel::free(buffer);
+        PPFFirKernel::free(coeffs);
+    }
+}
+
+
 /**
  * @details
  * Test the fft stage.
@@ -486,22 +794,36 @@ void PPFChanneliserTest::test_fft()
     PPFChanneliser channeliser(config);
     typedef PPFChanneliser::Complex Complex;
 
-    SpectrumDataSetC32 spectra;
-    spectra.resize(_nBlocks, _nSubbands, _nPols, _nChannels);
-
-    std::vector<PPFChanneliser::Complex> filteredData(_nChannels);
-    const PPFChanneliser::Complex* filteredSamples = &filteredData[0];
+    // Transform a batch of impulses, which should give flat spectra.
+    unsigned batch = channeliser._fftBatch;
+    unsigned stride = PPFFirKernel::stride(_nChannels);
+    Complex* filteredSamples = channeliser._filteredData[0];
+    fftwf_plan plan = channeliser._fftPlan(batch, 0);
+    for (unsigned b = 0; b < batch; ++b)
+    {
+        for (unsigned c = 0; c < _nChannels; ++c)
+            filteredSamples[b * stride + c] = Complex(0.0, 0.0);
+        filteredSamples[b * stride] = Complex(1.0, 0.0);
+    }
+    channeliser._fft(plan);
+    for (unsigned b = 0; b < batch; ++b)
+    {
+        for (unsigned c = 0; c < _nChannels; ++c)
+        {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, filteredSamples[b * stride + c].real(), 1.0e-5);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, filteredSamples[b * stride + c].imag(), 1.0e-5);
+        }
+    }
 
     QTime timer;
     timer.start();
-    for (unsigned b = 0; b < _nBlocks; ++b)
+    for (unsigned b = 0; b < _nBlocks; b += batch)
     {
         for (unsigned s = 0; s < _nSubbands; ++s)
         {
             for (unsigned p = 0; p < _nPols; ++p)
             {
-                Complex* spectrumData = spectra.spectrumData(b, s, p);
-                channeliser._fft(filteredSamples, spectrumData);
+                channeliser._fft(plan);
             }
         }
     }
@@ -531,13 +853,15 @@ void PPFChanneliserTest::test_fft()
  * @return
  */
 QString PPFChanneliserTest::_configXml(unsigned nChannels,
-        unsigned nThreads, unsigned nTaps, const QString& windowType)
+        unsigned nThreads, unsigned nTaps, const QString& windowType,
+        const QString& oversampling)
 {
     QString xml =
             "<PPFChanneliser>"
             "	<outputChannelsPerSubband value=\"" + QString::number(nChannels) + "\"/>"
             "	<processingThreads value=\"" + QString::number(nThreads) + "\"/>"
             "	<filter nTaps=\"" + QString::number(nTaps) + "\" filterWindow=\"" + windowType + "\"/>"
+            "	<oversampling factor=\"" + oversampling + "\"/>"
             "</PPFChanneliser>";
     return xml;
 }
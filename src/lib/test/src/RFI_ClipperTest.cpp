@@ -3,8 +3,16 @@
 #include "SpectrumDataSet.h"
 #include "WeightedSpectrumDataSet.h"
 #include "BandPass.h"
-#include "pelican/utility/TestConfig.h"
+#include "BinMap.h"
+#include <QtCore/QFile>
+#include <QtCore/QDir>
+#include <QtCore/QTextStream>
+#include <QtCore/QCoreApplication>
 #include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
 
 
 namespace pelican {
@@ -29,10 +37,21 @@ RFI_ClipperTest::~RFI_ClipperTest()
 
 void RFI_ClipperTest::setUp()
 {
+    _nSubbands = 4;
+    _nChannels = 16;
+    _start = 131.25;
+    _width = 0.01;
+    _fileName = QDir::tempPath() + "/_RFI_ClipperTest_";
+#if QT_VERSION >= 0x040400
+    _fileName += QString().setNum( QCoreApplication::applicationPid() );
+#endif
 }
 
 void RFI_ClipperTest::tearDown()
 {
+    QFile f(_fileName);
+    if( f.exists() )
+        f.remove();
 }
 
 
@@ -40,20 +59,26 @@ void RFI_ClipperTest::test_goodData()
 {
     try {
     // Use Case:
-    // Data has no significant spikes
+    // Data matching the bandpass, once the running averages are trained
     // Expect:
-    // Pass through unchanged
-    ConfigNode config = testConfig();
-    RFI_Clipper rfi(config);
+    // Pass through unchanged, up to normalisation
+    QVector<float> params;
+    params << 10.0;
+    _writeBandPass( _fileName, 1.0, params );
+    RFI_Clipper rfi( _config( _fileName, "<History maximum=\"1000\" />\n" ) );
+    _train( rfi );
 
     SpectrumDataSetStokes dataStokes;
+    _alternate( dataStokes, 100, 10.0, 1.0 );
     SpectrumDataSetStokes expect;
-    int nChannels = 16;
-    //int nChannels = 256;
-    _initSubbandData(dataStokes, expect, rfi.bandPass(), 31, nChannels);
+    expect = dataStokes;
     WeightedSpectrumDataSet data(&dataStokes);
     rfi.run(&data);
-    CPPUNIT_ASSERT_EQUAL( 0,  _diff(dataStokes, expect).size() );
+    CPPUNIT_ASSERT_EQUAL( 0u, rfi.stats().nBadSpectra() );
+    CPPUNIT_ASSERT_EQUAL( 0u, rfi.stats().nBadChannels() );
+    for( unsigned t = 0; t < dataStokes.nTimeBlocks(); ++t )
+        CPPUNIT_ASSERT( _same( _standardised(expect, t),
+                               _standardised(dataStokes, t) ) );
     }
     catch( QString s )
     {
@@ -67,39 +92,38 @@ void RFI_ClipperTest::test_badSubband()
     // Use Case:
     // Data has a single subband which is bad
     // Expect:
-    // Bad Subband is reduced to 0, all other values pass OK
-    ConfigNode config = testConfig();
-    RFI_Clipper rfi(config);
+    // The spectrum is replaced by the last good spectrum, all other
+    // spectra pass OK
+    QVector<float> params;
+    params << 10.0;
+    _writeBandPass( _fileName, 1.0, params );
+    RFI_Clipper rfi( _config( _fileName, "<History maximum=\"1000\" />\n" ) );
+    _train( rfi );
 
     SpectrumDataSetStokes dataStokes;
+    _alternate( dataStokes, 100, 10.0, 1.0 );
     SpectrumDataSetStokes expect;
-    //int nChannels = 16;
-    int nChannels = 16;
-    _initSubbandData( dataStokes, expect,rfi.bandPass(), 31, nChannels );
+    expect = dataStokes;
     WeightedSpectrumDataSet data(&dataStokes);
-    int badBlock = 1;
-    int badSubband = 0;
-    int badPol = 0;
-
-    float* d = dataStokes.spectrumData(badBlock,badSubband,badPol); 
-    float* d2 = expect.spectrumData(badBlock,badSubband,badPol); 
-    for(int channel=0; channel < nChannels; ++channel)
-    {
-        d2[channel] = 0;
-        d[channel] += 15.0*rfi.bandPass().rms();
-    }
+    unsigned badBlock = 10;
+    unsigned badSubband = 1;
+    float* d = dataStokes.spectrumData(badBlock, badSubband, 0);
+    for( unsigned channel = 0; channel < _nChannels; ++channel )
+        d[channel] += 50.0;
 
     rfi.run(&data);
-    QList<RFI_ClipperTest::StokesIndex> different = _diff(expect,dataStokes);
-    if( different.size() > 0  )
-    {
-        //foreach( const StokesIndex& i, different )
-        //{
-       //     std::cout << "badSubband: block=" << i.block << " subband=" << i.subband << " pol=" << i.polarisation << " channel=" << i.channel <<  std::endl;
-        //}
-        CPPUNIT_ASSERT_EQUAL( 0 ,  different.size() );
+    CPPUNIT_ASSERT_EQUAL( 1u, rfi.stats().nBadSpectra() );
+    CPPUNIT_ASSERT_EQUAL( _nChannels, rfi.stats().nBadChannels() );
+    for( unsigned t = 0; t < dataStokes.nTimeBlocks(); ++t ) {
+        if( t == badBlock ) continue;
+        CPPUNIT_ASSERT( _same( _standardised(expect, t),
+                               _standardised(dataStokes, t) ) );
     }
-    //CPPUNIT_ASSERT_EQUAL( 0 ,  _diff(expect ,data).size() );
+    // the last good spectrum alternates as the odd spectra do
+    CPPUNIT_ASSERT( _same( _standardised(dataStokes, badBlock + 1),
+                           _standardised(dataStokes, badBlock) ) );
+    CPPUNIT_ASSERT( ! _same( _standardised(expect, badBlock),
+                             _standardised(dataStokes, badBlock) ) );
     }
     catch( QString s )
     {
@@ -111,42 +135,43 @@ void RFI_ClipperTest::test_badChannel()
 {
     try {
     // Use Case:
-    // Data has a single channel in a single subband which is bad
+    // Data has a single channel in a single spectrum which is bad
     // Expect:
-    // Bad channel is reduced to 0, all other values are OK
-    ConfigNode config = testConfig();
-    RFI_Clipper rfi(config);
+    // Bad channel is replaced by the last good spectrum, all other values
+    // are OK
+    QVector<float> params;
+    params << 10.0;
+    _writeBandPass( _fileName, 1.0, params );
+    RFI_Clipper rfi( _config( _fileName, "<History maximum=\"1000\" />\n" ) );
+    _train( rfi );
 
     SpectrumDataSetStokes dataStokes;
+    _alternate( dataStokes, 100, 10.0, 1.0 );
     SpectrumDataSetStokes expect;
-    int numSubbands = 1;
-    int nChannels = 256;
-    _initSubbandData(dataStokes, expect, rfi.bandPass(), numSubbands, nChannels);
+    expect = dataStokes;
     WeightedSpectrumDataSet data(&dataStokes);
 
     // put in a bad channel
-    int badBlock = 1;
-    int badSubband = 0;
-    int badChannel = 2;
-    int badPol = 0;
-    float* d = dataStokes.spectrumData(badBlock,badSubband,badPol); 
-    float* e = expect.spectrumData(badBlock,badSubband,badPol); 
-    e[badChannel] = 0; //d[badChannel];
-    d[badChannel] += 15.0*rfi.bandPass().rms(); // should not catch below this
-    int badIndex = dataStokes.index(badSubband, numSubbands, 0, 1,
-                        badBlock, nChannels ) + badChannel;
+    unsigned badBlock = 10;
+    unsigned badSubband = 2;
+    unsigned badChannel = 5;
+    dataStokes.spectrumData(badBlock, badSubband, 0)[badChannel] += 50.0;
 
     rfi.run(&data);
-    QList<RFI_ClipperTest::StokesIndex> different = _diff(expect,dataStokes);
-    if( different.size() > 0  )
-    {
-        std::cout << "expecting clipped channel : " << badIndex << std::endl;
-        foreach( const StokesIndex& i, different )
-        {
-            std::cout << "badChannel: block=" << i.block << " subband=" << i.subband << " pol=" << i.polarisation << "channel=" << i.channel <<std::endl;
-        }
-        CPPUNIT_ASSERT_EQUAL( 0 ,  different.size() );
+    CPPUNIT_ASSERT_EQUAL( 0u, rfi.stats().nBadSpectra() );
+    CPPUNIT_ASSERT_EQUAL( 1u, rfi.stats().nBadChannels() );
+    CPPUNIT_ASSERT_EQUAL( 1u,
+            rfi.stats().clipCounts()[badSubband * _nChannels + badChannel] );
+    for( unsigned t = 0; t < dataStokes.nTimeBlocks(); ++t ) {
+        if( t == badBlock ) continue;
+        CPPUNIT_ASSERT( _same( _standardised(expect, t),
+                               _standardised(dataStokes, t) ) );
     }
+    // the last good spectrum has the value of the neighbouring channels
+    const float* d = dataStokes.spectrumData(badBlock, badSubband, 0);
+    CPPUNIT_ASSERT_EQUAL( d[badChannel - 1], d[badChannel] );
+    CPPUNIT_ASSERT_EQUAL( d[badChannel + 1], d[badChannel] );
+    CPPUNIT_ASSERT( d[badChannel + 2] != d[badChannel] );
     }
     catch( QString s )
     {
@@ -154,55 +179,219 @@ void RFI_ClipperTest::test_badChannel()
     }
 }
 
-void  RFI_ClipperTest::_initSubbandData( SpectrumDataSetStokes& primary, SpectrumDataSetStokes& shifted, const BandPass& bp, int numberOfSubbands, int numberOfChannels )
+void RFI_ClipperTest::test_threads()
 {
-    int numberOfBlocks = 10;
-    int numberOfPolarisations = 1;
-    float offset = 10000.00;
-    BandPass bandPass = bp;
-    //float value = (numberOfChannels/2.0);
-    //int maxRange = value - 1;
-    int nBins = numberOfChannels * numberOfSubbands;
-    BinMap map( nBins );
-    map.setStart(bandPass.startFrequency());
-    map.setEnd(bandPass.endFrequency());
-    bandPass.reBin(map);
-    //int maxRange = bandPass.rms();
-    int maxRange = 5.0 * bandPass.rms()/sqrt(numberOfChannels * numberOfSubbands);
-
-    //float av = 0;
-    // generate a dataset that is like the BandPass with random noise < rms of the bandpass
-    primary.resize( numberOfBlocks, numberOfSubbands, numberOfPolarisations, numberOfChannels );
-    for( int block=0; block < numberOfBlocks; ++block ) {
-        int bin = 0;
-        for( int subband=0; subband < numberOfSubbands; ++subband ) {
-            for( int polarisation=0; polarisation < numberOfPolarisations; ++polarisation ) {
-                float* ptr = primary.spectrumData( block, subband, polarisation );
-                for( int i=0; i < numberOfChannels; ++i ) {
-                    //ptr[i] = value + rand()%maxRange;
-                    ptr[i] = bandPass.intensityOfBin(bin + i) + rand()%maxRange + offset;
-                    //av += ptr[i];
+    try {
+    // Use Case:
+    // The same chunks, with bright channels throughout and two bright
+    // spectra once the running averages are trained, clipped with 1 and
+    // with 3 threads
+    // Expect:
+    // identical data and weights, bit for bit, with the bright spectra
+    // replaced by the last good spectrum
+    QVector<float> params;
+    params << 10.0;
+    _writeBandPass( _fileName, 1.0, params );
+    QString options = "<History maximum=\"1000\" />\n"
+                      "<ChannelMask history=\"2\" />\n";
+    RFI_Clipper rfi1( _config( _fileName, options +
+                               "<processingThreads value=\"1\" />\n" ) );
+    RFI_Clipper rfi3( _config( _fileName, options +
+                               "<processingThreads value=\"3\" />\n" ) );
+
+    // Chunks of 37 spectra (not a multiple of the threads): the first
+    // 999 spectra are clipped while the running averages are trained, so
+    // the last good spectrum is set in chunk 27
+    unsigned nBlocks = 37;
+    unsigned nChunks = 30;
+    unsigned trainedChunk = 999 / nBlocks;
+    SpectrumDataSetStokes trainedInput;
+    SpectrumDataSetStokes trainedOutput;
+    srand(12345);
+    for( unsigned chunk = 0; chunk < nChunks; ++chunk ) {
+        SpectrumDataSetStokes stokes1;
+        _fill( stokes1, nBlocks, 10.0, 1.0 );
+        // bright channels, and in the last chunk bright spectra
+        stokes1.spectrumData( 5, 1, 0 )[7] += 50.0;
+        stokes1.spectrumData( 20, 3, 0 )[12] += 50.0;
+        if( chunk == nChunks - 1 ) {
+            for( unsigned s = 0; s < _nSubbands; ++s ) {
+                for( unsigned c = 0; c < _nChannels; ++c ) {
+                    stokes1.spectrumData( 2, s, 0 )[c] += 5.0;
+                    stokes1.spectrumData( 34, s, 0 )[c] += 5.0;
                 }
             }
-            bin += numberOfChannels;
         }
+        SpectrumDataSetStokes stokes3;
+        stokes3 = stokes1;
+        if( chunk == trainedChunk )
+            trainedInput = stokes1;
+
+        WeightedSpectrumDataSet data1(&stokes1);
+        WeightedSpectrumDataSet data3(&stokes3);
+        rfi1.run(&data1);
+        rfi3.run(&data3);
+
+        CPPUNIT_ASSERT_EQUAL( 0, _diff(stokes1, stokes3).size() );
+        const float* w1 = data1.weights()->data();
+        const float* w3 = data3.weights()->data();
+        for( int i = 0; i < data1.weights()->size(); ++i )
+            CPPUNIT_ASSERT_EQUAL( w1[i], w3[i] );
+        CPPUNIT_ASSERT_EQUAL( rfi1.stats().nBadSpectra(),
+                              rfi3.stats().nBadSpectra() );
+        if( chunk == trainedChunk )
+            trainedOutput = stokes1;
+        if( chunk != nChunks - 1 )
+            continue;
+
+        // The last good spectrum is the first spectrum after training
+        // which was passed through (up to normalisation)
+        unsigned good = 0;
+        while( good < nBlocks && ! _same( _standardised(trainedInput, good),
+                                          _standardised(trainedOutput, good) ) )
+            ++good;
+        CPPUNIT_ASSERT( good < nBlocks );
+        CPPUNIT_ASSERT( rfi1.stats().nBadSpectra() >= 2 );
+        QVector<float> lastGood = _standardised( trainedInput, good );
+        CPPUNIT_ASSERT( _same( lastGood, _standardised(stokes1, 2) ) );
+        CPPUNIT_ASSERT( _same( lastGood, _standardised(stokes1, 34) ) );
+        CPPUNIT_ASSERT( ! _same( lastGood, _standardised(stokes1, 3) ) );
     }
-    shifted = primary; // no longer need to shift
-    // generate the shifted dataseto
-    /*
-    for( int block=0; block < numberOfBlocks; ++block ) {
-        for( int subband=0; subband < numberOfSubbands; ++subband ) {
-            for( int polarisation=0; polarisation < numberOfPolarisations; ++polarisation ) {
-                float* ptr = primary.spectrumData( block, subband, polarisation );
-                float* sptr = shifted.spectrumData( block, subband, polarisation );
-                for( int i=0; i < numberOfChannels; ++i ) {
-                    sptr[i] = ptr[0];
-                    av += ptr[i];
-                }
+    }
+    catch( QString s )
+    {
+        CPPUNIT_FAIL(s.toStdString());
+    }
+}
+
+void RFI_ClipperTest::test_updateBandPass()
+{
+    try {
+    // Use Case:
+    // The watched bandpass file is replaced, then a model is passed to
+    // updateBandPass()
+    // Expect:
+    // each new model to be used from the next run()
+    QVector<float> params;
+    params << 10.0;
+    _writeBandPass( _fileName, 1.0, params );
+    RFI_Clipper rfi( _config( _fileName, "<BandPassData file=\"" + _fileName
+                                         + "\" watch=\"10\" />" ) );
+    SpectrumDataSetStokes stokes;
+    _fill( stokes, 8, 10.0, 1.0 );
+    WeightedSpectrumDataSet data(&stokes);
+    rfi.run(&data);
+    CPPUNIT_ASSERT_EQUAL( 0u, rfi.bandPassUpdates() );
+    CPPUNIT_ASSERT( params == rfi.bandPass().params() );
+
+    // a longer file, so the change is seen even within the resolution
+    // of the modification time
+    QVector<float> fileParams;
+    fileParams << 20.0 << 0.0;
+    _writeBandPass( _fileName, 2.0, fileParams );
+    for( int i = 0; i < 500 && rfi.bandPassUpdates() == 0; ++i ) {
+        usleep(10000);
+        _fill( stokes, 8, 20.0, 2.0 );
+        data.reset(&stokes);
+        rfi.run(&data);
+    }
+    CPPUNIT_ASSERT_EQUAL( 1u, rfi.bandPassUpdates() );
+    CPPUNIT_ASSERT( fileParams == rfi.bandPass().params() );
+
+    QVector<float> newParams;
+    newParams << 30.0 << 0.0 << 0.0;
+    BandPass bandPass = rfi.bandPass();
+    BinMap map( _nSubbands * _nChannels );
+    map.setStart( _start );
+    map.setBinWidth( _width );
+    bandPass.setData( map, newParams );
+    rfi.updateBandPass( bandPass );
+    CPPUNIT_ASSERT_EQUAL( 1u, rfi.bandPassUpdates() );
+    _fill( stokes, 8, 30.0, 2.0 );
+    data.reset(&stokes);
+    rfi.run(&data);
+    CPPUNIT_ASSERT_EQUAL( 2u, rfi.bandPassUpdates() );
+    CPPUNIT_ASSERT( newParams == rfi.bandPass().params() );
+    }
+    catch( QString s )
+    {
+        CPPUNIT_FAIL(s.toStdString());
+    }
+}
+
+void RFI_ClipperTest::test_channelMask()
+{
+    try {
+    // Use Case:
+    // A channel is bright throughout one chunk, with a mask history of
+    // 3 chunks
+    // Expect:
+    // the channel to be masked after that chunk and replaced by the last
+    // good spectrum without being tested for the next 3 chunks, then
+    // released and tested again
+    QVector<float> params;
+    params << 10.0;
+    _writeBandPass( _fileName, 1.0, params );
+    RFI_Clipper rfi( _config( _fileName, "<History maximum=\"1000\" />\n"
+                     "<ChannelMask history=\"3\" minFraction=\"0.1\" />\n" ) );
+    _train( rfi );
+    unsigned nBins = _nSubbands * _nChannels;
+    CPPUNIT_ASSERT_EQUAL( (size_t)nBins, rfi.channelMask().size() );
+    CPPUNIT_ASSERT_EQUAL( 0, (int)std::count( rfi.channelMask().begin(),
+                                              rfi.channelMask().end(), 1 ) );
+
+    unsigned badSubband = 2;
+    unsigned badChannel = 5;
+    unsigned bin = badSubband * _nChannels + badChannel;
+    unsigned history = 3;
+    SpectrumDataSetStokes dataStokes;
+    for( unsigned chunk = 0; chunk <= history + 1; ++chunk ) {
+        _alternate( dataStokes, 100, 10.0, 1.0 );
+        SpectrumDataSetStokes expect;
+        expect = dataStokes;
+        if( chunk == 0 ) {
+            for( unsigned t = 0; t < dataStokes.nTimeBlocks(); ++t )
+                dataStokes.spectrumData(t, badSubband, 0)[badChannel] += 50.0;
+        }
+        else if( chunk == history + 1 ) {
+            dataStokes.spectrumData(10, badSubband, 0)[badChannel] += 50.0;
+        }
+        WeightedSpectrumDataSet data(&dataStokes);
+        rfi.run(&data);
+        CPPUNIT_ASSERT_EQUAL( 0u, rfi.stats().nBadSpectra() );
+        if( chunk == 0 ) {
+            // clipped in every spectrum
+            CPPUNIT_ASSERT_EQUAL( 100u, rfi.stats().clipCounts()[bin] );
+        }
+        else if( chunk <= history ) {
+            // masked, so not tested, but replaced by the last good spectrum
+            CPPUNIT_ASSERT_EQUAL( 0u, rfi.stats().clipCounts()[bin] );
+            const float* d = dataStokes.spectrumData(10, badSubband, 0);
+            CPPUNIT_ASSERT_EQUAL( d[badChannel - 1], d[badChannel] );
+            CPPUNIT_ASSERT_EQUAL( d[badChannel + 1], d[badChannel] );
+            CPPUNIT_ASSERT( ! _same( _standardised(expect, 10),
+                                     _standardised(dataStokes, 10) ) );
+        }
+        else {
+            // tested again
+            CPPUNIT_ASSERT_EQUAL( 1u, rfi.stats().clipCounts()[bin] );
+            for( unsigned t = 0; t < dataStokes.nTimeBlocks(); ++t ) {
+                if( t == 10 ) continue;
+                CPPUNIT_ASSERT( _same( _standardised(expect, t),
+                                       _standardised(dataStokes, t) ) );
             }
         }
+        // masked after the bright chunk until its history expires
+        bool masked = chunk < history;
+        for( unsigned i = 0; i < nBins; ++i ) {
+            CPPUNIT_ASSERT_EQUAL( i == bin && masked, rfi.channelMask()[i] != 0 );
+        }
+    }
+    }
+    catch( QString s )
+    {
+        CPPUNIT_FAIL(s.toStdString());
     }
-    */
 }
 
 // N.B. assumes they are the same dimension
@@ -260,20 +449,144 @@ void RFI_ClipperTest::dump(const SpectrumDataSetStokes a)
     std::cout << "-----------------------------------------" << std::endl;
 }
 
-ConfigNode RFI_ClipperTest::testConfig(const QString& file)
+ConfigNode RFI_ClipperTest::_config( const QString& fileName,
+                                     const QString& options ) const
 {
+    // an option given for BandPassData replaces the default
+    QString xml = "<RFI_Clipper>\n";
+    if( ! options.contains("<BandPassData") )
+        xml += "<BandPassData file=\"" + fileName + "\" />\n";
+    xml += "<Band matching=\"true\" />\n" + options +
+           "</RFI_Clipper>\n";
     ConfigNode node;
-    QString xml = "<RFI_Clipper rejectionFactor=\"10.0\" >\n"
-                        "<BandPassData file=\"" + 
-                        pelican::test::TestConfig::findTestFile(file, "lib") 
-                        + "\" />\n"
-                        "<Band startFrequency=\"131.250763\" endFrequency=\"137.3\" />\n"
-                  "</RFI_Clipper>\n";
     node.setFromString( xml );
-                        //"<Band startFrequency=\"131.250763\" endFrequency=\"131.2530514\" />\n"
-                        //"<Band startFrequency=\"131.250763\" endFrequency=\"137.3\" />\n"
     return node;
 }
 
+/**
+ * @details
+ * The file holds the number of channels, the start and end frequencies,
+ * the channel width, the rms and the median, followed by the polynomial
+ * coefficients, of which the BandPassAdapter takes the median as the
+ * constant term.
+ */
+void RFI_ClipperTest::_writeBandPass( const QString& fileName, float rms,
+                                      const QVector<float>& params ) const
+{
+    unsigned nBins = _nSubbands * _nChannels;
+    QFile file(fileName);
+    if( ! file.open(QIODevice::WriteOnly | QIODevice::Truncate) )
+        throw QString("RFI_ClipperTest: cannot write \"%1\"").arg(fileName);
+    QTextStream out(&file);
+    out << "# RFI_ClipperTest bandpass\n";
+    out << nBins << "\n";
+    out << QString::number(_start, 'g', 12) << "\n";
+    out << QString::number(_start + (nBins - 1) * _width, 'g', 12) << "\n";
+    out << QString::number(_width, 'g', 12) << "\n";
+    out << rms << "\n";
+    for( int i = 0; i < params.size(); ++i )
+        out << params[i] << "\n";
+}
+
+/**
+ * @details
+ * The noise is the sum of 4 uniform deviates, scaled to the given rms and
+ * so never more than 3.5 rms from level.
+ */
+void RFI_ClipperTest::_fill( SpectrumDataSetStokes& stokes, unsigned nBlocks,
+                             float level, float rms ) const
+{
+    stokes.resize( nBlocks, _nSubbands, 1, _nChannels );
+    float scale = rms * std::sqrt(3.0);
+    for( unsigned t = 0; t < nBlocks; ++t ) {
+        for( unsigned s = 0; s < _nSubbands; ++s ) {
+            float* I = stokes.spectrumData( t, s, 0 );
+            for( unsigned c = 0; c < _nChannels; ++c ) {
+                float noise = 0.0;
+                for( int k = 0; k < 4; ++k )
+                    noise += (float)rand() / RAND_MAX - 0.5;
+                I[c] = level + scale * noise;
+            }
+        }
+    }
+}
+
+/**
+ * @details
+ * Each channel is level +/- rms, alternating between neighbouring channels
+ * and between spectra, so that every band has the same minimum and RMS
+ * and every spectrum the same mean.
+ */
+void RFI_ClipperTest::_alternate( SpectrumDataSetStokes& stokes,
+                                  unsigned nBlocks, float level,
+                                  float rms ) const
+{
+    stokes.resize( nBlocks, _nSubbands, 1, _nChannels );
+    for( unsigned t = 0; t < nBlocks; ++t ) {
+        for( unsigned s = 0; s < _nSubbands; ++s ) {
+            float* I = stokes.spectrumData( t, s, 0 );
+            for( unsigned c = 0; c < _nChannels; ++c )
+                I[c] = ( s * _nChannels + c + t ) % 2 ? level + rms
+                                                      : level - rms;
+        }
+    }
+}
+
+/**
+ * @details
+ * Runs the 1000 spectra of the warm-up, in chunks of 100 alternating
+ * spectra of level 10 and rms 1, so that the last good spectrum is the
+ * next one (an odd spectrum of the alternation).
+ */
+void RFI_ClipperTest::_train( RFI_Clipper& rfi ) const
+{
+    SpectrumDataSetStokes stokes;
+    for( unsigned chunk = 0; chunk < 10; ++chunk ) {
+        _alternate( stokes, 100, 10.0, 1.0 );
+        WeightedSpectrumDataSet data(&stokes);
+        rfi.run(&data);
+    }
+}
+
+/**
+ * @details
+ * Returns spectrum @p t of the first polarisation with its mean removed
+ * and scaled to unit RMS, so that spectra which only differ in the
+ * clipper's normalisation compare equal.
+ */
+QVector<float> RFI_ClipperTest::_standardised( const SpectrumDataSetStokes& stokes,
+                                               unsigned t ) const
+{
+    unsigned nChannels = stokes.nChannels();
+    QVector<float> spectrum( stokes.nSubbands() * nChannels );
+    double sum = 0.0;
+    double sumSq = 0.0;
+    for( unsigned s = 0; s < stokes.nSubbands(); ++s ) {
+        const float* I = stokes.spectrumData( t, s, 0 );
+        for( unsigned c = 0; c < nChannels; ++c ) {
+            spectrum[s * nChannels + c] = I[c];
+            sum += I[c];
+            sumSq += I[c] * I[c];
+        }
+    }
+    double mean = sum / spectrum.size();
+    double rms = std::sqrt( sumSq / spectrum.size() - mean * mean );
+    for( int i = 0; i < spectrum.size(); ++i )
+        spectrum[i] = ( spectrum[i] - mean ) / rms;
+    return spectrum;
+}
+
+bool RFI_ClipperTest::_same( const QVector<float>& a,
+                             const QVector<float>& b ) const
+{
+    if( a.size() != b.size() )
+        return false;
+    for( int i = 0; i < a.size(); ++i ) {
+        if( std::fabs( a[i] - b[i] ) > 1e-3 )
+            return false;
+    }
+    return true;
+}
+
 } // namespace ampp
 } // namespace pelican
@@ -0,0 +1,95 @@
+#include "RFI_StatisticsTest.h"
+#include "RFI_Statistics.h"
+#include <QtCore/QBuffer>
+
+
+namespace pelican {
+
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RFI_StatisticsTest );
+/**
+ *@details RFI_StatisticsTest
+ */
+RFI_StatisticsTest::RFI_StatisticsTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ *@details
+ */
+RFI_StatisticsTest::~RFI_StatisticsTest()
+{
+}
+
+void RFI_StatisticsTest::setUp()
+{
+}
+
+void RFI_StatisticsTest::tearDown()
+{
+}
+
+void RFI_StatisticsTest::test_serialise_deserialise()
+{
+    // Use Case:
+    // Serialise the statistics of a chunk and read them back into a
+    // blob holding the statistics of a different chunk
+    // Expect:
+    // all counts, the statistics and the clip count histogram restored
+    unsigned nSpectra = 20;
+    unsigned nChannels = 37;
+    RFI_Statistics stats;
+    stats.reset( nSpectra, nChannels );
+    stats.setTimestamp( 4567.125 );
+    stats.setMean( 1.5 );
+    stats.setRMS( 0.25 );
+    stats.setMedian( 1.375 );
+    stats.addBadSpectrum();
+    stats.addBadSpectrum();
+    stats.addBadChannels( 11 );
+    unsigned* counts = stats.clipCounts();
+    for( unsigned c = 0; c < nChannels; ++c ) counts[c] = (c * 7) % 5;
+
+    QBuffer serialBlob;
+    serialBlob.open(QBuffer::WriteOnly);
+    stats.serialise(serialBlob);
+    CPPUNIT_ASSERT_EQUAL( (qint64)stats.serialisedBytes(), serialBlob.size() );
+    serialBlob.close();
+
+    RFI_Statistics statsNew;
+    statsNew.reset( 3, 2 );
+    statsNew.addBadChannels( 1 );
+    serialBlob.open(QBuffer::ReadOnly);
+    statsNew.deserialise(serialBlob, QSysInfo::ByteOrder);
+    CPPUNIT_ASSERT( serialBlob.bytesAvailable() == 0 );
+    serialBlob.close();
+
+    CPPUNIT_ASSERT_EQUAL( 4567.125, statsNew.timestamp() );
+    CPPUNIT_ASSERT_EQUAL( 1.5f, statsNew.mean() );
+    CPPUNIT_ASSERT_EQUAL( 0.25f, statsNew.rms() );
+    CPPUNIT_ASSERT_EQUAL( 1.375f, statsNew.median() );
+    CPPUNIT_ASSERT_EQUAL( nSpectra, statsNew.nSpectra() );
+    CPPUNIT_ASSERT_EQUAL( 2u, statsNew.nBadSpectra() );
+    CPPUNIT_ASSERT_EQUAL( 11u, statsNew.nBadChannels() );
+    CPPUNIT_ASSERT_EQUAL( stats.percentBadChannels(), statsNew.percentBadChannels() );
+    const std::vector<unsigned>& counts0 = static_cast<const RFI_Statistics&>(stats).clipCounts();
+    const std::vector<unsigned>& counts1 = static_cast<const RFI_Statistics&>(statsNew).clipCounts();
+    CPPUNIT_ASSERT_EQUAL( (std::size_t)nChannels, counts1.size() );
+    for( unsigned c = 0; c < nChannels; ++c )
+        CPPUNIT_ASSERT_EQUAL( counts0[c], counts1[c] );
+
+    // Use Case:
+    // data serialised with the other byte order
+    // Expect:
+    // throw
+    QSysInfo::Endian other = ( QSysInfo::ByteOrder == QSysInfo::BigEndian ) ?
+                             QSysInfo::LittleEndian : QSysInfo::BigEndian;
+    serialBlob.open(QBuffer::ReadOnly);
+    CPPUNIT_ASSERT_THROW( statsNew.deserialise(serialBlob, other), QString );
+    serialBlob.close();
+}
+
+} // namespace ampp
+} // namespace pelican
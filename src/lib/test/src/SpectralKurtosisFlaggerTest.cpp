@@ -0,0 +1,100 @@
+#include "SpectralKurtosisFlaggerTest.h"
+
+#include "SpectralKurtosisFlagger.h"
+#include "SpectrumDataSet.h"
+#include "WeightedSpectrumDataSet.h"
+
+#include "pelican/utility/ConfigNode.h"
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <cmath>
+#include <complex>
+
+namespace pelican {
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SpectralKurtosisFlaggerTest);
+
+
+/**
+ * @details
+ * Test that a constant amplitude tone in one channel of Gaussian noise is
+ * flagged in every window, for all Stokes parameters, that its data are
+ * zeroed with the weights, and that no noise channel is flagged.
+ */
+void SpectralKurtosisFlaggerTest::test_flagCW()
+{
+    unsigned nSamples  = 2048;
+    unsigned nSubbands = 3;
+    unsigned nPols     = 2;
+    unsigned nChannels = 16;
+    unsigned nStokes   = 4;
+    unsigned window    = 1024;
+    unsigned cwSubband = 1;
+    unsigned cwChannel = 5;
+
+    try {
+        ConfigNode config(_configXml(window, 7.0f, 2));
+        SpectralKurtosisFlagger flagger(config);
+
+        boost::mt19937 rng(42);
+        boost::normal_distribution<float> normal(0.0f, 1.0f);
+        boost::variate_generator<boost::mt19937&,
+                boost::normal_distribution<float> > noise(rng, normal);
+
+        SpectrumDataSetC32 spectra;
+        spectra.resize(nSamples, nSubbands, nPols, nChannels);
+        for (unsigned t = 0; t < nSamples; ++t)
+            for (unsigned s = 0; s < nSubbands; ++s)
+                for (unsigned p = 0; p < nPols; ++p)
+                    for (unsigned c = 0; c < nChannels; ++c)
+                        spectra.spectrumData(t, s, p)[c] =
+                                std::complex<float>(noise(), noise());
+        for (unsigned t = 0; t < nSamples; ++t)
+            spectra.spectrumData(t, cwSubband, 0)[cwChannel] =
+                    std::polar(10.0f, 0.1f * t);
+
+        SpectrumDataSetStokes stokes;
+        stokes.resize(nSamples, nSubbands, nStokes, nChannels);
+        stokes.init(2.0f);
+        WeightedSpectrumDataSet weightedStokes(&stokes);
+        flagger.run(&spectra, &weightedStokes);
+
+        SpectrumDataSet<float>* weights = weightedStokes.weights();
+        for (unsigned t = 0; t < nSamples; ++t)
+            for (unsigned s = 0; s < nSubbands; ++s)
+                for (unsigned p = 0; p < nStokes; ++p)
+                    for (unsigned c = 0; c < nChannels; ++c)
+                    {
+                        bool cw = (s == cwSubband && c == cwChannel);
+                        CPPUNIT_ASSERT_EQUAL(cw ? 0.0f : 1.0f,
+                                weights->spectrumData(t, s, p)[c]);
+                        CPPUNIT_ASSERT_EQUAL(cw ? 0.0f : 2.0f,
+                                stokes.spectrumData(t, s, p)[c]);
+                    }
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0 / (nSubbands * nChannels),
+                flagger.flaggedFraction(), 1e-6);
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+QString SpectralKurtosisFlaggerTest::_configXml(unsigned window, float sigma,
+        unsigned nThreads)
+{
+    QString xml =
+            "<SpectralKurtosisFlagger>"
+            "	<window value=\"" + QString::number(window) + "\"/>"
+            "	<threshold sigma=\"" + QString::number(sigma) + "\"/>"
+            "	<processingThreads value=\"" + QString::number(nThreads) + "\"/>"
+            "</SpectralKurtosisFlagger>";
+    return xml;
+}
+
+} // namespace ampp
+} // namespace pelican
@@ -0,0 +1,174 @@
+#include "StokesGeneratorTest.h"
+
+#include "StokesGenerator.h"
+#include "EmbracePowerGenerator.h"
+#include "SpectrumDataSet.h"
+
+#include "pelican/utility/ConfigNode.h"
+
+#include <complex>
+
+namespace pelican {
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION(StokesGeneratorTest);
+
+typedef std::complex<float> Complex;
+
+
+/**
+ * @details
+ * Test module configuration.
+ */
+void StokesGeneratorTest::test_configuration()
+{
+    {
+        ConfigNode config(_configXml("XYZ", 1));
+        CPPUNIT_ASSERT_THROW(StokesGenerator module(config), QString);
+    }
+    {
+        ConfigNode config(_configXml("I", 0));
+        CPPUNIT_ASSERT_THROW(StokesGenerator module(config), QString);
+    }
+}
+
+
+/**
+ * @details
+ * Test each mode against the parameters formed one channel at a time.
+ * The channel counts leave a remainder after any vector width, the number
+ * of threads does not divide the number of (time block, sub-band) tiles,
+ * and the data are small integers so the results must match exactly.
+ */
+void StokesGeneratorTest::test_modes()
+{
+    const char* modes[] = { "I", "IQUV", "XXYY" };
+    unsigned nChannels[] = { 1, 7, 17, 33 };
+    unsigned nThreads[] = { 1, 3 };
+
+    try {
+        for (unsigned m = 0; m < 3; ++m)
+        {
+            for (unsigned n = 0; n < 4; ++n)
+            {
+                SpectrumDataSetC32 spectra;
+                spectra.resize(5, 3, 2, nChannels[n]);
+                spectra.setLofarTimestamp(12.5);
+                spectra.setBlockRate(0.25);
+                _fillSpectra(&spectra);
+                for (unsigned i = 0; i < 2; ++i)
+                {
+                    ConfigNode config(_configXml(modes[m], nThreads[i]));
+                    StokesGenerator generator(config);
+                    SpectrumDataSetStokes stokes;
+                    generator.run(&spectra, &stokes);
+                    _checkStokes(modes[m], spectra, stokes);
+                }
+            }
+        }
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Test EmbracePowerGenerator forms the power of each pointing.
+ */
+void StokesGeneratorTest::test_embracePower()
+{
+    try {
+        SpectrumDataSetC32 spectra;
+        spectra.resize(4, 2, 2, 19);
+        _fillSpectra(&spectra);
+        ConfigNode config("<EmbracePowerGenerator>"
+                "<processingThreads value=\"3\"/>"
+                "</EmbracePowerGenerator>");
+        EmbracePowerGenerator generator(config);
+        SpectrumDataSetStokes stokes;
+        generator.run(&spectra, &stokes);
+        _checkStokes("XXYY", spectra, stokes);
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+/**
+ * @details
+ * Fills the spectra with small integers, different in every element.
+ */
+void StokesGeneratorTest::_fillSpectra(SpectrumDataSetC32* spectra)
+{
+    Complex* data = spectra->data();
+    for (int i = 0; i < spectra->size(); ++i)
+        data[i] = Complex(float(i % 13) - 6.0f, float((3 * i) % 11) - 5.0f);
+}
+
+
+/**
+ * @details
+ * Checks the Stokes parameters of the mode against a scalar reference.
+ */
+void StokesGeneratorTest::_checkStokes(const QString& mode,
+        const SpectrumDataSetC32& spectra, const SpectrumDataSetStokes& stokes)
+{
+    unsigned nParams = (mode == "I") ? 1 : (mode == "IQUV" ? 4 : 2);
+    CPPUNIT_ASSERT_EQUAL(spectra.nTimeBlocks(), stokes.nTimeBlocks());
+    CPPUNIT_ASSERT_EQUAL(spectra.nSubbands(), stokes.nSubbands());
+    CPPUNIT_ASSERT_EQUAL(nParams, stokes.nPolarisations());
+    CPPUNIT_ASSERT_EQUAL(spectra.nChannels(), stokes.nChannels());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(spectra.getLofarTimestamp(),
+            stokes.getLofarTimestamp(), 1e-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(spectra.getBlockRate(),
+            stokes.getBlockRate(), 1e-12);
+
+    for (unsigned t = 0; t < spectra.nTimeBlocks(); ++t)
+    {
+        for (unsigned s = 0; s < spectra.nSubbands(); ++s)
+        {
+            const Complex* X = spectra.spectrumData(t, s, 0);
+            const Complex* Y = spectra.spectrumData(t, s, 1);
+            for (unsigned c = 0; c < spectra.nChannels(); ++c)
+            {
+                float powerX = std::norm(X[c]);
+                float powerY = std::norm(Y[c]);
+                float expected[4];
+                if (mode == "XXYY")
+                {
+                    expected[0] = powerX;
+                    expected[1] = powerY;
+                }
+                else
+                {
+                    expected[0] = powerX + powerY;
+                    expected[1] = powerX - powerY;
+                    expected[2] = 2.0f * (X[c].real() * Y[c].real()
+                            + X[c].imag() * Y[c].imag());
+                    expected[3] = 2.0f * (X[c].imag() * Y[c].real()
+                            - X[c].real() * Y[c].imag());
+                }
+                for (unsigned p = 0; p < nParams; ++p)
+                    CPPUNIT_ASSERT_EQUAL(expected[p],
+                            stokes.spectrumData(t, s, p)[c]);
+            }
+        }
+    }
+}
+
+
+QString StokesGeneratorTest::_configXml(const QString& mode, unsigned nThreads)
+{
+    QString xml =
+            "<StokesGenerator>"
+            "	<stokes value=\"" + mode + "\"/>"
+            "	<processingThreads value=\"" + QString::number(nThreads) + "\"/>"
+            "</StokesGenerator>";
+    return xml;
+}
+
+} // namespace ampp
+} // namespace pelican
@@ -0,0 +1,93 @@
+#include "StokesIntegratorTest.h"
+
+#include "StokesIntegrator.h"
+#include "SpectrumDataSet.h"
+
+#include "pelican/utility/ConfigNode.h"
+
+namespace pelican {
+namespace ampp {
+
+CPPUNIT_TEST_SUITE_REGISTRATION(StokesIntegratorTest);
+
+
+/**
+ * @details
+ * Test that a stream of spectra fed in chunks which are not a multiple of
+ * the window gives one output spectrum per completed window, with the
+ * correct sums and timestamps. The number of threads does not divide the
+ * number of (sub-band, polarisation) items.
+ */
+void StokesIntegratorTest::test_partialWindows()
+{
+    unsigned nSubbands = 3;
+    unsigned nPols     = 4;
+    unsigned nChannels = 8;
+    unsigned window    = 3;
+    unsigned bin       = 2;
+    unsigned nChunk[]  = { 5, 1, 2, 7 };
+    unsigned nOut      = nChannels / bin;
+
+    try {
+        ConfigNode config(_configXml(window, bin, 5));
+        StokesIntegrator integrator(config);
+        SpectrumDataSetStokes stokes, intStokes;
+
+        // Value of channel c of spectrum t in the stream.
+        unsigned t0 = 0, iWindow = 0;
+        for (unsigned chunk = 0; chunk < 4; ++chunk)
+        {
+            stokes.resize(nChunk[chunk], nSubbands, nPols, nChannels);
+            stokes.setLofarTimestamp(double(t0));
+            stokes.setBlockRate(1.0);
+            for (unsigned t = 0; t < nChunk[chunk]; ++t)
+                for (unsigned s = 0; s < nSubbands; ++s)
+                    for (unsigned p = 0; p < nPols; ++p)
+                        for (unsigned c = 0; c < nChannels; ++c)
+                            stokes.spectrumData(t, s, p)[c] =
+                                    float((t0 + t) * 100 + s * 10 + p + c);
+
+            integrator.run(&stokes, &intStokes);
+            t0 += nChunk[chunk];
+
+            CPPUNIT_ASSERT_EQUAL(t0 / window - iWindow, intStokes.nTimeBlocks());
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(double(window), intStokes.getBlockRate(), 1e-9);
+            if (intStokes.nTimeBlocks() > 0)
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(double(iWindow * window),
+                        intStokes.getLofarTimestamp(), 1e-9);
+
+            for (unsigned u = 0; u < intStokes.nTimeBlocks(); ++u, ++iWindow)
+                for (unsigned s = 0; s < nSubbands; ++s)
+                    for (unsigned p = 0; p < nPols; ++p)
+                        for (unsigned nc = 0; nc < nOut; ++nc)
+                        {
+                            float expected = 0.0f;
+                            for (unsigned t = iWindow * window; t < (iWindow + 1) * window; ++t)
+                                for (unsigned c = nc * bin; c < (nc + 1) * bin; ++c)
+                                    expected += float(t * 100 + s * 10 + p + c);
+                            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected,
+                                    intStokes.spectrumData(u, s, p)[nc], 1e-3);
+                        }
+        }
+        CPPUNIT_ASSERT_EQUAL(t0 / window, iWindow);
+    }
+    catch (QString const& err) {
+        CPPUNIT_FAIL(err.toLatin1().data());
+    }
+}
+
+
+QString StokesIntegratorTest::_configXml(unsigned window, unsigned bin,
+        unsigned nThreads)
+{
+    QString xml =
+            "<StokesIntegrator>"
+            "	<integrateTimeBins value=\"" + QString::number(window) + "\"/>"
+            "	<integrateFrequencyChannels value=\"" + QString::number(bin) + "\"/>"
+            "	<processingThreads value=\"" + QString::number(nThreads) + "\"/>"
+            "</StokesIntegrator>";
+    return xml;
+}
+
+} // namespace ampp
+} // namespace pelican
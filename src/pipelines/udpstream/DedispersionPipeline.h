@@ -6,8 +6,12 @@
 #include "pelican/utility/LockingCircularBuffer.hpp"
 #include "LockingPtrContainer.hpp"
 #include "PPFChanneliser.h"
+#include "PPFStokesIntegrator.h"
 #include "StokesGenerator.h"
+#include "SpectralKurtosisFlagger.h"
 #include "RFI_Clipper.h"
+#include "BandPassRecorder.h"
+#include "BandPass.h"
 #include "StokesIntegrator.h"
 #include "AdapterTimeSeriesDataSet.h"
 #include "TimeSeriesDataSet.h"
@@ -35,7 +39,24 @@ namespace ampp {
  * @brief
  *     A dedispersion pipeline for streaming TimeSeries bemaformed Data
  * @details
- * 
+ * With @b spectralKurtosis set, a SpectralKurtosisFlagger flags the complex
+ * spectra after the weights are reset and before the RFI_Clipper runs. It
+ * needs the channeliser output, so it cannot be combined with
+ * @b fusedStokes.
+ *
+ * With @b bandPassRecorder set, a BandPassRecorder fits the bandpass to the
+ * Stokes data before it is clipped, and each new fit is passed to the
+ * RFI_Clipper with updateBandPass(). Set its @b refit continuous option to
+ * follow the bandpass for the whole observation.
+ *
+ @verbatim
+ <DedispersionPipeline>
+     <history value="1280" />
+     <fusedStokes value="false" />
+     <spectralKurtosis value="true" />
+     <bandPassRecorder value="true" />
+ </DedispersionPipeline>
+ @endverbatim
  */
 
 class DedispersionPipeline : public AbstractPipeline
@@ -61,9 +82,12 @@ class DedispersionPipeline : public AbstractPipeline
 
         /// Module pointers
         PPFChanneliser* _ppfChanneliser;
+        PPFStokesIntegrator* _ppfStokesIntegrator;
         StokesGenerator* _stokesGenerator;
+        SpectralKurtosisFlagger* _skFlagger;
         StokesIntegrator* _stokesIntegrator;
         RFI_Clipper* _rfiClipper;
+        BandPassRecorder* _bandPassRecorder;
         DedispersionModule* _dedispersionModule;
         DedispersionAnalyser* _dedispersionAnalyser;
 
@@ -78,6 +102,7 @@ class DedispersionPipeline : public AbstractPipeline
         LockingPtrContainer<SpectrumDataSetStokes>* _stokesBuffer;
         LockingPtrContainer<SpectrumDataSetC32>* _rawBuffer;
         WeightedSpectrumDataSet* _weightedIntStokes;
+        BandPass _bandPass; // latest fit of the bandPassRecorder
 
 #ifdef TIMING_ENABLED
         // Timers.
@@ -87,6 +112,8 @@ class DedispersionPipeline : public AbstractPipeline
         TimerData _dedispersionTime;
         TimerData _totalTime;
         TimerData _rfiClipperTime;
+        TimerData _skTime;
+        TimerData _bandPassTime;
 #endif
 
         unsigned _iteration;
@@ -97,6 +97,11 @@ void ABPipeline::run(QHash<QString, DataBlob*>& remoteData)
     //_weightedIntStokes->reset(_stokes);
     //_stokesIntegrator->run(_stokes, _intStokes);
     _stokesIntegrator->run(stokes, _intStokes);
+    // Nothing to process until an integration window is complete.
+    if (_intStokes->nTimeBlocks() == 0) {
+        _stokesBuffer->unlock(stokesBuf);
+        return;
+    }
     *stokesBuf = *_intStokes;
     _weightedIntStokes->reset(stokesBuf);
 #ifdef TIMING_ENABLED
@@ -42,7 +42,8 @@ void BandPassPipeline::run(QHash<QString, DataBlob*>& remoteData) {
     _stokesGenerator->run(_spectra, _stokes);
     if( _recorder->run(_stokes , &_bandPass) ) {
         dataOutput(&_bandPass);
-        deactivate(); // job is done
+        if( ! _recorder->continuous() )
+            deactivate(); // job is done
     }
 }
 
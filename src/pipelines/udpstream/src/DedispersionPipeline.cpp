@@ -24,9 +24,12 @@ DedispersionPipeline::DedispersionPipeline( const QString& streamIdentifier )
      _dedispersionModule = 0;
      _dedispersionAnalyser = 0;
      _ppfChanneliser = 0;
+     _ppfStokesIntegrator = 0;
      _rfiClipper = 0;
      _stokesIntegrator = 0;
      _stokesGenerator = 0;
+     _skFlagger = 0;
+     _bandPassRecorder = 0;
 
     // Initialise timer data.
 #ifdef TIMING_ENABLED
@@ -44,9 +47,12 @@ DedispersionPipeline::~DedispersionPipeline()
     delete _stokesBuffer;
     delete _rawBuffer;
     delete _ppfChanneliser;
+    delete _ppfStokesIntegrator;
     delete _rfiClipper;
     delete _stokesIntegrator;
     delete _stokesGenerator;
+    delete _skFlagger;
+    delete _bandPassRecorder;
 
     foreach(SpectrumDataSetStokes* d, _stokesData ) {
         delete d;
@@ -69,10 +75,35 @@ void DedispersionPipeline::init()
     _maxEventsFound = c.getOption("events", "max", "0").toUInt();
 
 
+    // The fused channeliser goes straight from time series to Stokes
+    // spectra without writing out the complex spectra.
+    bool fused = c.getOption("fusedStokes", "value", "false").toLower() == "true";
+
+    // Optional spectral kurtosis flagging of the complex spectra, ahead
+    // of the RFI clipper.
+    bool spectralKurtosis = c.getOption("spectralKurtosis", "value", "false").toLower() == "true";
+    if (fused && spectralKurtosis)
+        throw QString("DedispersionPipeline: spectralKurtosis needs the "
+                "complex spectra and cannot be used with fusedStokes.");
+
+    // Optional refitting of the bandpass model used by the RFI clipper.
+    bool bandPassRecorder = c.getOption("bandPassRecorder", "value", "false").toLower() == "true";
+
     // Create modules
-    _ppfChanneliser = (PPFChanneliser *) createModule("PPFChanneliser");
-    _stokesGenerator = (StokesGenerator *) createModule("StokesGenerator");
+    if (fused) {
+        _ppfStokesIntegrator = (PPFStokesIntegrator *) createModule("PPFStokesIntegrator");
+    }
+    else {
+        _ppfChanneliser = (PPFChanneliser *) createModule("PPFChanneliser");
+        _stokesGenerator = (StokesGenerator *) createModule("StokesGenerator");
+    }
+    if (spectralKurtosis) {
+        _skFlagger = (SpectralKurtosisFlagger *) createModule("SpectralKurtosisFlagger");
+    }
     _rfiClipper = (RFI_Clipper *) createModule("RFI_Clipper");
+    if (bandPassRecorder) {
+        _bandPassRecorder = (BandPassRecorder *) createModule("BandPassRecorder");
+    }
     //    _stokesIntegrator = (StokesIntegrator *) createModule("StokesIntegrator");
     _dedispersionModule = (DedispersionModule*) createModule("DedispersionModule");
     _dedispersionAnalyser = (DedispersionAnalyser*) createModule("DedispersionAnalyser");
@@ -80,7 +111,8 @@ void DedispersionPipeline::init()
     _dedispersionModule->unlockCallback( boost::bind( &DedispersionPipeline::updateBufferLock, this, _1 ) );
 
     // Create local datablobs
-    _spectra = (SpectrumDataSetC32*) createBlob("SpectrumDataSetC32");
+    if (!fused)
+        _spectra = (SpectrumDataSetC32*) createBlob("SpectrumDataSetC32");
     // Uncomment the next line for buffered raw data
     //    _spectra = createBlobs<SpectrumDataSetC32>("SpectrumDataSetC32", history);
     _stokesData = createBlobs<SpectrumDataSetStokes>("SpectrumDataSetStokes", history);
@@ -113,15 +145,33 @@ void DedispersionPipeline::run(QHash<QString, DataBlob*>& remoteData)
     //    SpectrumDataSetC32* spectra=_rawBuffer->next();
     //    _ppfChanneliser->run(timeSeries, spectra);
 
-    _ppfChanneliser->run(timeSeries, _spectra);
-    //    std::cout << "PIPELINE: PPF done" << std::endl;
+    SpectrumDataSetStokes* stokes=_stokesBuffer->next();
+    if (_ppfStokesIntegrator) {
+        // Channelise, form Stokes and integrate in one pass.
+        _ppfStokesIntegrator->run(timeSeries, stokes);
+        timerUpdate(&_ppfTime);
+        // Nothing to process until an integration window is complete.
+        if (stokes->nTimeBlocks() == 0) {
+            _stokesBuffer->unlock(stokes);
+            return;
+        }
+        timerStart(&_stokesTime);
+    }
+    else {
+        _ppfChanneliser->run(timeSeries, _spectra);
+        //    std::cout << "PIPELINE: PPF done" << std::endl;
 
-    timerUpdate(&_ppfTime);
+        timerUpdate(&_ppfTime);
+        // Nothing to process if the chunk did not complete a spectrum.
+        if (_spectra->nTimeBlocks() == 0) {
+            _stokesBuffer->unlock(stokes);
+            return;
+        }
 
-    // Convert spectra in X, Y polarisation into spectra with stokes parameters.
-    timerStart(&_stokesTime);
-    SpectrumDataSetStokes* stokes=_stokesBuffer->next();
-    _stokesGenerator->run(_spectra, stokes);
+        // Convert spectra in X, Y polarisation into spectra with stokes parameters.
+        timerStart(&_stokesTime);
+        _stokesGenerator->run(_spectra, stokes);
+    }
     //    std::cout << "PIPELINE: Stokes" << std::endl;
 
     // In case you are using a raw buffer, uncomment the following 2 lines
@@ -130,10 +180,27 @@ void DedispersionPipeline::run(QHash<QString, DataBlob*>& remoteData)
 
     timerUpdate(&_stokesTime);
 
+    // Fit the bandpass to the data before it is clipped, and have the
+    // clipper use each new fit from the next chunk.
+    if (_bandPassRecorder) {
+        timerStart(&_bandPassTime);
+        if (_bandPassRecorder->run(stokes, &_bandPass))
+            _rfiClipper->updateBandPass(_bandPass);
+        timerUpdate(&_bandPassTime);
+    }
+
     // set up a suitable datablob from the rfi clipper
     _weightedIntStokes->reset(stokes);
     //    std::cout << "PIPELINE: Weighted Stokes" << std::endl;
 
+    // Flag channels with non-Gaussian voltages, zeroing their data and
+    // weights. This needs the weights, so runs after the reset above.
+    if (_skFlagger) {
+        timerStart(&_skTime);
+        _skFlagger->run(_spectra, _weightedIntStokes);
+        timerUpdate(&_skTime);
+    }
+
     // Clips RFI and modifies blob in place
     timerStart(&_rfiClipperTime);
     _rfiClipper->run(_weightedIntStokes);
@@ -141,6 +208,7 @@ void DedispersionPipeline::run(QHash<QString, DataBlob*>& remoteData)
 
     //    dataOutput(&(_weightedIntStokes->stats()), "RFI_Stats");
     timerUpdate(&_rfiClipperTime);
+    dataOutput(&(_rfiClipper->stats()), "RFI_Statistics");
 
     timerStart(&_integratorTime);
     //    _stokesIntegrator->run(stokes, _intStokes);
@@ -159,6 +227,10 @@ void DedispersionPipeline::run(QHash<QString, DataBlob*>& remoteData)
         timerReport(&AdapterTimeSeriesDataSet::adapterTime, "Adapter Time");
         timerReport(&_ppfTime, "Polyphase Filter");
         timerReport(&_stokesTime, "Stokes Generator");
+        if (_skFlagger)
+            timerReport(&_skTime, "Spectral Kurtosis Flagger");
+        if (_bandPassRecorder)
+            timerReport(&_bandPassTime, "BandPass Recorder");
         timerReport(&_rfiClipperTime, "RFI_Clipper");
         timerReport(&_integratorTime, "Stokes Integrator");
         timerReport(&_dedispersionTime, "DedispersionModule");
@@ -76,6 +76,9 @@ void EmbraceBFPipeline::run(QHash<QString, DataBlob*>& remoteData)
     // Generates spectra from a blocks of time series indexed by sub-band
     // and polarisation.
     ppfChanneliser->run(timeSeries, spectra);
+    // Nothing to process if the chunk did not complete a spectrum.
+    if (spectra->nTimeBlocks() == 0)
+        return;
 
     // Convert voltage spectra in X, Y direction into power spectra
     embracePowerGenerator->run(spectra, stokes);
@@ -89,8 +92,10 @@ void EmbraceBFPipeline::run(QHash<QString, DataBlob*>& remoteData)
     stokesIntegrator->run(stokes, intStokes);
 
     // Calls output stream managed->send(data, stream) the output stream
-    // manager is configured in the xml.
-     dataOutput(intStokes, "SpectrumDataSetStokes");
+    // manager is configured in the xml. The integrator has no output
+    // until an integration window is complete.
+     if (intStokes->nTimeBlocks() > 0)
+         dataOutput(intStokes, "SpectrumDataSetStokes");
 
 //    stop();
      if (_iteration % 100 == 0)
@@ -47,8 +47,10 @@ void StokesOnlyPipeline::run(QHash<QString, DataBlob*>& remoteData)
     stokesIntegrator->run(stokes, _intStokes);
 
     // Calls output stream managed->send(data, stream) the output stream
-    // manager is configured in the xml.
-    dataOutput(_intStokes, "SpectrumDataSetStokes");
+    // manager is configured in the xml. The integrator has no output
+    // until an integration window is complete.
+    if (_intStokes->nTimeBlocks() > 0)
+        dataOutput(_intStokes, "SpectrumDataSetStokes");
 
 }
 
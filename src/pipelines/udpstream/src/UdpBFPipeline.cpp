@@ -78,6 +78,9 @@ void UdpBFPipeline::run(QHash<QString, DataBlob*>& remoteData)
     // Generates spectra from a blocks of time series indexed by sub-band
     // and polarisation.
     ppfChanneliser->run(timeSeries, spectra);
+    // Nothing to process if the chunk did not complete a spectrum.
+    if (spectra->nTimeBlocks() == 0)
+        return;
 
     // Convert spectra in X, Y polarisation into spectra with stokes parameters.
     stokesGenerator->run(spectra, stokes);
@@ -88,12 +91,15 @@ void UdpBFPipeline::run(QHash<QString, DataBlob*>& remoteData)
     rfiClipper->run(weightedIntStokes);
     timerUpdate(&_rfiClipperTime);
     dataOutput(&(weightedIntStokes->stats()), "RFI_Stats");
+    dataOutput(&(rfiClipper->stats()), "RFI_Statistics");
 
     stokesIntegrator->run(stokes, intStokes);
 
     // Calls output stream managed->send(data, stream) the output stream
-    // manager is configured in the xml.
-     dataOutput(intStokes, "SpectrumDataSetStokes");
+    // manager is configured in the xml. The integrator has no output
+    // until an integration window is complete.
+     if (intStokes->nTimeBlocks() > 0)
+         dataOutput(intStokes, "SpectrumDataSetStokes");
 
 //    stop();
      if (_iteration % 100 == 0)